@@ -0,0 +1,335 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <new>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "utils.h"
+
+namespace
+{
+std::atomic<unsigned long> g_allocs(0);
+std::atomic<unsigned long> g_alloc_bytes(0);
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    // Nearest-rank: stable for the small sample counts we use.
+    size_t rank = (size_t) std::ceil(p / 100.0 * sorted.size());
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+int remove_entry(const char* path, const struct stat*, int, struct FTW*)
+{
+    return ::remove(path);
+}
+
+memory_file_system_t* g_mirror_target = nullptr;
+
+int mirror_entry(const char* path, const struct stat*, int type, struct FTW*)
+{
+    if (type == FTW_D)
+    {
+        g_mirror_target->add_dir(path);
+    }
+    else if (type == FTW_F)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        g_mirror_target->add_file(path, content);
+    }
+    return 0;
+}
+} // end of anonymous namespace
+
+// Count every C++ allocation made by the host code linked into the benchmark.
+void* operator new(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+bench::counters_t bench::counters_t::now()
+{
+    counters_t c;
+    c.allocs = g_allocs.load(std::memory_order_relaxed);
+    c.alloc_bytes = g_alloc_bytes.load(std::memory_order_relaxed);
+    c.syscalls = g_bench_syscalls;
+    return c;
+}
+
+bench::counters_t bench::counters_t::operator-(const counters_t& start) const
+{
+    counters_t c;
+    c.allocs = allocs - start.allocs;
+    c.alloc_bytes = alloc_bytes - start.alloc_bytes;
+    c.syscalls.stat = syscalls.stat - start.syscalls.stat;
+    c.syscalls.open = syscalls.open - start.syscalls.open;
+    c.syscalls.opendir = syscalls.opendir - start.syscalls.opendir;
+    c.syscalls.realpath = syscalls.realpath - start.syscalls.realpath;
+    return c;
+}
+
+bench::stats_t bench::stats_t::compute(std::vector<double> samples_us)
+{
+    std::sort(samples_us.begin(), samples_us.end());
+
+    stats_t s;
+    s.samples = samples_us.size();
+    s.min = samples_us.empty() ? 0 : samples_us.front();
+    s.max = samples_us.empty() ? 0 : samples_us.back();
+    double sum = 0;
+    for (double v : samples_us)
+    {
+        sum += v;
+    }
+    s.mean = samples_us.empty() ? 0 : sum / samples_us.size();
+    s.p50 = percentile(samples_us, 50);
+    s.p90 = percentile(samples_us, 90);
+    s.p99 = percentile(samples_us, 99);
+    return s;
+}
+
+bench::options_t::options_t()
+    : warmup(2)
+    , reps(10)
+    , json(false)
+    , keep(false)
+{
+    // Prefer tmpfs so that the file system cost is the kernel's, not the disk's.
+    if (pal::directory_exists(_X("/dev/shm")) && ::access("/dev/shm", W_OK) == 0)
+    {
+        root = _X("/dev/shm");
+    }
+    else if (!pal::getenv(_X("TMPDIR"), &root))
+    {
+        root = _X("/tmp");
+    }
+}
+
+bool bench::options_t::parse(const pal::string_t& arg)
+{
+    if (starts_with(arg, _X("--warmup=")))
+    {
+        warmup = pal::xtoi(arg.c_str() + 9);
+    }
+    else if (starts_with(arg, _X("--reps=")))
+    {
+        reps = std::max(1, pal::xtoi(arg.c_str() + 7));
+    }
+    else if (arg == _X("--format=json"))
+    {
+        json = true;
+    }
+    else if (arg == _X("--format=text"))
+    {
+        json = false;
+    }
+    else if (starts_with(arg, _X("--root=")))
+    {
+        root = arg.substr(7);
+    }
+    else if (arg == _X("--keep"))
+    {
+        keep = true;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void bench::report(const options_t& opts, const result_t& r)
+{
+    const stats_t& s = r.stats;
+    const counters_t& c = r.counters;
+
+    if (opts.json)
+    {
+        std::printf("{\"bench\":\"%s\"", r.name.c_str());
+        for (const auto& p : r.params)
+        {
+            std::printf(",\"%s\":\"%s\"", p.first.c_str(), p.second.c_str());
+        }
+        std::printf(",\"samples\":%zu,\"min_us\":%.1f,\"mean_us\":%.1f,\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f",
+            s.samples, s.min, s.mean, s.p50, s.p90, s.p99, s.max);
+        if (r.in_process)
+        {
+            std::printf(",\"allocs\":%lu,\"alloc_bytes\":%lu,\"stat\":%lu,\"open\":%lu,\"opendir\":%lu,\"realpath\":%lu",
+                c.allocs, c.alloc_bytes, c.syscalls.stat, c.syscalls.open, c.syscalls.opendir, c.syscalls.realpath);
+        }
+        for (const auto& e : r.extra)
+        {
+            std::printf(",\"%s\":%.2f", e.first.c_str(), e.second);
+        }
+        std::printf("}\n");
+    }
+    else
+    {
+        std::printf("%-24s", r.name.c_str());
+        for (const auto& p : r.params)
+        {
+            std::printf(" %s=%s", p.first.c_str(), p.second.c_str());
+        }
+        std::printf("\n    us: min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f  (n=%zu)\n",
+            s.min, s.p50, s.p90, s.p99, s.max, s.samples);
+        if (r.in_process)
+        {
+            std::printf("    allocs %lu (%lu bytes)  stat %lu  open %lu  opendir %lu  realpath %lu\n",
+                c.allocs, c.alloc_bytes, c.syscalls.stat, c.syscalls.open, c.syscalls.opendir, c.syscalls.realpath);
+        }
+        for (const auto& e : r.extra)
+        {
+            std::printf("    %s %.2f\n", e.first.c_str(), e.second);
+        }
+    }
+    std::fflush(stdout);
+}
+
+bench::result_t bench::measure(
+    const options_t& opts,
+    const pal::string_t& name,
+    const std::function<void()>& setup,
+    const std::function<void()>& phase)
+{
+    result_t result;
+    result.name = name;
+
+    for (int i = 0; i < opts.warmup; ++i)
+    {
+        setup();
+        phase();
+    }
+
+    std::vector<double> samples;
+    samples.reserve(opts.reps);
+    for (int i = 0; i < opts.reps; ++i)
+    {
+        setup();
+
+        counters_t start = counters_t::now();
+        stopwatch_t watch;
+        phase();
+        double us = watch.elapsed_us();
+        counters_t used = counters_t::now() - start;
+
+        samples.push_back(us);
+        if (i == 0)
+        {
+            result.counters = used;
+        }
+    }
+
+    result.stats = stats_t::compute(samples);
+    return result;
+}
+
+bool bench::make_temp_dir(const pal::string_t& root, const pal::string_t& prefix, pal::string_t* dir)
+{
+    pal::string_t templ = root;
+    append_path(&templ, (prefix + _X("XXXXXX")).c_str());
+
+    std::vector<char> buf(templ.begin(), templ.end());
+    buf.push_back('\0');
+    if (::mkdtemp(buf.data()) == nullptr)
+    {
+        return false;
+    }
+    dir->assign(buf.data());
+    return true;
+}
+
+void bench::remove_tree(const pal::string_t& dir)
+{
+    ::nftw(dir.c_str(), remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+}
+
+bool bench::make_dirs(const pal::string_t& dir)
+{
+    if (dir.empty() || pal::directory_exists(dir))
+    {
+        return true;
+    }
+    auto parent = get_directory(dir);
+    if (parent != dir && !make_dirs(parent))
+    {
+        return false;
+    }
+    return ::mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool bench::write_file(const pal::string_t& path, const std::string& content)
+{
+    FILE* file = pal::file_open(path, _X("w"));
+    if (file == nullptr)
+    {
+        return false;
+    }
+    bool ok = std::fwrite(content.data(), 1, content.length(), file) == content.length();
+    return (std::fclose(file) == 0) && ok;
+}
+
+bool bench::copy_file(const pal::string_t& from, const pal::string_t& to)
+{
+    pal::ifstream_t in(from, std::ios::binary);
+    if (!in.good())
+    {
+        return false;
+    }
+    std::string content((pal::istreambuf_iterator_t(in)), pal::istreambuf_iterator_t());
+    if (!write_file(to, content))
+    {
+        return false;
+    }
+    struct stat st;
+    return ::stat(from.c_str(), &st) == 0 && ::chmod(to.c_str(), st.st_mode & 0777) == 0;
+}
+
+bool bench::mirror_tree(const pal::string_t& root, memory_file_system_t* fs)
+{
+    g_mirror_target = fs;
+    bool ok = ::nftw(root.c_str(), mirror_entry, 64, FTW_PHYS) == 0;
+    g_mirror_target = nullptr;
+    return ok;
+}
@@ -0,0 +1,107 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <functional>
+
+#include "pal.h"
+#include "bench_counters.h"
+#include "memory_file_system.h"
+
+namespace bench
+{
+    // Snapshot of everything a benchmark iteration is charged for.
+    struct counters_t
+    {
+        unsigned long allocs;
+        unsigned long alloc_bytes;
+        bench_syscall_counts_t syscalls;
+
+        static counters_t now();
+        counters_t operator-(const counters_t& start) const;
+    };
+
+    // Sample distribution of one measured phase, in microseconds.
+    struct stats_t
+    {
+        size_t samples;
+        double min;
+        double mean;
+        double p50;
+        double p90;
+        double p99;
+        double max;
+
+        static stats_t compute(std::vector<double> samples_us);
+    };
+
+    struct options_t
+    {
+        int warmup;
+        int reps;
+        bool json;
+        bool keep;
+        pal::string_t root;
+
+        options_t();
+
+        // Consume the common "--warmup=", "--reps=", "--format=", "--root=" and
+        // "--keep" switches. Returns false if "arg" is not one of them.
+        bool parse(const pal::string_t& arg);
+    };
+
+    class stopwatch_t
+    {
+    public:
+        stopwatch_t() : m_start(std::chrono::steady_clock::now()) { }
+
+        double elapsed_us() const
+        {
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_start).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    // One result row, printed as a JSON object per line or as a text table.
+    struct result_t
+    {
+        pal::string_t name;
+        std::vector<std::pair<pal::string_t, pal::string_t>> params;
+        stats_t stats;
+        counters_t counters;
+        std::vector<std::pair<pal::string_t, double>> extra;
+
+        // Counters only cover work done in this process.
+        bool in_process;
+
+        result_t() : in_process(true) { }
+    };
+
+    void report(const options_t& opts, const result_t& result);
+
+    // Run "warmup" untimed then "reps" timed iterations of "phase". "setup"
+    // runs untimed before each iteration. Counters are taken from the first
+    // timed iteration.
+    result_t measure(
+        const options_t& opts,
+        const pal::string_t& name,
+        const std::function<void()>& setup,
+        const std::function<void()>& phase);
+
+    // Scratch directories, preferring tmpfs so that disk noise does not show.
+    bool make_temp_dir(const pal::string_t& root, const pal::string_t& prefix, pal::string_t* dir);
+    void remove_tree(const pal::string_t& dir);
+    bool make_dirs(const pal::string_t& dir);
+    bool write_file(const pal::string_t& path, const std::string& content);
+    bool copy_file(const pal::string_t& from, const pal::string_t& to);
+
+    // Load the directory tree under "root" into "fs" at the same paths.
+    bool mirror_tree(const pal::string_t& root, memory_file_system_t* fs);
+}
+
+#endif // BENCH_H
@@ -0,0 +1,101 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Interposers for the libc entry points the host uses to reach the file
+// system. The benchmark executable links the host sources directly, so these
+// definitions take precedence over libc's, count the call and forward to the
+// real implementation.
+//
+// This is C rather than C++ so that the definitions match libc's prototypes
+// exactly (no exception specifications).
+//
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "bench_counters.h"
+
+struct bench_syscall_counts_t g_bench_syscalls;
+
+#define BENCH_REAL(NAME) \
+    static __typeof__(&NAME) real = NULL; \
+    if (real == NULL) { real = (__typeof__(&NAME)) dlsym(RTLD_NEXT, #NAME); }
+
+int stat(const char* path, struct stat* buf)
+{
+    BENCH_REAL(stat);
+    g_bench_syscalls.stat++;
+    return real(path, buf);
+}
+
+int lstat(const char* path, struct stat* buf)
+{
+    BENCH_REAL(lstat);
+    g_bench_syscalls.stat++;
+    return real(path, buf);
+}
+
+int open(const char* path, int flags, ...)
+{
+    BENCH_REAL(open);
+    g_bench_syscalls.open++;
+    mode_t mode = 0;
+    if (flags & O_CREAT)
+    {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    return real(path, flags, mode);
+}
+
+int open64(const char* path, int flags, ...)
+{
+    BENCH_REAL(open64);
+    g_bench_syscalls.open++;
+    mode_t mode = 0;
+    if (flags & O_CREAT)
+    {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    return real(path, flags, mode);
+}
+
+FILE* fopen(const char* path, const char* mode)
+{
+    BENCH_REAL(fopen);
+    g_bench_syscalls.open++;
+    return real(path, mode);
+}
+
+FILE* fopen64(const char* path, const char* mode)
+{
+    BENCH_REAL(fopen64);
+    g_bench_syscalls.open++;
+    return real(path, mode);
+}
+
+DIR* opendir(const char* path)
+{
+    BENCH_REAL(opendir);
+    g_bench_syscalls.opendir++;
+    return real(path);
+}
+
+char* realpath(const char* path, char* resolved)
+{
+    BENCH_REAL(realpath);
+    g_bench_syscalls.realpath++;
+    return real(path, resolved);
+}
@@ -0,0 +1,28 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef BENCH_COUNTERS_H
+#define BENCH_COUNTERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Calls made through the interposed libc entry points, see bench_counters.c.
+// These count library calls, which is what the host controls; libc may issue
+// more than one system call per realpath().
+struct bench_syscall_counts_t
+{
+    unsigned long stat;
+    unsigned long open;
+    unsigned long opendir;
+    unsigned long realpath;
+};
+
+extern struct bench_syscall_counts_t g_bench_syscalls;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BENCH_COUNTERS_H
@@ -0,0 +1,225 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <algorithm>
+
+#include "bench.h"
+#include "bench_layout.h"
+#include "utils.h"
+
+namespace
+{
+const char* s_cultures[] = { "de", "es", "fr", "it", "ja", "ko", "ru", "zh-Hans" };
+
+struct entry_t
+{
+    std::string name;
+    std::string version;
+    std::string hash;
+    std::string asset_type;
+    std::string asset_name;
+    std::string relative_path;
+};
+
+entry_t make_entry(size_t i)
+{
+    size_t pkg = i / 4;
+    size_t asset = i % 4;
+
+    entry_t e;
+    e.name = "Bench.Lib" + std::to_string(pkg);
+    e.version = "1.0." + std::to_string(pkg % 7);
+    e.hash = "sha512-" + std::to_string(pkg * 2654435761u) + "abcdef";
+
+    size_t kind = i % 20;
+    if (kind < 16)
+    {
+        e.asset_type = "runtime";
+        e.asset_name = e.name + ".A" + std::to_string(asset);
+        e.relative_path = "lib/dnxcore50/" + e.asset_name + ".dll";
+    }
+    else if (kind < 19)
+    {
+        e.asset_type = "native";
+        e.asset_name = "libbench" + std::to_string(pkg) + "_" + std::to_string(asset);
+        e.relative_path = "runtimes/linux-x64/native/" + e.asset_name + ".so";
+    }
+    else
+    {
+        e.asset_type = "culture";
+        e.asset_name = e.name + ".resources";
+        e.relative_path = std::string("lib/dnxcore50/") + s_cultures[pkg % 8] + "/" + e.asset_name + ".dll";
+    }
+    return e;
+}
+
+bool touch(const pal::string_t& path, const std::string& content)
+{
+    return bench::make_dirs(get_directory(path)) && bench::write_file(path, content);
+}
+
+pal::string_t join(const pal::string_t& base, const std::string& rel)
+{
+    pal::string_t path = base;
+    append_path(&path, rel.c_str());
+    return path;
+}
+} // end of anonymous namespace
+
+arguments_t bench::layout_t::to_arguments() const
+{
+    arguments_t args;
+    args.own_path = join(app_dir, HOST_EXE_NAME);
+    args.app_dir = app_dir;
+    args.managed_application = managed_application;
+    args.deps_path = deps_path;
+    args.dotnet_servicing = servicing_dir;
+    args.nuget_packages = package_dir;
+    args.dotnet_packages_cache = package_cache_dir;
+    args.dotnet_home = root;
+    args.dotnet_ni_cache = ni_cache_dir;
+    args.dotnet_probe_roots = probe_roots;
+    return args;
+}
+
+bool bench::create_layout(const pal::string_t& root, size_t entries, layout_t* layout, size_t asset_bytes,
+    bool ni_cache, size_t stores)
+{
+    const std::string asset(asset_bytes, '\0');
+
+    layout->entries = entries;
+    layout->root = root;
+    layout->app_dir = join(root, "app");
+    layout->managed_application = join(layout->app_dir, "app.dll");
+    layout->deps_path = join(layout->app_dir, "app.deps");
+    layout->package_dir = join(root, "packages");
+    layout->package_cache_dir = join(root, "cache");
+    layout->servicing_dir = join(root, "servicing");
+    layout->clr_dir = join(root, "runtime/coreclr");
+    layout->ni_cache_dir = ni_cache ? join(root, "ni") : pal::string_t();
+    pal::string_t images_dir = ni_cache ? join(layout->ni_cache_dir, pal::get_host_rid()) : pal::string_t();
+
+    std::vector<pal::string_t> store_dirs;
+    layout->probe_roots.clear();
+    for (size_t s = 0; s < stores; ++s)
+    {
+        store_dirs.push_back(join(root, "stores/" + std::to_string(s)));
+        if (s > 0)
+        {
+            layout->probe_roots.push_back(PATH_SEPARATOR);
+        }
+        layout->probe_roots.append(store_dirs.back());
+    }
+    std::vector<std::vector<std::string>> manifests(stores);
+
+    if (!touch(layout->managed_application, asset) ||
+        !touch(join(layout->clr_dir, "mscorlib.dll"), asset) ||
+        !touch(join(layout->clr_dir, "libcoreclr.so"), asset))
+    {
+        return false;
+    }
+
+    // Assemblies that are app-local without a deps entry.
+    for (int i = 0; i < 16; ++i)
+    {
+        if (!touch(join(layout->app_dir, "App.Local" + std::to_string(i) + ".dll"), asset))
+        {
+            return false;
+        }
+    }
+
+    std::string deps;
+    std::string index = "# Synthetic servicing index\n";
+    std::string ni_index = "# Synthetic precompiled image index\n";
+    deps.reserve(entries * 160);
+
+    for (size_t i = 0; i < entries; ++i)
+    {
+        entry_t e = make_entry(i);
+        size_t pkg = i / 4;
+        std::string pkg_rel = e.name + "/" + e.version;
+
+        deps += "\"Package\",\"" + e.name + "\",\"" + e.version + "\",\"" + e.hash + "\",\"" +
+            e.asset_type + "\",\"" + e.asset_name + "\",\"" + e.relative_path + "\"\n";
+
+        size_t store = pkg % (stores + 1);
+        if (store < stores)
+        {
+            manifests[store].push_back(pkg_rel + "/" + e.relative_path);
+        }
+        const pal::string_t& package_root = (store < stores) ? store_dirs[store] : layout->package_dir;
+        if (!touch(join(package_root, pkg_rel + "/" + e.relative_path), asset))
+        {
+            return false;
+        }
+
+        if (pkg % 4 == 0)
+        {
+            if (!touch(join(layout->package_cache_dir, pkg_rel + "/" + e.relative_path), asset))
+            {
+                return false;
+            }
+            if (i % 4 == 0)
+            {
+                // The nupkg hash file, with a stale hash for every fourth cached package.
+                std::string hash = e.hash.substr(e.hash.find('-') + 1);
+                if (pkg % 16 == 0)
+                {
+                    hash += "stale";
+                }
+                pal::string_t hash_file = join(layout->package_cache_dir, pkg_rel + "/" + e.name + "." + e.version + ".nupkg.sha512");
+                if (!write_file(hash_file, hash))
+                {
+                    return false;
+                }
+            }
+        }
+
+        if (i % 10 == 0)
+        {
+            std::string patch = "patches/" + pkg_rel + "/" + e.relative_path;
+            index += "package|" + e.name + "|" + e.version + "|" + e.relative_path + "=" + patch + "\n";
+            if (!touch(join(layout->servicing_dir, patch), asset))
+            {
+                return false;
+            }
+        }
+
+        if (ni_cache && pkg % 3 == 0 && e.asset_type == "runtime")
+        {
+            std::string image = pkg_rel + "/" + e.asset_name + ".ni.dll";
+            ni_index += "package|" + e.name + "|" + e.version + "|" + e.relative_path + "=" + image + "\n";
+            if (!touch(join(images_dir, image), asset))
+            {
+                return false;
+            }
+        }
+
+        if (pkg % 5 == 1 && e.asset_type == "runtime")
+        {
+            if (!touch(join(layout->app_dir, e.asset_name + ".dll"), asset))
+            {
+                return false;
+            }
+        }
+    }
+
+    for (size_t s = 0; s < stores; ++s)
+    {
+        std::sort(manifests[s].begin(), manifests[s].end());
+        std::string manifest;
+        for (const auto& file : manifests[s])
+        {
+            manifest += file + "\n";
+        }
+        if (!make_dirs(store_dirs[s]) || !write_file(join(store_dirs[s], "dotnet_store_manifest.txt"), manifest))
+        {
+            return false;
+        }
+    }
+
+    return write_file(layout->deps_path, deps) &&
+        make_dirs(layout->servicing_dir) &&
+        write_file(join(layout->servicing_dir, "dotnet_servicing_index.txt"), index) &&
+        (!ni_cache || write_file(join(images_dir, "dotnet_ni_cache_index.txt"), ni_index));
+}
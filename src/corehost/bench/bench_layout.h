@@ -0,0 +1,50 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef BENCH_LAYOUT_H
+#define BENCH_LAYOUT_H
+
+#include "pal.h"
+#include "args.h"
+
+namespace bench
+{
+    // A synthetic application with "entries" deps entries and the package
+    // restore dir, package cache, servicing root and app dir that satisfy them.
+    //
+    // Entries are grouped four to a package. Roughly 80% are "runtime", 15%
+    // "native" and 5% "culture" assets. Every entry is present in the restore
+    // dir; every fourth package is also in the cache (a quarter of those with
+    // a stale hash file), every tenth entry is serviced and every fifth
+    // package has its assemblies app-local. The CLR dir is laid out as
+    // "runtime/coreclr" under the root, so the root can be used as DOTNET_HOME.
+    // With an NI cache, every third package has images of its assemblies in
+    // it. With package stores, packages are dealt out round robin to the
+    // stores/<n> roots and the restore dir, in that order; the stores have
+    // manifests, the restore dir does not.
+    struct layout_t
+    {
+        size_t entries;
+        pal::string_t root;
+        pal::string_t app_dir;
+        pal::string_t managed_application;
+        pal::string_t deps_path;
+        pal::string_t package_dir;
+        pal::string_t package_cache_dir;
+        pal::string_t servicing_dir;
+        pal::string_t clr_dir;
+        pal::string_t ni_cache_dir;
+
+        // Path separated package store roots, as DOTNET_PROBE_ROOTS.
+        pal::string_t probe_roots;
+
+        // Arguments as parse_arguments() would produce them for this app.
+        arguments_t to_arguments() const;
+    };
+
+    // Assemblies and libraries are "asset_bytes" of zeros.
+    bool create_layout(const pal::string_t& root, size_t entries, layout_t* layout, size_t asset_bytes = 0,
+        bool ni_cache = false, size_t stores = 0);
+}
+
+#endif // BENCH_LAYOUT_H
@@ -0,0 +1,224 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Test-only stand-in for libcoreclr. It exports the three entry points the
+// host binds to, records what the host passed in and returns immediately, so
+// that the host's own startup cost can be measured without a runtime. Besides
+// the sizes of the probe path properties, the record has the values of
+// SERVER_GC and of any "System." property, as runtime configs produce them.
+//
+// Environment:
+//   COREHOST_STUB_LOG        Append one JSON line per initialize/execute to this file
+//   COREHOST_STUB_EXIT_CODE  Exit code reported for the "managed" app (default 0)
+//                            unless the app is passed "--stub-exit-code=N"
+//   COREHOST_STUB_MAP_TPA    Map the first N TPA assemblies, as the runtime's
+//                            loader would, and keep them mapped until exit
+//   COREHOST_STUB_SHUTDOWN_MS  Take this long to shut down (default 0)
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+std::string g_record;
+size_t g_executions = 0;
+
+size_t count_entries(const char* value, char separator)
+{
+    if (value == nullptr || *value == '\0')
+    {
+        return 0;
+    }
+    size_t count = 0;
+    for (const char* p = value; *p != '\0'; ++p)
+    {
+        if (*p == separator)
+        {
+            count++;
+        }
+    }
+    // Lists are separator terminated, but tolerate a missing last separator.
+    return (value[std::strlen(value) - 1] == separator) ? count : count + 1;
+}
+
+// Entries of a TPA list that are precompiled images.
+size_t count_images(const char* tpa)
+{
+    size_t count = 0;
+    for (const char* p = std::strstr(tpa, ".ni.dll"); p != nullptr; p = std::strstr(p + 7, ".ni.dll"))
+    {
+        if (p[7] == ':' || p[7] == '\0')
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+void append_number(const char* key, size_t value)
+{
+    g_record += ",\"";
+    g_record += key;
+    g_record += "\":";
+    g_record += std::to_string(value);
+}
+
+void append_string(const char* key, const char* value)
+{
+    g_record += ",\"";
+    g_record += key;
+    g_record += "\":\"";
+    g_record += value;
+    g_record += "\"";
+}
+
+// Map up to "limit" files from the ':' separated "paths", return how many were.
+size_t map_entries(const char* paths, size_t limit)
+{
+    size_t mapped = 0;
+    std::string list = paths;
+    size_t start = 0;
+    while (mapped < limit && start < list.length())
+    {
+        size_t end = list.find(':', start);
+        if (end == std::string::npos)
+        {
+            end = list.length();
+        }
+        std::string path = list.substr(start, end - start);
+        start = end + 1;
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            if (fd >= 0) ::close(fd);
+            continue;
+        }
+        if (::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) != MAP_FAILED)
+        {
+            mapped++;
+        }
+        ::close(fd);
+    }
+    return mapped;
+}
+
+void write_record(const std::string& record)
+{
+    const char* log = std::getenv("COREHOST_STUB_LOG");
+    if (log == nullptr || *log == '\0')
+    {
+        return;
+    }
+    FILE* file = std::fopen(log, "a");
+    if (file != nullptr)
+    {
+        std::fprintf(file, "{%s}\n", record.c_str() + 1);
+        std::fclose(file);
+    }
+}
+} // end of anonymous namespace
+
+extern "C" int coreclr_initialize(
+    const char* /* exe_path */,
+    const char* /* app_domain_friendly_name */,
+    int property_count,
+    const char** property_keys,
+    const char** property_values,
+    void** host_handle,
+    unsigned int* domain_id)
+{
+    g_record.clear();
+    g_executions = 0;
+    append_number("properties", property_count);
+
+    size_t total_bytes = 0;
+    for (int i = 0; i < property_count; ++i)
+    {
+        const char* key = property_keys[i];
+        const char* value = property_values[i] != nullptr ? property_values[i] : "";
+        total_bytes += std::strlen(value);
+
+        if (std::strcmp(key, "TRUSTED_PLATFORM_ASSEMBLIES") == 0)
+        {
+            append_number("tpa_entries", count_entries(value, ':'));
+            append_number("tpa_images", count_images(value));
+            append_number("tpa_bytes", std::strlen(value));
+
+            const char* map_tpa = std::getenv("COREHOST_STUB_MAP_TPA");
+            if (map_tpa != nullptr)
+            {
+                append_number("tpa_mapped", map_entries(value, std::strtoul(map_tpa, nullptr, 10)));
+            }
+        }
+        else if (std::strcmp(key, "NATIVE_DLL_SEARCH_DIRECTORIES") == 0)
+        {
+            append_number("native_dirs", count_entries(value, ':'));
+        }
+        else if (std::strcmp(key, "PLATFORM_RESOURCE_ROOTS") == 0)
+        {
+            append_number("culture_dirs", count_entries(value, ':'));
+        }
+        else if (std::strcmp(key, "APP_PATHS") == 0)
+        {
+            append_number("app_paths", count_entries(value, ':'));
+        }
+        else if (std::strcmp(key, "SERVER_GC") == 0 || std::strncmp(key, "System.", 7) == 0)
+        {
+            append_string(key, value);
+        }
+    }
+    append_number("property_bytes", total_bytes);
+
+    *host_handle = &g_record;
+    *domain_id = 1;
+    return 0;
+}
+
+extern "C" int coreclr_execute_assembly(
+    void* /* host_handle */,
+    unsigned int /* domain_id */,
+    int argc,
+    const char** argv,
+    const char* /* managed_assembly_path */,
+    unsigned int* exit_code)
+{
+    // One record per execution, so that batches log every job.
+    std::string record = g_record;
+    std::swap(record, g_record);
+    append_number("argc", argc);
+    append_number("execution", ++g_executions);
+    std::swap(record, g_record);
+    write_record(record);
+
+    const char* code = std::getenv("COREHOST_STUB_EXIT_CODE");
+    for (int i = 0; i < argc; ++i)
+    {
+        if (std::strncmp(argv[i], "--stub-exit-code=", 17) == 0)
+        {
+            code = argv[i] + 17;
+        }
+    }
+    *exit_code = (code != nullptr) ? std::atoi(code) : 0;
+    return 0;
+}
+
+extern "C" int coreclr_shutdown(void* /* host_handle */, unsigned int /* domain_id */)
+{
+    // Stands in for finalizers and the rest of the runtime's teardown.
+    const char* shutdown_ms = std::getenv("COREHOST_STUB_SHUTDOWN_MS");
+    if (shutdown_ms != nullptr)
+    {
+        ::usleep(std::strtoul(shutdown_ms, nullptr, 10) * 1000);
+    }
+    return 0;
+}
@@ -0,0 +1,219 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Resolver microbenchmark: generates synthetic applications and package trees
+// of increasing size and measures deps parsing and probe path resolution.
+//
+
+#include <memory>
+
+#include "bench.h"
+#include "bench_layout.h"
+#include "deps_resolver.h"
+#include "utils.h"
+
+namespace
+{
+void display_help()
+{
+    std::fprintf(stderr,
+        "Usage: corehost_bench [--sizes=100,1000,10000,50000] [--reps=N] [--warmup=N]\n"
+        "                      [--format=text|json] [--root=DIR] [--keep]\n"
+        "                      [--fs=native|memory] [--fs-latency-us=N] [--stores=N]\n"
+        "                      [--ui-cultures=LIST]\n\n"
+        "Generates synthetic deps files and package layouts under DIR (default /dev/shm)\n"
+        "and measures deps_resolver_t parsing and resolve_probe_paths().\n\n"
+        "With --fs=memory the layout is loaded into an in-memory file system and every\n"
+        "stat, readdir, realpath and open is charged --fs-latency-us microseconds, to\n"
+        "emulate slow storage deterministically.\n"
+        "--stores=N deals packages out to N package stores with manifests and the\n"
+        "restore dir, which is probed.\n"
+        "--ui-cultures=LIST only probes the culture assets of LIST, as with\n"
+        "COREHOST_UI_CULTURES.\n");
+}
+
+size_t count_paths(const pal::string_t& paths)
+{
+    return std::count(paths.begin(), paths.end(), PATH_SEPARATOR);
+}
+
+// Per-iteration operation counts of the in-memory file system, less "base".
+void add_fs_counts(bench::result_t* r, const memory_file_system_t::counts_t& c,
+    const memory_file_system_t::counts_t& base, int iterations)
+{
+    r->extra.emplace_back(_X("fs_stat"), (double) (c.stat - base.stat) / iterations);
+    r->extra.emplace_back(_X("fs_readdir"), (double) (c.readdir - base.readdir) / iterations);
+    r->extra.emplace_back(_X("fs_realpath"), (double) (c.realpath - base.realpath) / iterations);
+    r->extra.emplace_back(_X("fs_open"), (double) (c.open - base.open) / iterations);
+}
+
+struct fs_options_t
+{
+    bool memory;
+    unsigned latency_us;
+};
+
+struct layout_options_t
+{
+    size_t stores;
+    pal::string_t ui_cultures;
+};
+
+void run_size(const bench::options_t& opts, const fs_options_t& fs_opts, const layout_options_t& layout_opts, size_t entries)
+{
+    pal::string_t root;
+    if (!bench::make_temp_dir(opts.root, _X("corehost_bench."), &root))
+    {
+        std::fprintf(stderr, "Failed to create a scratch dir under %s\n", opts.root.c_str());
+        return;
+    }
+
+    bench::layout_t layout;
+    bench::stopwatch_t gen_watch;
+    if (!bench::create_layout(root, entries, &layout, 0, false, layout_opts.stores))
+    {
+        std::fprintf(stderr, "Failed to generate layout for %zu entries under %s\n", entries, root.c_str());
+        bench::remove_tree(root);
+        return;
+    }
+    if (!opts.json)
+    {
+        std::printf("# %zu entries generated in %.1f ms under %s\n", entries, gen_watch.elapsed_us() / 1000, root.c_str());
+    }
+
+    memory_file_system_t memory_fs;
+    if (fs_opts.memory)
+    {
+        if (!bench::mirror_tree(root, &memory_fs))
+        {
+            std::fprintf(stderr, "Failed to load %s into memory\n", root.c_str());
+            bench::remove_tree(root);
+            return;
+        }
+        memory_file_system_t::latency_t latency = { fs_opts.latency_us, fs_opts.latency_us, fs_opts.latency_us, fs_opts.latency_us };
+        memory_fs.set_latency(latency);
+        pal::set_file_system(&memory_fs);
+    }
+
+    arguments_t args = layout.to_arguments();
+    args.ui_cultures = layout_opts.ui_cultures;
+    std::unique_ptr<deps_resolver_t> resolver;
+    probe_paths_t probe_paths;
+
+    auto no_setup = [] () { };
+    auto parse = [&] () {
+        resolver.reset(new deps_resolver_t(args));
+    };
+    auto resolve = [&] () {
+        probe_paths = probe_paths_t();
+        resolver->resolve_probe_paths(layout.app_dir, layout.package_dir, layout.package_cache_dir, layout.clr_dir, &probe_paths);
+    };
+
+    std::vector<std::pair<pal::string_t, pal::string_t>> params = {
+        { _X("entries"), std::to_string(entries) },
+        { _X("fs"), fs_opts.memory ? _X("memory") : _X("native") },
+        { _X("stores"), std::to_string(layout_opts.stores) },
+    };
+    if (!layout_opts.ui_cultures.empty())
+    {
+        params.emplace_back(_X("ui_cultures"), layout_opts.ui_cultures);
+    }
+    if (fs_opts.memory)
+    {
+        params.emplace_back(_X("fs_latency_us"), std::to_string(fs_opts.latency_us));
+    }
+
+    int iterations = opts.warmup + opts.reps;
+
+    memory_fs.reset_counts();
+    bench::result_t parsed = bench::measure(opts, _X("deps_parse"), no_setup, parse);
+    parsed.params = params;
+    auto parse_counts = memory_fs.counts();
+    if (fs_opts.memory)
+    {
+        add_fs_counts(&parsed, parse_counts, memory_file_system_t::counts_t(), iterations);
+    }
+    bench::report(opts, parsed);
+
+    // Resolution setup parses once per iteration, take its share out.
+    memory_fs.reset_counts();
+    bench::result_t resolved = bench::measure(opts, _X("resolve_probe_paths"), parse, resolve);
+    resolved.params = params;
+    if (fs_opts.memory)
+    {
+        add_fs_counts(&resolved, memory_fs.counts(), parse_counts, iterations);
+    }
+    resolved.extra.emplace_back(_X("tpa_entries"), (double) count_paths(probe_paths.tpa));
+    resolved.extra.emplace_back(_X("native_dirs"), (double) count_paths(probe_paths.native));
+    resolved.extra.emplace_back(_X("culture_dirs"), (double) count_paths(probe_paths.culture));
+    bench::report(opts, resolved);
+
+    pal::set_file_system(nullptr);
+
+    if (opts.keep)
+    {
+        std::fprintf(stderr, "Keeping layout at %s\n", root.c_str());
+    }
+    else
+    {
+        bench::remove_tree(root);
+    }
+}
+} // end of anonymous namespace
+
+int main(const int argc, const pal::char_t* argv[])
+{
+    bench::options_t opts;
+    fs_options_t fs_opts = { false, 0 };
+    std::vector<size_t> sizes = { 100, 1000, 10000, 50000 };
+    layout_options_t layout_opts = { 0, pal::string_t() };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        pal::string_t arg = argv[i];
+        if (opts.parse(arg))
+        {
+            continue;
+        }
+        if (starts_with(arg, _X("--sizes=")))
+        {
+            sizes.clear();
+            pal::stringstream_t list(arg.substr(8));
+            pal::string_t size;
+            while (std::getline(list, size, _X(',')))
+            {
+                sizes.push_back(std::stoul(size));
+            }
+            continue;
+        }
+        if (arg == _X("--fs=memory") || arg == _X("--fs=native"))
+        {
+            fs_opts.memory = arg == _X("--fs=memory");
+            continue;
+        }
+        if (starts_with(arg, _X("--stores=")))
+        {
+            layout_opts.stores = std::stoul(arg.substr(9));
+            continue;
+        }
+        if (starts_with(arg, _X("--ui-cultures=")))
+        {
+            layout_opts.ui_cultures = arg.substr(14);
+            continue;
+        }
+        if (starts_with(arg, _X("--fs-latency-us=")))
+        {
+            fs_opts.latency_us = pal::xtoi(arg.c_str() + 16);
+            continue;
+        }
+        display_help();
+        return 1;
+    }
+
+    for (size_t entries : sizes)
+    {
+        run_size(opts, fs_opts, layout_opts, entries);
+    }
+    return 0;
+}
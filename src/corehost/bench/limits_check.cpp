@@ -0,0 +1,267 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Resource limits check: reads made-up cgroup v1 and v2 hierarchies through
+// pal::get_resource_limits and derives GC and thread pool defaults for a set of
+// limits, comparing both with what is expected. Then prints the limits of this
+// process and the knobs the host would set for them.
+//
+
+#include "bench.h"
+#include "runtime_config.h"
+#include "utils.h"
+
+namespace
+{
+struct cgroup_case_t
+{
+    const char* name;
+    // (path under the root, content) of every file of the hierarchy.
+    std::vector<std::pair<const char*, const char*>> files;
+    unsigned cpuset_cpus;
+    double quota_cpus;
+    uint64_t memory_limit;
+};
+
+const cgroup_case_t CGROUP_CASES[] = {
+    {
+        "v2, limits on the parent",
+        {
+            { "/proc/self/cgroup", "0::/app.slice/app.service\n" },
+            { "/proc/self/mountinfo",
+                "22 1 0:21 / /sys rw - sysfs sysfs rw\n"
+                "30 22 0:26 / /sys/fs/cgroup rw,nosuid shared:4 - cgroup2 cgroup2 rw,nsdelegate\n" },
+            { "/sys/fs/cgroup/app.slice/cpu.max", "max 100000\n" },
+            { "/sys/fs/cgroup/app.slice/memory.max", "536870912\n" },
+            { "/sys/fs/cgroup/app.slice/app.service/cpu.max", "150000 100000\n" },
+            { "/sys/fs/cgroup/app.slice/app.service/memory.max", "max\n" },
+            { "/sys/fs/cgroup/app.slice/app.service/cpuset.cpus.effective", "0-1\n" },
+        },
+        2, 1.5, 536870912
+    },
+    {
+        "v1, namespaced mounts",
+        {
+            { "/proc/self/cgroup",
+                "5:memory:/docker/abc\n"
+                "4:cpu,cpuacct:/docker/abc\n"
+                "3:cpuset:/docker/abc\n"
+                "0::/\n" },
+            { "/proc/self/mountinfo",
+                "40 30 0:31 /docker/abc /sys/fs/cgroup/memory ro - cgroup cgroup rw,memory\n"
+                "41 30 0:32 /docker/abc /sys/fs/cgroup/cpu,cpuacct ro - cgroup cgroup rw,cpu,cpuacct\n"
+                "42 30 0:33 /docker/abc /sys/fs/cgroup/cpuset ro - cgroup cgroup rw,cpuset\n"
+                "43 30 0:34 / /sys/fs/cgroup/unified rw - cgroup2 cgroup2 rw\n" },
+            { "/sys/fs/cgroup/memory/memory.limit_in_bytes", "268435456\n" },
+            { "/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_quota_us", "200000\n" },
+            { "/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_period_us", "100000\n" },
+            { "/sys/fs/cgroup/cpuset/cpuset.cpus", "0\n" },
+        },
+        1, 2.0, 268435456
+    },
+    {
+        "v1, no limits",
+        {
+            { "/proc/self/cgroup", "4:memory:/user\n3:cpu:/\n" },
+            { "/proc/self/mountinfo",
+                "40 30 0:31 / /sys/fs/cgroup/memory rw - cgroup cgroup rw,memory\n"
+                "41 30 0:32 / /sys/fs/cgroup/cpu rw - cgroup cgroup rw,cpu\n" },
+            { "/sys/fs/cgroup/memory/user/memory.limit_in_bytes", "9223372036854771712\n" },
+            { "/sys/fs/cgroup/memory/memory.limit_in_bytes", "9223372036854771712\n" },
+            { "/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "-1\n" },
+            { "/sys/fs/cgroup/cpu/cpu.cfs_period_us", "100000\n" },
+        },
+        0, 0, 0
+    },
+    {
+        "no cgroups",
+        {
+            { "/proc/self/mountinfo", "22 1 0:21 / /sys rw - sysfs sysfs rw\n" },
+        },
+        0, 0, 0
+    },
+};
+
+struct defaults_case_t
+{
+    const char* name;
+    pal::resource_limits_t limits;
+    runtime_config_t::properties_t configured;
+    runtime_config_t::properties_t expected;
+};
+
+const uint64_t GB = uint64_t(1) << 30;
+
+const defaults_case_t DEFAULTS_CASES[] = {
+    {
+        "quota of 2 CPUs out of 16",
+        { 16, 16, 0xffff, 2.0, 0, 64 * GB },
+        { },
+        {
+            { "System.GC.Server", "true" },
+            { "System.GC.HeapCount", "2" },
+            { "System.GC.NoAffinitize", "true" },
+            { "System.Threading.ThreadPool.MinThreads", "2" },
+        }
+    },
+    {
+        "quota below one CPU",
+        { 16, 16, 0xffff, 0.5, 0, 64 * GB },
+        { },
+        {
+            { "System.GC.Server", "false" },
+            { "System.Threading.ThreadPool.MinThreads", "1" },
+        }
+    },
+    {
+        "cpuset of 4 CPUs out of 16, memory limit",
+        { 16, 4, 0xf0, 0, GB, 64 * GB },
+        { },
+        {
+            { "System.GC.Server", "true" },
+            { "System.GC.HeapAffinitizeMask", "0xf0" },
+            { "System.GC.HeapHardLimit", "805306368" },
+        }
+    },
+    {
+        "configured knobs are kept",
+        { 16, 16, 0xffff, 2.5, 64 << 20, 64 * GB },
+        {
+            { "System.GC.Server", "false" },
+            { "System.GC.HeapHardLimitPercent", "50" },
+        },
+        {
+            { "System.GC.Server", "false" },
+            { "System.GC.HeapHardLimitPercent", "50" },
+            { "System.Threading.ThreadPool.MinThreads", "3" },
+        }
+    },
+    {
+        "configured heap count and affinity are kept",
+        { 8, 8, 0xff, 4.0, 0, 64 * GB },
+        {
+            { "System.GC.HeapCount", "6" },
+            { "System.GC.HeapAffinitizeMask", "0x3f" },
+        },
+        {
+            { "System.GC.HeapCount", "6" },
+            { "System.GC.HeapAffinitizeMask", "0x3f" },
+            { "System.GC.Server", "true" },
+            { "System.Threading.ThreadPool.MinThreads", "4" },
+        }
+    },
+    {
+        "no limits",
+        { 8, 8, 0xff, 0, 0, 64 * GB },
+        { },
+        {
+            { "System.GC.Server", "true" },
+        }
+    },
+};
+
+bool check_cgroup_case(const bench::options_t& opts, const cgroup_case_t& test)
+{
+    pal::string_t root;
+    if (!bench::make_temp_dir(opts.root, _X("corehost_limits_check."), &root))
+    {
+        return false;
+    }
+    for (const auto& file : test.files)
+    {
+        pal::string_t path = root + file.first;
+        if (!bench::make_dirs(get_directory(path)) || !bench::write_file(path, file.second))
+        {
+            bench::remove_tree(root);
+            return false;
+        }
+    }
+
+    pal::resource_limits_t limits;
+    bool ok = pal::get_resource_limits(&limits, root);
+    bench::remove_tree(root);
+    if (!ok)
+    {
+        std::fprintf(stderr, "%s: reading the limits failed\n", test.name);
+        return false;
+    }
+
+    unsigned cpus = test.cpuset_cpus != 0 ? std::min(test.cpuset_cpus, limits.online_cpus) : limits.online_cpus;
+    if (limits.affinity_cpus != cpus || limits.quota_cpus != test.quota_cpus || limits.memory_limit != test.memory_limit)
+    {
+        std::fprintf(stderr, "%s: got %u CPUs, quota %.2f, memory limit %llu; expected %u, %.2f, %llu\n", test.name,
+            limits.affinity_cpus, limits.quota_cpus, (unsigned long long) limits.memory_limit,
+            cpus, test.quota_cpus, (unsigned long long) test.memory_limit);
+        return false;
+    }
+    std::printf("ok: %s\n", test.name);
+    return true;
+}
+
+bool check_defaults_case(const defaults_case_t& test)
+{
+    runtime_config_t config;
+    config.apply_overrides(test.configured);
+    config.apply_resource_defaults(test.limits);
+    if (config.properties() != test.expected)
+    {
+        std::fprintf(stderr, "%s: got", test.name);
+        for (const auto& property : config.properties())
+        {
+            std::fprintf(stderr, " %s=%s", property.first.c_str(), property.second.c_str());
+        }
+        std::fprintf(stderr, "\n");
+        return false;
+    }
+    std::printf("ok: %s\n", test.name);
+    return true;
+}
+
+void display_help()
+{
+    std::fprintf(stderr,
+        "Usage: corehost_limits_check [--root=DIR]\n\n"
+        "Checks how made-up cgroup v1 and v2 hierarchies are read and which GC and\n"
+        "thread pool knobs are derived from a set of limits, then prints the limits\n"
+        "of this process and the knobs the host would derive from them.\n");
+}
+} // end of anonymous namespace
+
+int main(const int argc, const pal::char_t* argv[])
+{
+    bench::options_t opts;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!opts.parse(argv[i]))
+        {
+            display_help();
+            return 1;
+        }
+    }
+
+    bool ok = true;
+    for (const auto& test : CGROUP_CASES)
+    {
+        ok = check_cgroup_case(opts, test) && ok;
+    }
+    for (const auto& test : DEFAULTS_CASES)
+    {
+        ok = check_defaults_case(test) && ok;
+    }
+
+    pal::resource_limits_t limits;
+    if (pal::get_resource_limits(&limits))
+    {
+        std::printf("this process: %u CPUs online, %u usable (mask 0x%llx), quota %.2f, memory limit %llu of %llu\n",
+            limits.online_cpus, limits.affinity_cpus, (unsigned long long) limits.affinity_mask, limits.quota_cpus,
+            (unsigned long long) limits.memory_limit, (unsigned long long) limits.physical_memory);
+        runtime_config_t config;
+        config.apply_resource_defaults(limits);
+        for (const auto& property : config.properties())
+        {
+            std::printf("  %s=%s\n", property.first.c_str(), property.second.c_str());
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// UI culture check: parses the arguments of a launch under made-up locale
+// environments, with COREHOST_UI_CULTURES=1 unless a case sets it, and compares
+// the UI cultures the host then probes the culture assets of with what is
+// expected.
+//
+
+#include "bench.h"
+#include "args.h"
+#include "deps_resolver.h"
+#include "utils.h"
+
+namespace
+{
+// Variables a case does not set are passed to the host as unset.
+const pal::char_t* const ENV_NAMES[] = {
+    _X("LC_ALL"), _X("LC_MESSAGES"), _X("LANG"), _X("COREHOST_UI_CULTURES")
+};
+const size_t ENV_COUNT = sizeof(ENV_NAMES) / sizeof(ENV_NAMES[0]);
+
+struct locale_case_t
+{
+    const char* name;
+    // LC_ALL, LC_MESSAGES, LANG and COREHOST_UI_CULTURES, null when unset.
+    const pal::char_t* env[ENV_COUNT];
+    // The UI cultures and their fallbacks, comma separated.
+    const pal::char_t* expected;
+};
+
+const locale_case_t LOCALE_CASES[] = {
+    { "codeset", { nullptr, nullptr, _X("de_DE.UTF-8"), nullptr }, _X("de-DE,de") },
+    { "no codeset", { nullptr, nullptr, _X("de_DE"), nullptr }, _X("de-DE,de") },
+    { "modifier, no codeset", { nullptr, nullptr, _X("de_DE@euro"), nullptr }, _X("de-DE,de") },
+    { "codeset and modifier", { nullptr, nullptr, _X("de_DE.ISO-8859-15@euro"), nullptr }, _X("de-DE,de") },
+    { "language only", { nullptr, nullptr, _X("fr"), nullptr }, _X("fr") },
+    { "script fallback", { nullptr, nullptr, _X("zh_TW.UTF-8"), nullptr }, _X("zh-TW,zh-Hant,zh") },
+    { "C locale", { nullptr, nullptr, _X("C"), nullptr }, _X("") },
+    { "C locale with codeset", { nullptr, nullptr, _X("C.UTF-8"), nullptr }, _X("") },
+    { "POSIX locale", { nullptr, nullptr, _X("POSIX"), nullptr }, _X("") },
+    { "no locale", { nullptr, nullptr, nullptr, nullptr }, _X("") },
+    { "empty locale", { nullptr, nullptr, _X(""), nullptr }, _X("") },
+    { "LC_ALL first", { _X("it_IT"), _X("es_ES"), _X("fr_FR"), nullptr }, _X("it-IT,it") },
+    { "LC_MESSAGES before LANG", { nullptr, _X("es_ES"), _X("fr_FR"), nullptr }, _X("es-ES,es") },
+    { "empty LC_ALL is unset", { _X(""), nullptr, _X("fr_FR"), nullptr }, _X("fr-FR,fr") },
+    { "explicit cultures", { nullptr, nullptr, _X("de_DE"), _X("pt-BR,ja") }, _X("pt-BR,pt,ja") },
+};
+
+pal::string_t join(const std::vector<pal::string_t>& items)
+{
+    pal::string_t joined;
+    for (const auto& item : items)
+    {
+        joined.append(joined.empty() ? _X("") : _X(",")).append(item);
+    }
+    return joined;
+}
+
+bool check_locale_case(const pal::string_t& host_path, const pal::string_t& app_path, const locale_case_t& test)
+{
+    const pal::char_t* values[ENV_COUNT];
+    for (size_t i = 0; i < ENV_COUNT; ++i)
+    {
+        values[i] = test.env[i];
+    }
+    if (values[ENV_COUNT - 1] == nullptr)
+    {
+        values[ENV_COUNT - 1] = _X("1");
+    }
+
+    host_context_t context = { };
+    context.size = sizeof(context);
+    context.version = HOST_CONTEXT_VERSION;
+    context.own_path = host_path.c_str();
+    context.env_count = ENV_COUNT;
+    context.env_names = ENV_NAMES;
+    context.env_values = values;
+
+    const pal::char_t* argv[] = { host_path.c_str(), app_path.c_str() };
+    arguments_t args;
+    if (!parse_arguments(2, argv, args, &context))
+    {
+        std::fprintf(stderr, "%s: parsing the arguments failed\n", test.name);
+        return false;
+    }
+
+    pal::string_t cultures = join(get_ui_cultures(args));
+    if (cultures != test.expected)
+    {
+        std::fprintf(stderr, "%s: got UI cultures \"%s\" from \"%s\", expected \"%s\"\n", test.name,
+            pal::to_stdstring(cultures).c_str(), pal::to_stdstring(args.ui_cultures).c_str(),
+            pal::to_stdstring(test.expected).c_str());
+        return false;
+    }
+    std::printf("ok: %s\n", test.name);
+    return true;
+}
+
+void display_help()
+{
+    std::fprintf(stderr,
+        "Usage: corehost_locale_check\n\n"
+        "Checks which UI cultures the host takes from made-up LC_ALL, LC_MESSAGES\n"
+        "and LANG values under COREHOST_UI_CULTURES=1, with and without a codeset\n"
+        "or modifier, and for the C and POSIX locales.\n");
+}
+} // end of anonymous namespace
+
+int main(const int argc, const pal::char_t*[])
+{
+    if (argc > 1)
+    {
+        display_help();
+        return 1;
+    }
+
+    // Parse as corehost running this file as the app: it only has to exist.
+    pal::string_t app_path;
+    if (!pal::get_own_executable_path(&app_path) || !pal::realpath(&app_path))
+    {
+        std::fprintf(stderr, "Failed to locate this executable\n");
+        return 1;
+    }
+    pal::string_t host_path = get_directory(app_path) + DIR_SEPARATOR + HOST_EXE_NAME;
+
+    bool ok = true;
+    for (const auto& test : LOCALE_CASES)
+    {
+        ok = check_locale_case(host_path, app_path, test) && ok;
+    }
+    return ok ? 0 : 1;
+}
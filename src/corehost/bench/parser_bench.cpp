@@ -0,0 +1,372 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Parser throughput benchmark: measures the deps file tokenizer, the servicing
+// index parser and the runtime config reader on a fixed corpus of realistic and adversarial
+// inputs. The corpus is generated from a fixed seed so that results are
+// comparable run over run.
+//
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "deps_resolver.h"
+#include "runtime_config.h"
+#include "servicing_index.h"
+#include "utils.h"
+
+namespace
+{
+// Deterministic generator, so every run parses byte-identical inputs.
+class rng_t
+{
+public:
+    rng_t(unsigned seed) : m_state(seed) { }
+
+    unsigned next(unsigned bound)
+    {
+        m_state = m_state * 1103515245u + 12345u;
+        return (m_state >> 8) % bound;
+    }
+
+private:
+    unsigned m_state;
+};
+
+struct corpus_t
+{
+    pal::string_t name;
+    pal::string_t kind;       // "deps", "servicing" or "runtimeconfig"
+    pal::string_t path;       // Directory for "servicing", else the file
+    size_t bytes;
+    size_t lines;
+};
+
+std::string quoted(const std::string& value)
+{
+    return "\"" + value + "\"";
+}
+
+std::string deps_line(size_t i)
+{
+    std::string name = "Corpus.Lib" + std::to_string(i / 4);
+    std::string asset = name + ".A" + std::to_string(i % 4);
+    return quoted("Package") + "," + quoted(name) + "," + quoted("1.0." + std::to_string(i % 7)) + "," +
+        quoted("sha512-" + std::to_string(i * 2654435761u)) + "," + quoted("runtime") + "," +
+        quoted(asset) + "," + quoted("lib/dnxcore50/" + asset + ".dll");
+}
+
+// A field of "length" characters where every other character is escaped.
+std::string escaped_field(rng_t& rng, size_t length)
+{
+    std::string field;
+    field.reserve(length * 2);
+    for (size_t i = 0; i < length; ++i)
+    {
+        char c = 'a' + rng.next(26);
+        if (i % 2 == 0)
+        {
+            field.push_back('\\');
+            c = (rng.next(4) == 0) ? '"' : ((rng.next(2) == 0) ? '\\' : c);
+        }
+        field.push_back(c);
+    }
+    return field;
+}
+
+std::string servicing_line(size_t i)
+{
+    std::string name = "Corpus.Lib" + std::to_string(i / 4);
+    std::string rel = "lib/dnxcore50/" + name + ".A" + std::to_string(i % 4) + ".dll";
+    return "package|" + name + "|1.0." + std::to_string(i % 7) + "|" + rel + "=patches/" + std::to_string(i) + "/" + rel;
+}
+
+bool add_corpus(std::vector<corpus_t>* corpus, const pal::string_t& dir, const pal::string_t& name,
+    const pal::string_t& kind, const std::string& content)
+{
+    corpus_t c;
+    c.name = name;
+    c.kind = kind;
+    c.bytes = content.length();
+    c.lines = std::count(content.begin(), content.end(), '\n');
+
+    pal::string_t file;
+    if (kind == _X("deps"))
+    {
+        c.path = dir;
+        append_path(&c.path, (name + _X(".deps")).c_str());
+        file = c.path;
+    }
+    else if (kind == _X("runtimeconfig"))
+    {
+        c.path = dir;
+        append_path(&c.path, (name + _X(".runtimeconfig.json")).c_str());
+        file = c.path;
+    }
+    else
+    {
+        c.path = dir;
+        append_path(&c.path, name.c_str());
+        file = c.path;
+        append_path(&file, _X("dotnet_servicing_index.txt"));
+    }
+
+    if (!bench::make_dirs(get_directory(file)) || !bench::write_file(file, content))
+    {
+        return false;
+    }
+    corpus->push_back(c);
+    return true;
+}
+
+bool generate_corpus(const pal::string_t& dir, std::vector<corpus_t>* corpus)
+{
+    rng_t rng(0x5eed);
+    std::string content;
+
+    // deps: a large, realistic application.
+    content.clear();
+    for (size_t i = 0; i < 50000; ++i)
+    {
+        content += deps_line(i) + "\n";
+    }
+    if (!add_corpus(corpus, dir, _X("deps_realistic"), _X("deps"), content)) return false;
+
+    // deps: long fields made mostly of escape sequences.
+    content.clear();
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        content += quoted("Package") + "," + quoted(escaped_field(rng, 2048)) + "," + quoted("1.0.0") + "," +
+            quoted("sha512-" + escaped_field(rng, 512)) + "," + quoted("runtime") + "," +
+            quoted(escaped_field(rng, 1024)) + "," + quoted(escaped_field(rng, 4096)) + "\n";
+    }
+    if (!add_corpus(corpus, dir, _X("deps_long_escaped"), _X("deps"), content)) return false;
+
+    // deps: a few very long lines, each sized scratch buffer is the whole line.
+    content.clear();
+    for (size_t i = 0; i < 16; ++i)
+    {
+        content += deps_line(i) + "," + quoted(std::string(1 << 20, 'x')) + "\n";
+    }
+    if (!add_corpus(corpus, dir, _X("deps_long_lines"), _X("deps"), content)) return false;
+
+    // deps: valid entries followed by trailing garbage the tokenizer must skip.
+    content.clear();
+    for (size_t i = 0; i < 50000; ++i)
+    {
+        content += deps_line(i) + ",\"garbage\",garbage,,\"\"\"" + std::string(256, ',') + "\n";
+    }
+    if (!add_corpus(corpus, dir, _X("deps_trailing_garbage"), _X("deps"), content)) return false;
+
+    // servicing: a large, realistic index.
+    content.clear();
+    for (size_t i = 0; i < 50000; ++i)
+    {
+        content += servicing_line(i) + "\n";
+    }
+    if (!add_corpus(corpus, dir, _X("svc_realistic"), _X("servicing"), content)) return false;
+
+    // servicing: a huge index.
+    content.clear();
+    for (size_t i = 0; i < 500000; ++i)
+    {
+        content += servicing_line(i) + "\n";
+    }
+    if (!add_corpus(corpus, dir, _X("svc_huge"), _X("servicing"), content)) return false;
+
+    // servicing: every other line is malformed (no '=' or missing fields).
+    content.clear();
+    for (size_t i = 0; i < 50000; ++i)
+    {
+        std::string line = servicing_line(i);
+        if (i % 2 == 1)
+        {
+            line = (i % 4 == 1) ? line.substr(0, line.find('=')) : "package|" + std::to_string(i);
+        }
+        content += line + "\n";
+    }
+    if (!add_corpus(corpus, dir, _X("svc_malformed"), _X("servicing"), content)) return false;
+
+    // servicing: long comment and unknown lines that must be rejected by prefix.
+    content.clear();
+    for (size_t i = 0; i < 20000; ++i)
+    {
+        content += (i % 2 ? "# " : "host|") + std::string(2048, 'c') + "package|\n";
+        content += servicing_line(i) + "\n";
+    }
+    if (!add_corpus(corpus, dir, _X("svc_long_comments"), _X("servicing"), content)) return false;
+
+    // servicing: very long package lines.
+    content.clear();
+    for (size_t i = 0; i < 64; ++i)
+    {
+        content += "package|" + std::string(64 * 1024, 'n') + "|1.0.0|" + std::string(128 * 1024, 'r') + "=" + std::string(128 * 1024, 'p') + "\n";
+    }
+    if (!add_corpus(corpus, dir, _X("svc_long_lines"), _X("servicing"), content)) return false;
+
+    // runtimeconfig: what a service would ship, GC and thread pool knobs.
+    const std::string knobs =
+        "      \"System.GC.Server\": true,\n"
+        "      \"System.GC.Concurrent\": false,\n"
+        "      \"System.GC.HeapCount\": 8,\n"
+        "      \"System.GC.HeapAffinitizeMask\": \"0xFF\",\n"
+        "      \"System.GC.HeapHardLimit\": 209715200,\n"
+        "      \"System.GC.RetainVM\": true,\n"
+        "      \"System.Threading.ThreadPool.MinThreads\": 16\n";
+    content = "{\n  \"runtimeOptions\": {\n    \"framework\": { \"name\": \"Microsoft.NETCore.App\", \"version\": \"1.0.0\" },\n"
+        "    \"configProperties\": {\n" + knobs + "    }\n  }\n}\n";
+    if (!add_corpus(corpus, dir, _X("rc_realistic"), _X("runtimeconfig"), content)) return false;
+
+    // runtimeconfig: many properties, and large sections the reader skips.
+    content = "{\n  \"runtimeOptions\": {\n    \"additionalProbingPaths\": [";
+    for (size_t i = 0; i < 20000; ++i)
+    {
+        content += std::string(i ? "," : "") + "\n      \"/opt/probe/" + std::to_string(i) + "\"";
+    }
+    content += "\n    ],\n    \"configProperties\": {\n";
+    for (size_t i = 0; i < 20000; ++i)
+    {
+        content += "      \"App.Switch" + std::to_string(i) + "\": " + (i % 3 == 0 ? "true" : i % 3 == 1 ? "\"value\"" : std::to_string(i)) + ",\n";
+    }
+    content += knobs + "    }\n  },\n  \"unrelated\": { \"nested\": [ { \"a\": [1, 2, 3] }, null, -1.5e3 ] }\n}\n";
+    if (!add_corpus(corpus, dir, _X("rc_large"), _X("runtimeconfig"), content)) return false;
+
+    // runtimeconfig: long string values made mostly of escape sequences.
+    content = "{ \"runtimeOptions\": { \"configProperties\": {\n";
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        std::string value;
+        for (size_t j = 0; j < 512; ++j)
+        {
+            value += (j % 3 == 0) ? "\\u00e9" : (j % 3 == 1) ? "\\n" : "\\\"";
+        }
+        content += std::string(i ? "," : "") + "\"App.Escaped" + std::to_string(i) + "\": \"" + value + "\"\n";
+    }
+    content += "} } }\n";
+    if (!add_corpus(corpus, dir, _X("rc_escaped"), _X("runtimeconfig"), content)) return false;
+
+    // runtimeconfig: a large file cut off before its end, rejected at the end.
+    content = content.substr(0, content.length() - 4);
+    if (!add_corpus(corpus, dir, _X("rc_truncated"), _X("runtimeconfig"), content)) return false;
+
+    return true;
+}
+
+void display_help()
+{
+    std::fprintf(stderr,
+        "Usage: corehost_parser_bench [--filter=NAME] [--reps=N] [--warmup=N]\n"
+        "                             [--format=text|json] [--root=DIR] [--keep]\n\n"
+        "Measures deps file, servicing index and runtime config parsing throughput\n"
+        "(MB/s, lines/s)\n"
+        "on a fixed corpus of realistic and adversarial inputs.\n");
+}
+} // end of anonymous namespace
+
+int main(const int argc, const pal::char_t* argv[])
+{
+    bench::options_t opts;
+    pal::string_t filter;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        pal::string_t arg = argv[i];
+        if (opts.parse(arg))
+        {
+            continue;
+        }
+        if (starts_with(arg, _X("--filter=")))
+        {
+            filter = arg.substr(9);
+            continue;
+        }
+        display_help();
+        return 1;
+    }
+
+    pal::string_t dir;
+    if (!bench::make_temp_dir(opts.root, _X("corehost_parser_bench."), &dir))
+    {
+        std::fprintf(stderr, "Failed to create a scratch dir under %s\n", opts.root.c_str());
+        return 1;
+    }
+
+    std::vector<corpus_t> corpus;
+    if (!generate_corpus(dir, &corpus))
+    {
+        std::fprintf(stderr, "Failed to generate the corpus under %s\n", dir.c_str());
+        bench::remove_tree(dir);
+        return 1;
+    }
+
+    // Malformed inputs make the parsers report errors on stderr; that cost is
+    // part of what is measured, but the output is not interesting.
+    int saved_stderr = ::dup(STDERR_FILENO);
+    int devnull = ::open("/dev/null", O_WRONLY);
+
+    for (const corpus_t& c : corpus)
+    {
+        if (!filter.empty() && c.name.find(filter) == pal::string_t::npos)
+        {
+            continue;
+        }
+
+        std::function<void()> parse;
+        arguments_t args;
+        args.deps_path = c.path;
+        bool valid = true;
+        if (c.kind == _X("deps"))
+        {
+            parse = [&] () {
+                deps_resolver_t resolver(args);
+                valid = resolver.valid();
+            };
+        }
+        else if (c.kind == _X("runtimeconfig"))
+        {
+            parse = [&] () {
+                runtime_config_t config;
+                valid = config.load(c.path);
+            };
+        }
+        else
+        {
+            parse = [&] () {
+                servicing_index_t index(c.path);
+                pal::string_t redirection;
+                index.find_redirection(_X("Corpus.Lib0"), _X("1.0.0"), _X("lib/dnxcore50/Corpus.Lib0.A0.dll"), &redirection);
+            };
+        }
+
+        ::dup2(devnull, STDERR_FILENO);
+        bench::result_t r = bench::measure(opts, _X("parse_") + c.kind, [] () { }, parse);
+        ::dup2(saved_stderr, STDERR_FILENO);
+
+        r.params.emplace_back(_X("corpus"), c.name);
+        if (!valid)
+        {
+            r.params.emplace_back(_X("result"), _X("rejected"));
+        }
+        double seconds = r.stats.p50 / 1e6;
+        r.extra.emplace_back(_X("bytes"), (double) c.bytes);
+        r.extra.emplace_back(_X("lines"), (double) c.lines);
+        r.extra.emplace_back(_X("mb_per_s"), seconds > 0 ? c.bytes / seconds / (1024 * 1024) : 0);
+        r.extra.emplace_back(_X("lines_per_s"), seconds > 0 ? c.lines / seconds : 0);
+        bench::report(opts, r);
+    }
+
+    ::close(devnull);
+    ::close(saved_stderr);
+
+    if (opts.keep)
+    {
+        std::fprintf(stderr, "Keeping corpus at %s\n", dir.c_str());
+    }
+    else
+    {
+        bench::remove_tree(dir);
+    }
+    return 0;
+}
@@ -0,0 +1,340 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Differential check of the resolution daemon: starts corehost_resolved on a
+// synthetic application, then changes the layout the way package restores,
+// cache updates and servicing do, and after every change compares what the
+// daemon answers with what deps_resolver_t resolves in-process. Exits non-zero
+// on the first difference.
+//
+
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_layout.h"
+#include "resolve_daemon.h"
+#include "utils.h"
+
+extern char** environ;
+
+namespace
+{
+bool resolve_in_process(const resolve_request_t& request, probe_paths_t* probe_paths)
+{
+    deps_resolver_t resolver(request.to_arguments());
+    return resolver.valid() &&
+        resolver.resolve_probe_paths(request.app_dir, request.package_dir, request.package_cache_dir, request.clr_dir, probe_paths);
+}
+
+class daemon_t
+{
+public:
+    daemon_t() : m_pid(-1) { }
+
+    ~daemon_t()
+    {
+        stop();
+    }
+
+    bool start(const pal::string_t& exe, const pal::string_t& socket_path)
+    {
+        std::vector<pal::string_t> argv_strs = { exe, _X("--socket=") + socket_path };
+        std::vector<char*> argv;
+        for (auto& s : argv_strs) argv.push_back(&s[0]);
+        argv.push_back(nullptr);
+
+        if (::posix_spawn(&m_pid, exe.c_str(), nullptr, nullptr, argv.data(), environ) != 0)
+        {
+            m_pid = -1;
+            return false;
+        }
+
+        // Wait for it to listen.
+        for (int i = 0; i < 500; ++i)
+        {
+            intptr_t socket;
+            if (pal::local_socket_connect(socket_path, 100, &socket))
+            {
+                pal::local_socket_close(socket);
+                return true;
+            }
+            ::usleep(10000);
+        }
+        return false;
+    }
+
+    void stop()
+    {
+        if (m_pid > 0)
+        {
+            ::kill(m_pid, SIGTERM);
+            while (::waitpid(m_pid, nullptr, 0) < 0 && errno == EINTR)
+            {
+            }
+            m_pid = -1;
+        }
+    }
+
+private:
+    pid_t m_pid;
+};
+
+// One layout change and the comparison that follows it.
+struct step_t
+{
+    const char* name;
+    std::function<bool()> change;
+};
+
+// First entry of the path list "a" that differs from "b", for the report.
+pal::string_t first_difference(const pal::string_t& a, const pal::string_t& b)
+{
+    size_t pos = 0;
+    while (pos < a.length() && pos < b.length() && a[pos] == b[pos])
+    {
+        ++pos;
+    }
+    size_t start = (pos == 0) ? pal::string_t::npos : a.rfind(PATH_SEPARATOR, pos - 1);
+    start = (start == pal::string_t::npos) ? 0 : start + 1;
+    return a.substr(start, a.find(PATH_SEPARATOR, pos) - start);
+}
+
+bool same(const probe_paths_t& a, const probe_paths_t& b)
+{
+    return a.tpa == b.tpa && a.native == b.native && a.culture == b.culture;
+}
+
+void report_difference(const char* step, bool local_ok, const probe_paths_t& local, bool remote_ok, const probe_paths_t& remote)
+{
+    std::fprintf(stderr, "%s: in-process %s, daemon %s\n", step, local_ok ? "resolved" : "failed", remote_ok ? "resolved" : "failed");
+    if (local_ok && remote_ok)
+    {
+        const std::pair<const char*, pal::string_t probe_paths_t::*> lists[] = {
+            { "tpa", &probe_paths_t::tpa }, { "native", &probe_paths_t::native }, { "culture", &probe_paths_t::culture } };
+        for (const auto& list : lists)
+        {
+            if (local.*list.second != remote.*list.second)
+            {
+                std::fprintf(stderr, "    %s: in-process has %s, daemon has %s\n", list.first,
+                    first_difference(local.*list.second, remote.*list.second).c_str(),
+                    first_difference(remote.*list.second, local.*list.second).c_str());
+            }
+        }
+    }
+}
+
+void display_help()
+{
+    std::fprintf(stderr,
+        "Usage: corehost_resolved_diff [--sizes=100,1000] [--root=DIR] [--keep]\n"
+        "                              [--resolved=PATH] [--format=text|json]\n\n"
+        "Runs corehost_resolved (default: the one in this build tree) on a synthetic\n"
+        "application, mutates the layout and checks after every mutation that the\n"
+        "daemon's answer matches an in-process resolution.\n");
+}
+} // end of anonymous namespace
+
+int main(const int argc, const pal::char_t* argv[])
+{
+    bench::options_t opts;
+    opts.reps = 1;
+    std::vector<size_t> sizes = { 100, 1000 };
+
+    pal::string_t own_path;
+    if (!pal::get_own_executable_path(&own_path) || !pal::realpath(&own_path))
+    {
+        own_path = argv[0];
+    }
+    pal::string_t daemon_exe = get_directory(get_directory(own_path)) + _X("/cli/resolved/corehost_resolved");
+
+    for (int i = 1; i < argc; ++i)
+    {
+        pal::string_t arg = argv[i];
+        if (opts.parse(arg))
+        {
+            continue;
+        }
+        if (starts_with(arg, _X("--sizes=")))
+        {
+            sizes.clear();
+            pal::stringstream_t list(arg.substr(8));
+            pal::string_t size;
+            while (std::getline(list, size, _X(',')))
+            {
+                sizes.push_back(std::stoul(size));
+            }
+        }
+        else if (starts_with(arg, _X("--resolved=")))
+        {
+            daemon_exe = arg.substr(11);
+        }
+        else
+        {
+            display_help();
+            return 1;
+        }
+    }
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    int failures = 0;
+    for (size_t entries : sizes)
+    {
+        pal::string_t root;
+        bench::layout_t layout;
+        if (!bench::make_temp_dir(opts.root, _X("corehost_resolved_diff."), &root) ||
+            !bench::create_layout(root, entries, &layout, 0, true, 2))
+        {
+            std::fprintf(stderr, "Failed to generate layout for %zu entries under %s\n", entries, opts.root.c_str());
+            return 1;
+        }
+
+        pal::string_t socket_path = root + _X("/resolved.sock");
+        daemon_t daemon;
+        if (!daemon.start(daemon_exe, socket_path))
+        {
+            std::fprintf(stderr, "Failed to start %s\n", daemon_exe.c_str());
+            bench::remove_tree(root);
+            return 1;
+        }
+
+        resolve_request_t request;
+        request.app_dir = layout.app_dir;
+        request.deps_path = layout.deps_path;
+        request.package_dir = layout.package_dir;
+        request.package_cache_dir = layout.package_cache_dir;
+        request.clr_dir = layout.clr_dir;
+        request.servicing_dir = layout.servicing_dir;
+        request.ni_cache_dir = layout.ni_cache_dir;
+        request.probe_roots = layout.probe_roots;
+
+        // Bench.Lib0 is cached with a stale hash and not app-local, Bench.Lib2
+        // and Bench.Lib5 are only in the restore dir, Bench.Lib3 only in the
+        // first package store.
+        pal::string_t lib2 = layout.package_dir + _X("/Bench.Lib2");
+        pal::string_t lib2_moved = root + _X("/Bench.Lib2.moved");
+        std::vector<step_t> steps = {
+            { "baseline", [] () { return true; } },
+            { "app_local_added", [&] () {
+                return bench::write_file(layout.app_dir + _X("/Bench.Lib0.A0.dll"), std::string());
+            } },
+            { "cache_hash_fixed", [&] () {
+                return bench::write_file(layout.package_cache_dir + _X("/Bench.Lib0/1.0.0/Bench.Lib0.1.0.0.nupkg.sha512"), "0abcdef");
+            } },
+            { "package_asset_removed", [&] () {
+                return ::unlink((lib2 + _X("/1.0.2/lib/dnxcore50/Bench.Lib2.A1.dll")).c_str()) == 0;
+            } },
+            { "package_asset_restored", [&] () {
+                return bench::write_file(lib2 + _X("/1.0.2/lib/dnxcore50/Bench.Lib2.A1.dll"), std::string());
+            } },
+            { "servicing_index_appended", [&] () {
+                pal::string_t index = layout.servicing_dir + _X("/dotnet_servicing_index.txt");
+                pal::ifstream_t in(index);
+                std::string content((pal::istreambuf_iterator_t(in)), pal::istreambuf_iterator_t());
+                content += "package|Bench.Lib3|1.0.3|lib/dnxcore50/Bench.Lib3.A1.dll=patches/Bench.Lib3.A1.dll\n";
+                return bench::write_file(layout.servicing_dir + _X("/patches/Bench.Lib3.A1.dll"), std::string()) &&
+                    bench::write_file(index, content);
+            } },
+            { "ni_index_appended", [&] () {
+                pal::string_t images_dir = layout.ni_cache_dir + _X("/") + pal::get_host_rid();
+                pal::string_t index = images_dir + _X("/dotnet_ni_cache_index.txt");
+                pal::ifstream_t in(index);
+                std::string content((pal::istreambuf_iterator_t(in)), pal::istreambuf_iterator_t());
+                content += "package|Bench.Lib2|1.0.2|lib/dnxcore50/Bench.Lib2.A1.dll=Bench.Lib2.A1.ni.dll\n";
+                return bench::write_file(images_dir + _X("/Bench.Lib2.A1.ni.dll"), std::string()) &&
+                    bench::write_file(index, content);
+            } },
+            { "package_dir_moved_away", [&] () {
+                return ::rename(lib2.c_str(), lib2_moved.c_str()) == 0;
+            } },
+            { "package_dir_moved_back", [&] () {
+                return ::rename(lib2_moved.c_str(), lib2.c_str()) == 0;
+            } },
+            { "package_dir_removed", [&] () {
+                bench::remove_tree(layout.package_dir + _X("/Bench.Lib5"));
+                return true;
+            } },
+            { "store_manifest_trimmed", [&] () {
+                pal::string_t manifest = layout.root + _X("/stores/0/dotnet_store_manifest.txt");
+                pal::ifstream_t in(manifest);
+                std::string line, content;
+                while (std::getline(in, line))
+                {
+                    if (line.compare(0, 11, "Bench.Lib3/") != 0)
+                    {
+                        content += line + "\n";
+                    }
+                }
+                in.close();
+                return bench::write_file(manifest, content);
+            } },
+            { "deps_truncated", [&] () {
+                pal::ifstream_t in(layout.deps_path);
+                std::string line, content;
+                for (size_t i = 0; i < entries / 2 && std::getline(in, line); ++i)
+                {
+                    content += line + "\n";
+                }
+                in.close();
+                return bench::write_file(layout.deps_path, content);
+            } },
+        };
+
+        for (const auto& step : steps)
+        {
+            if (!step.change())
+            {
+                std::fprintf(stderr, "Failed to apply %s under %s\n", step.name, root.c_str());
+                ++failures;
+                break;
+            }
+
+            probe_paths_t local, remote;
+            bool local_ok = false;
+            bool remote_ok = false;
+            bench::result_t in_process = bench::measure(opts, _X("resolve_in_process"), [] () { },
+                [&] () { local = probe_paths_t(); local_ok = resolve_in_process(request, &local); });
+            bench::result_t from_daemon = bench::measure(opts, _X("resolve_daemon"), [] () { },
+                [&] () { remote = probe_paths_t(); remote_ok = query_resolve_daemon(socket_path, 5000, request, &remote); });
+
+            bool match = local_ok == remote_ok && (!local_ok || same(local, remote));
+            if (!match)
+            {
+                report_difference(step.name, local_ok, local, remote_ok, remote);
+                ++failures;
+            }
+
+            std::vector<std::pair<pal::string_t, pal::string_t>> params = {
+                { _X("entries"), std::to_string(entries) },
+                { _X("step"), step.name },
+                { _X("match"), match ? _X("yes") : _X("no") },
+            };
+            in_process.params = params;
+            from_daemon.params = params;
+            from_daemon.in_process = false;
+            bench::report(opts, in_process);
+            bench::report(opts, from_daemon);
+        }
+
+        daemon.stop();
+        if (opts.keep)
+        {
+            std::fprintf(stderr, "Keeping layout at %s\n", root.c_str());
+        }
+        else
+        {
+            bench::remove_tree(root);
+        }
+    }
+
+    if (failures > 0)
+    {
+        std::fprintf(stderr, "%d step(s) differed between the daemon and in-process resolution\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,316 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Resolver API benchmark: loads hostpolicy, resolves a set of apps sharing one
+// package layout through its corehost_resolver_* exports and reports the cost
+// per app with a fresh resolver, with a warm one and with a plain
+// deps_resolver_t per app. Every answer is checked against deps_resolver_t,
+// also while several threads share one resolver.
+//
+
+#include <dlfcn.h>
+#include <thread>
+
+#include "bench.h"
+#include "bench_layout.h"
+#include "deps_resolver.h"
+#include "resolver_api.h"
+#include "utils.h"
+
+namespace
+{
+struct resolver_api_t
+{
+    corehost_resolver_create_fn create;
+    corehost_resolver_resolve_fn resolve;
+    corehost_resolution_free_fn free;
+    corehost_resolver_destroy_fn destroy;
+
+    bool load(const pal::string_t& path)
+    {
+        void* lib = ::dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (lib == nullptr)
+        {
+            std::fprintf(stderr, "Failed to load %s: %s\n", path.c_str(), ::dlerror());
+            return false;
+        }
+        create = (corehost_resolver_create_fn) ::dlsym(lib, "corehost_resolver_create");
+        resolve = (corehost_resolver_resolve_fn) ::dlsym(lib, "corehost_resolver_resolve");
+        free = (corehost_resolution_free_fn) ::dlsym(lib, "corehost_resolution_free");
+        destroy = (corehost_resolver_destroy_fn) ::dlsym(lib, "corehost_resolver_destroy");
+        return create != nullptr && resolve != nullptr && free != nullptr && destroy != nullptr;
+    }
+};
+
+struct resolved_t
+{
+    pal::string_t clr_dir;
+    probe_paths_t probe_paths;
+
+    bool operator==(const resolved_t& other) const
+    {
+        return clr_dir == other.clr_dir && probe_paths.tpa == other.probe_paths.tpa &&
+            probe_paths.native == other.probe_paths.native && probe_paths.culture == other.probe_paths.culture;
+    }
+};
+
+// Copy the files of the layout's app dir into "count" more app dirs, so that
+// there are several apps over the same packages.
+bool create_apps(const bench::layout_t& layout, size_t count, std::vector<pal::string_t>* apps)
+{
+    std::vector<pal::string_t> files;
+    pal::readdir(layout.app_dir, &files);
+
+    apps->push_back(layout.managed_application);
+    for (size_t i = 1; i < count; ++i)
+    {
+        pal::string_t dir = layout.root + _X("/apps/app") + std::to_string(i);
+        if (!bench::make_dirs(dir))
+        {
+            return false;
+        }
+        for (const auto& file : files)
+        {
+            if (!bench::copy_file(layout.app_dir + _X("/") + file, dir + _X("/") + file))
+            {
+                return false;
+            }
+        }
+        apps->push_back(dir + _X("/") + get_filename(layout.managed_application));
+    }
+    return true;
+}
+
+// What corehost would resolve "app" to, the plain way.
+bool resolve_reference(const bench::layout_t& layout, const pal::string_t& app, resolved_t* resolved)
+{
+    arguments_t args = layout.to_arguments();
+    if (!set_managed_application(app, args))
+    {
+        return false;
+    }
+    resolved->clr_dir = layout.clr_dir;
+    if (!pal::realpath(&resolved->clr_dir))
+    {
+        return false;
+    }
+    resolved->probe_paths = probe_paths_t();
+    deps_resolver_t resolver(args);
+    return resolver.valid() &&
+        resolver.resolve_probe_paths(args.app_dir, layout.package_dir, layout.package_cache_dir, resolved->clr_dir, &resolved->probe_paths);
+}
+
+bool resolve_api(const resolver_api_t& api, corehost_resolver_t* resolver, const pal::string_t& app, resolved_t* resolved)
+{
+    corehost_resolution_t* resolution = nullptr;
+    if (api.resolve(resolver, app.c_str(), nullptr, &resolution) != 0)
+    {
+        return false;
+    }
+    resolved->clr_dir = resolution->clr_dir;
+    resolved->probe_paths.tpa = resolution->tpa;
+    resolved->probe_paths.native = resolution->native;
+    resolved->probe_paths.culture = resolution->culture;
+    api.free(resolution);
+    return true;
+}
+
+void display_help()
+{
+    std::fprintf(stderr,
+        "Usage: corehost_resolver_api_bench [--sizes=100,1000,10000] [--apps=N] [--threads=N]\n"
+        "                                   [--reps=N] [--warmup=N] [--format=text|json]\n"
+        "                                   [--root=DIR] [--keep] [--hostpolicy=PATH]\n\n"
+        "Resolves N apps (default 20) over one synthetic package layout through\n"
+        "hostpolicy's corehost_resolver_* exports and reports the time per app with a\n"
+        "new resolver (resolver_cold), a warm one (resolver_warm) and deps_resolver_t\n"
+        "(in_process). Answers are checked against deps_resolver_t, also with\n"
+        "--threads threads (default 4) resolving every app through one resolver.\n");
+}
+} // end of anonymous namespace
+
+int main(const int argc, const pal::char_t* argv[])
+{
+    bench::options_t opts;
+    std::vector<size_t> sizes = { 100, 1000, 10000 };
+    size_t app_count = 20;
+    size_t thread_count = 4;
+
+    pal::string_t own_path;
+    if (!pal::get_own_executable_path(&own_path) || !pal::realpath(&own_path))
+    {
+        own_path = argv[0];
+    }
+    pal::string_t hostpolicy = get_directory(get_directory(own_path)) + _X("/cli/dll/") + MAKE_LIBNAME("hostpolicy");
+
+    for (int i = 1; i < argc; ++i)
+    {
+        pal::string_t arg = argv[i];
+        if (opts.parse(arg))
+        {
+            continue;
+        }
+        if (starts_with(arg, _X("--sizes=")))
+        {
+            sizes.clear();
+            pal::stringstream_t list(arg.substr(8));
+            pal::string_t size;
+            while (std::getline(list, size, _X(',')))
+            {
+                sizes.push_back(std::stoul(size));
+            }
+        }
+        else if (starts_with(arg, _X("--apps=")))
+        {
+            app_count = std::max<size_t>(1, std::stoul(arg.substr(7)));
+        }
+        else if (starts_with(arg, _X("--threads=")))
+        {
+            thread_count = std::max<size_t>(1, std::stoul(arg.substr(10)));
+        }
+        else if (starts_with(arg, _X("--hostpolicy=")))
+        {
+            hostpolicy = arg.substr(13);
+        }
+        else
+        {
+            display_help();
+            return 1;
+        }
+    }
+
+    resolver_api_t api;
+    if (!api.load(hostpolicy))
+    {
+        return 1;
+    }
+
+    for (size_t entries : sizes)
+    {
+        pal::string_t root;
+        bench::layout_t layout;
+        std::vector<pal::string_t> apps;
+        if (!bench::make_temp_dir(opts.root, _X("corehost_resolver_api_bench."), &root) ||
+            !bench::create_layout(root, entries, &layout) ||
+            !bench::write_file(layout.clr_dir + _X("/") + LIBCORECLR_NAME, std::string()) ||
+            !create_apps(layout, app_count, &apps))
+        {
+            std::fprintf(stderr, "Failed to generate layout for %zu entries under %s\n", entries, opts.root.c_str());
+            return 1;
+        }
+
+        corehost_resolver_options_t options = { sizeof(options), COREHOST_RESOLVER_VERSION,
+            layout.package_dir.c_str(), layout.package_cache_dir.c_str(), layout.servicing_dir.c_str(), nullptr, layout.root.c_str(), nullptr, nullptr };
+
+        std::vector<resolved_t> expected(apps.size());
+        for (size_t i = 0; i < apps.size(); ++i)
+        {
+            if (!resolve_reference(layout, apps[i], &expected[i]))
+            {
+                std::fprintf(stderr, "Failed to resolve %s\n", apps[i].c_str());
+                bench::remove_tree(root);
+                return 1;
+            }
+        }
+
+        // Every thread resolves every app through the same resolver.
+        corehost_resolver_t* resolver = nullptr;
+        if (api.create(&options, &resolver) != 0)
+        {
+            std::fprintf(stderr, "corehost_resolver_create failed\n");
+            bench::remove_tree(root);
+            return 1;
+        }
+        std::vector<size_t> mismatches(thread_count, 0);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < thread_count; ++t)
+        {
+            threads.emplace_back([&, t] () {
+                for (size_t n = 0; n < apps.size(); ++n)
+                {
+                    size_t i = (n + t) % apps.size();
+                    resolved_t resolved;
+                    if (!resolve_api(api, resolver, apps[i], &resolved) || !(resolved == expected[i]))
+                    {
+                        mismatches[t]++;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        api.destroy(resolver);
+        for (size_t t = 0; t < thread_count; ++t)
+        {
+            if (mismatches[t] != 0)
+            {
+                std::fprintf(stderr, "%zu answers from thread %zu differ from deps_resolver_t\n", mismatches[t], t);
+                bench::remove_tree(root);
+                return 1;
+            }
+        }
+
+        std::vector<std::pair<pal::string_t, pal::string_t>> params = {
+            { _X("entries"), std::to_string(entries) },
+            { _X("apps"), std::to_string(apps.size()) },
+        };
+        auto report = [&] (const pal::string_t& name, const std::function<void()>& setup, const std::function<void()>& phase) {
+            bench::result_t r = bench::measure(opts, name, setup, phase);
+            r.params = params;
+            r.in_process = false;
+            r.extra.emplace_back(_X("per_app_us"), r.stats.p50 / apps.size());
+            bench::report(opts, r);
+        };
+
+        bool ok = true;
+        auto resolve_all = [&] () {
+            for (size_t i = 0; i < apps.size(); ++i)
+            {
+                resolved_t resolved;
+                ok = resolve_api(api, resolver, apps[i], &resolved) && ok;
+            }
+        };
+        auto recreate = [&] () {
+            if (resolver != nullptr)
+            {
+                api.destroy(resolver);
+            }
+            ok = api.create(&options, &resolver) == 0 && ok;
+        };
+
+        resolver = nullptr;
+        report(_X("resolver_cold"), recreate, resolve_all);
+        report(_X("resolver_warm"), [] () { }, resolve_all);
+        api.destroy(resolver);
+
+        report(_X("in_process"), [] () { }, [&] () {
+            for (size_t i = 0; i < apps.size(); ++i)
+            {
+                resolved_t resolved;
+                ok = resolve_reference(layout, apps[i], &resolved) && ok;
+            }
+        });
+
+        if (!ok)
+        {
+            std::fprintf(stderr, "A resolution failed while being measured\n");
+        }
+
+        if (opts.keep)
+        {
+            std::fprintf(stderr, "Keeping layout at %s\n", root.c_str());
+        }
+        else
+        {
+            bench::remove_tree(root);
+        }
+        if (!ok)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,577 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// End-to-end startup benchmark: runs the real corehost + hostpolicy against
+// the stub libcoreclr on a synthetic application and reports exec-to-exit
+// latency, with a warm page cache and with the page cache for every file of
+// the layout dropped before each launch.
+//
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "bench_layout.h"
+#include "utils.h"
+
+extern char** environ;
+
+namespace
+{
+struct host_files_t
+{
+    pal::string_t corehost;
+    pal::string_t hostpolicy;
+    pal::string_t coreclr;
+
+    // corehost with hostpolicy linked in, measured as well when present.
+    pal::string_t corehost_static;
+
+    // Fork server client, for --zygote.
+    pal::string_t launcher;
+};
+
+// One way of deploying the host: the executable, and the hostpolicy library
+// to put next to it unless it is linked in. Zygote variants run corehost as a
+// fork server and measure launches through corehost_launch.
+struct host_variant_t
+{
+    pal::string_t name;
+    pal::string_t corehost;
+    pal::string_t hostpolicy;
+    bool zygote;
+};
+
+int drop_file_cache(const char* path, const struct stat*, int type, struct FTW*)
+{
+    if (type != FTW_F)
+    {
+        return 0;
+    }
+    int fd = ::open(path, O_RDONLY);
+    if (fd >= 0)
+    {
+        // Only clean pages can be dropped.
+        ::fdatasync(fd);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+    return 0;
+}
+
+// Default to the build tree: bench/<this>, cli/corehost, cli/dll/libhostpolicy.so,
+// cli/launcher/corehost_launch and cli/static/corehost if they were built.
+void default_host_files(const pal::char_t* argv0, host_files_t* files)
+{
+    pal::string_t own_path;
+    if (!pal::get_own_executable_path(&own_path) || !pal::realpath(&own_path))
+    {
+        own_path = argv0;
+    }
+    auto build_dir = get_directory(get_directory(own_path));
+
+    files->corehost = build_dir + _X("/cli/" HOST_EXE_NAME);
+    files->hostpolicy = build_dir + _X("/cli/dll/") + MAKE_LIBNAME("hostpolicy");
+    files->coreclr = get_directory(own_path) + _X("/stub/") + LIBCORECLR_NAME;
+    files->launcher = build_dir + _X("/cli/launcher/corehost_launch");
+    files->corehost_static = build_dir + _X("/cli/static/" HOST_EXE_NAME);
+    if (!pal::file_exists(files->corehost_static))
+    {
+        files->corehost_static.clear();
+    }
+}
+
+class launcher_t
+{
+public:
+    // Runs "exe app", where "app" defaults to the layout's application.
+    launcher_t(const bench::layout_t& layout, const pal::string_t& exe, const pal::string_t& log,
+        const std::vector<pal::string_t>& extra_env, const pal::string_t& app = pal::string_t())
+    {
+        m_exe = exe;
+        m_argv_strs = { m_exe, app.empty() ? layout.managed_application : app };
+
+        m_env_strs = {
+            _X("DOTNET_HOME=") + layout.root,
+            _X("NUGET_PACKAGES=") + layout.package_dir,
+            _X("DOTNET_PACKAGES_CACHE=") + layout.package_cache_dir,
+            _X("DOTNET_SERVICING=") + layout.servicing_dir,
+            _X("COREHOST_STUB_LOG=") + log,
+        };
+        if (!layout.ni_cache_dir.empty())
+        {
+            m_env_strs.push_back(_X("DOTNET_NI_CACHE=") + layout.ni_cache_dir);
+        }
+        if (!layout.probe_roots.empty())
+        {
+            m_env_strs.push_back(_X("DOTNET_PROBE_ROOTS=") + layout.probe_roots);
+        }
+        m_env_strs.insert(m_env_strs.end(), extra_env.begin(), extra_env.end());
+        // Keep the rest of the environment, minus anything that steers the host.
+        for (char** env = environ; *env != nullptr; ++env)
+        {
+            pal::string_t var = *env;
+            if (!starts_with(var, _X("DOTNET_")) && !starts_with(var, _X("NUGET_")) && !starts_with(var, _X("COREHOST_")))
+            {
+                m_env_strs.push_back(var);
+            }
+        }
+
+        for (auto& s : m_argv_strs) m_argv.push_back(&s[0]);
+        for (auto& s : m_env_strs) m_env.push_back(&s[0]);
+        m_argv.push_back(nullptr);
+        m_env.push_back(nullptr);
+
+        posix_spawn_file_actions_init(&m_actions);
+        posix_spawn_file_actions_addopen(&m_actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addopen(&m_actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+
+    ~launcher_t()
+    {
+        posix_spawn_file_actions_destroy(&m_actions);
+    }
+
+    // Pid of the started host, or -1 if it could not be started.
+    pid_t start()
+    {
+        pid_t pid;
+        if (::posix_spawn(&pid, m_exe.c_str(), &m_actions, nullptr, m_argv.data(), m_env.data()) != 0)
+        {
+            return -1;
+        }
+        return pid;
+    }
+
+    // Exit code of the host, or -1 if it could not be started.
+    int launch()
+    {
+        pid_t pid = start();
+        if (pid < 0)
+        {
+            return -1;
+        }
+        int status = 0;
+        while (::waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+private:
+    pal::string_t m_exe;
+    std::vector<pal::string_t> m_argv_strs;
+    std::vector<pal::string_t> m_env_strs;
+    std::vector<char*> m_argv;
+    std::vector<char*> m_env;
+    posix_spawn_file_actions_t m_actions;
+};
+
+// Last record the stub wrote, for the report.
+pal::string_t last_stub_record(const pal::string_t& log)
+{
+    pal::ifstream_t in(log);
+    std::string line, last;
+    while (std::getline(in, line))
+    {
+        last = line;
+    }
+    return last;
+}
+
+// Expected exit code of job "i" of a batch, as passed to the stub.
+int batch_job_exit_code(size_t i)
+{
+    return (int) (i % 3);
+}
+
+// Write a response file that runs the layout's application "jobs" times, each
+// job with its own exit code.
+bool write_batch_file(const bench::layout_t& layout, const pal::string_t& path, size_t jobs)
+{
+    std::string content = "# corehost_startup_bench batch\n";
+    for (size_t i = 0; i < jobs; ++i)
+    {
+        content += "\"" + pal::to_stdstring(layout.managed_application) + "\" --stub-exit-code=" +
+            std::to_string(batch_job_exit_code(i)) + "\n";
+    }
+    return bench::write_file(path, content);
+}
+
+// Check the batch results file reports every job's exit code, in order.
+bool check_batch_results(const pal::string_t& path, size_t jobs)
+{
+    pal::ifstream_t in(path);
+    std::string line;
+    size_t i = 0;
+    while (std::getline(in, line))
+    {
+        if (i >= jobs || std::atoi(line.c_str()) != batch_job_exit_code(i))
+        {
+            return false;
+        }
+        i++;
+    }
+    return i == jobs;
+}
+
+void display_help()
+{
+    std::fprintf(stderr,
+        "Usage: corehost_startup_bench [--sizes=100,1000,10000] [--reps=N] [--warmup=N]\n"
+        "                              [--mode=warm|cold|both] [--format=text|json]\n"
+        "                              [--root=DIR] [--keep] [--corehost=PATH]\n"
+        "                              [--hostpolicy=PATH] [--coreclr=PATH]\n"
+        "                              [--corehost-static=PATH]\n"
+        "                              [--asset-kb=N] [--map-tpa=N] [--prefetch]\n"
+        "                              [--resolve-cache] [--zygote] [--launcher=PATH]\n"
+        "                              [--batch=N] [--exit-modes] [--shutdown-ms=N]\n"
+        "                              [--ni-cache] [--stores=N]\n\n"
+        "Runs corehost against the stub libcoreclr and reports exec-to-exit latency.\n"
+        "Cold mode drops the page cache of every layout file before each launch with\n"
+        "posix_fadvise(DONTNEED); this has no effect on tmpfs, so the default root for\n"
+        "this benchmark is TMPDIR or /tmp.\n\n"
+        "If corehost was also built with hostpolicy linked in (COREHOST_STATIC_HOSTPOLICY),\n"
+        "that binary is measured too, as host=static.\n"
+        "--asset-kb=N makes every generated assembly and library N KB (default 0),\n"
+        "--map-tpa=N has the stub map the first N TPA assemblies like the runtime would,\n"
+        "--prefetch runs the host with COREHOST_PREFETCH=1 so that they are prefetched.\n"
+        "--resolve-cache shares resolutions between launches through a cache file in\n"
+        "the layout (COREHOST_RESOLVE_CACHE).\n"
+        "--zygote also measures launches through corehost_launch against corehost\n"
+        "running as the app's fork server (COREHOST_ZYGOTE_SERVE), as host=zygote.\n"
+        "corehost_launch is only built with COREHOST_BUILD_ZYGOTE_LAUNCHER.\n"
+        "--batch=N also measures one \"corehost @FILE\" launch that runs the app N times\n"
+        "under one runtime, as startup_batch, after checking every job's exit code.\n"
+        "--exit-modes also measures warm launches that skip CoreCLR shutdown\n"
+        "(COREHOST_FAST_EXIT, as exit=fast) and that give it 5 ms on a helper thread\n"
+        "(COREHOST_SHUTDOWN_TIMEOUT_MS, as exit=background), after checking that the\n"
+        "app's exit code comes through; the other launches are exit=normal.\n"
+        "--shutdown-ms=N has the stub take N ms to shut down (default 0).\n"
+        "--ni-cache gives every third package precompiled images in an NI cache\n"
+        "(DOTNET_NI_CACHE); the stub record counts them as tpa_images.\n"
+        "--stores=N deals packages out to N package stores with manifests\n"
+        "(DOTNET_PROBE_ROOTS) and the restore dir.\n");
+}
+} // end of anonymous namespace
+
+int main(const int argc, const pal::char_t* argv[])
+{
+    bench::options_t opts;
+    if (!pal::getenv(_X("TMPDIR"), &opts.root))
+    {
+        opts.root = _X("/tmp");
+    }
+
+    host_files_t files;
+    default_host_files(argv[0], &files);
+
+    std::vector<size_t> sizes = { 100, 1000, 10000 };
+    bool warm = true;
+    bool cold = true;
+    std::vector<pal::string_t> extra_env;
+    size_t asset_bytes = 0;
+    bool resolve_cache = false;
+    bool zygote = false;
+    size_t batch_jobs = 0;
+    bool exit_modes = false;
+    bool ni_cache = false;
+    size_t stores = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        pal::string_t arg = argv[i];
+        if (opts.parse(arg))
+        {
+            continue;
+        }
+        if (starts_with(arg, _X("--sizes=")))
+        {
+            sizes.clear();
+            pal::stringstream_t list(arg.substr(8));
+            pal::string_t size;
+            while (std::getline(list, size, _X(',')))
+            {
+                sizes.push_back(std::stoul(size));
+            }
+        }
+        else if (arg == _X("--mode=warm") || arg == _X("--mode=cold") || arg == _X("--mode=both"))
+        {
+            warm = arg != _X("--mode=cold");
+            cold = arg != _X("--mode=warm");
+        }
+        else if (starts_with(arg, _X("--corehost=")))
+        {
+            files.corehost = arg.substr(11);
+        }
+        else if (starts_with(arg, _X("--hostpolicy=")))
+        {
+            files.hostpolicy = arg.substr(13);
+        }
+        else if (starts_with(arg, _X("--corehost-static=")))
+        {
+            files.corehost_static = arg.substr(18);
+        }
+        else if (starts_with(arg, _X("--coreclr=")))
+        {
+            files.coreclr = arg.substr(10);
+        }
+        else if (starts_with(arg, _X("--asset-kb=")))
+        {
+            asset_bytes = std::stoul(arg.substr(11)) * 1024;
+        }
+        else if (starts_with(arg, _X("--map-tpa=")))
+        {
+            extra_env.push_back(_X("COREHOST_STUB_MAP_TPA=") + arg.substr(10));
+        }
+        else if (starts_with(arg, _X("--launcher=")))
+        {
+            files.launcher = arg.substr(11);
+        }
+        else if (starts_with(arg, _X("--batch=")))
+        {
+            batch_jobs = std::stoul(arg.substr(8));
+        }
+        else if (arg == _X("--ni-cache"))
+        {
+            ni_cache = true;
+        }
+        else if (starts_with(arg, _X("--stores=")))
+        {
+            stores = std::stoul(arg.substr(9));
+        }
+        else if (arg == _X("--exit-modes"))
+        {
+            exit_modes = true;
+        }
+        else if (starts_with(arg, _X("--shutdown-ms=")))
+        {
+            extra_env.push_back(_X("COREHOST_STUB_SHUTDOWN_MS=") + arg.substr(14));
+        }
+        else if (arg == _X("--zygote"))
+        {
+            zygote = true;
+        }
+        else if (arg == _X("--resolve-cache"))
+        {
+            resolve_cache = true;
+        }
+        else if (arg == _X("--prefetch"))
+        {
+            extra_env.push_back(_X("COREHOST_PREFETCH=1"));
+        }
+        else
+        {
+            display_help();
+            return 1;
+        }
+    }
+
+    for (size_t entries : sizes)
+    {
+        pal::string_t root;
+        bench::layout_t layout;
+        if (!bench::make_temp_dir(opts.root, _X("corehost_startup_bench."), &root) ||
+            !bench::create_layout(root, entries, &layout, asset_bytes, ni_cache, stores))
+        {
+            std::fprintf(stderr, "Failed to generate layout for %zu entries under %s\n", entries, opts.root.c_str());
+            return 1;
+        }
+
+        if (!bench::copy_file(files.coreclr, layout.clr_dir + _X("/") + LIBCORECLR_NAME))
+        {
+            std::fprintf(stderr, "Failed to copy %s into the layout\n", files.coreclr.c_str());
+            bench::remove_tree(root);
+            return 1;
+        }
+
+        std::vector<pal::string_t> env = extra_env;
+        if (resolve_cache)
+        {
+            env.push_back(_X("COREHOST_RESOLVE_CACHE=") + root + _X("/resolve.cache"));
+        }
+
+        std::vector<host_variant_t> variants = { { _X("dynamic"), files.corehost, files.hostpolicy, false } };
+        if (!files.corehost_static.empty())
+        {
+            variants.push_back({ _X("static"), files.corehost_static, pal::string_t(), false });
+        }
+        if (zygote)
+        {
+            variants.push_back({ _X("zygote"), files.corehost, files.hostpolicy, true });
+        }
+
+        for (const auto& variant : variants)
+        {
+            // The host runs from its own dir with hostpolicy next to it, and
+            // finds the stub CLR through DOTNET_HOME.
+            pal::string_t host_dir = root + _X("/host_") + variant.name;
+            if (!bench::make_dirs(host_dir) ||
+                !bench::copy_file(variant.corehost, host_dir + _X("/" HOST_EXE_NAME)) ||
+                (!variant.hostpolicy.empty() &&
+                 !bench::copy_file(variant.hostpolicy, host_dir + _X("/") + MAKE_LIBNAME("hostpolicy"))))
+            {
+                std::fprintf(stderr, "Failed to copy %s and %s into the layout\n",
+                    variant.corehost.c_str(), variant.hostpolicy.c_str());
+                bench::remove_tree(root);
+                return 1;
+            }
+
+            pal::string_t log = root + _X("/stub.log");
+            pal::string_t host_exe = host_dir + _X("/" HOST_EXE_NAME);
+
+            // The fork server, and the launcher that talks to it.
+            pid_t server = -1;
+            std::vector<pal::string_t> host_env = env;
+            if (variant.zygote)
+            {
+                pal::string_t socket_path = host_dir + _X("/zygote.sock");
+                std::vector<pal::string_t> server_env = env;
+                server_env.push_back(_X("COREHOST_ZYGOTE_SERVE=") + socket_path);
+                launcher_t server_launcher(layout, host_exe, log, server_env);
+
+                host_exe = host_dir + _X("/corehost_launch");
+                host_env.push_back(_X("COREHOST_ZYGOTE=") + socket_path);
+                server = bench::copy_file(files.launcher, host_exe) ? server_launcher.start() : -1;
+
+                intptr_t socket = -1;
+                for (int i = 0; server > 0 && i < 500 && !pal::local_socket_connect(socket_path, 100, &socket); ++i)
+                {
+                    ::usleep(10000);
+                }
+                if (socket < 0)
+                {
+                    std::fprintf(stderr, "Failed to start the fork server under %s\n", root.c_str());
+                    bench::remove_tree(root);
+                    return 1;
+                }
+                pal::local_socket_close(socket);
+            }
+
+            launcher_t launcher(layout, host_exe, log, host_env);
+            if (launcher.launch() != 0)
+            {
+                std::fprintf(stderr, "corehost failed to run the stub app under %s\n", root.c_str());
+                bench::remove_tree(root);
+                return 1;
+            }
+
+            std::vector<std::pair<pal::string_t, pal::string_t>> params = {
+                { _X("entries"), std::to_string(entries) },
+                { _X("host"), variant.name },
+            };
+            if (exit_modes)
+            {
+                params.emplace_back(_X("exit"), _X("normal"));
+            }
+
+            auto run = [&] () { launcher.launch(); };
+            if (warm)
+            {
+                bench::result_t r = bench::measure(opts, _X("startup_warm"), [] () { }, run);
+                r.params = params;
+                r.in_process = false;
+                bench::report(opts, r);
+            }
+            if (cold)
+            {
+                auto drop_caches = [&] () { ::nftw(root.c_str(), drop_file_cache, 64, FTW_PHYS); };
+                bench::result_t r = bench::measure(opts, _X("startup_cold"), drop_caches, run);
+                r.params = params;
+                r.in_process = false;
+                bench::report(opts, r);
+            }
+
+            if (!opts.json)
+            {
+                std::printf("    stub: %s\n", last_stub_record(log).c_str());
+            }
+
+            if (exit_modes && !variant.zygote)
+            {
+                const std::vector<std::pair<pal::string_t, pal::string_t>> modes = {
+                    { _X("fast"), _X("COREHOST_FAST_EXIT=1") },
+                    { _X("background"), _X("COREHOST_SHUTDOWN_TIMEOUT_MS=5") },
+                };
+                for (const auto& mode : modes)
+                {
+                    std::vector<pal::string_t> mode_env = host_env;
+                    mode_env.push_back(mode.second);
+                    launcher_t mode_launcher(layout, host_exe, log, mode_env);
+
+                    std::vector<pal::string_t> check_env = mode_env;
+                    check_env.push_back(_X("COREHOST_STUB_EXIT_CODE=42"));
+                    if (launcher_t(layout, host_exe, log, check_env).launch() != 42)
+                    {
+                        std::fprintf(stderr, "corehost lost the app's exit code with exit=%s under %s\n",
+                            mode.first.c_str(), root.c_str());
+                        bench::remove_tree(root);
+                        return 1;
+                    }
+
+                    bench::result_t r = bench::measure(opts, _X("startup_warm"), [] () { }, [&] () { mode_launcher.launch(); });
+                    r.params = params;
+                    r.params.back().second = mode.first;
+                    r.in_process = false;
+                    bench::report(opts, r);
+                }
+            }
+
+            if (batch_jobs > 0 && !variant.zygote)
+            {
+                pal::string_t batch_file = root + _X("/batch.rsp");
+                pal::string_t results = root + _X("/batch.results");
+                std::vector<pal::string_t> batch_env = host_env;
+                batch_env.push_back(_X("COREHOST_BATCH_RESULTS=") + results);
+                launcher_t batch_launcher(layout, host_exe, log, batch_env, _X("@") + batch_file);
+
+                // The first job with a non-zero exit code sets the host's.
+                int expected = batch_jobs > 1 ? batch_job_exit_code(1) : batch_job_exit_code(0);
+                if (!write_batch_file(layout, batch_file, batch_jobs) ||
+                    batch_launcher.launch() != expected ||
+                    !check_batch_results(results, batch_jobs))
+                {
+                    std::fprintf(stderr, "corehost failed to run the batch %s\n", batch_file.c_str());
+                    bench::remove_tree(root);
+                    return 1;
+                }
+
+                bench::result_t r = bench::measure(opts, _X("startup_batch"), [] () { }, [&] () { batch_launcher.launch(); });
+                r.params = params;
+                r.params.emplace_back(_X("jobs"), std::to_string(batch_jobs));
+                r.in_process = false;
+                r.extra.emplace_back(_X("per_job_us"), r.stats.p50 / batch_jobs);
+                bench::report(opts, r);
+            }
+
+            if (server > 0)
+            {
+                // A server that stopped early means the launcher fell back.
+                if (::waitpid(server, nullptr, WNOHANG) != 0)
+                {
+                    std::fprintf(stderr, "The fork server exited while being measured\n");
+                }
+                ::kill(server, SIGTERM);
+                while (::waitpid(server, nullptr, 0) < 0 && errno == EINTR)
+                {
+                }
+            }
+        }
+
+        if (opts.keep)
+        {
+            std::fprintf(stderr, "Keeping layout at %s\n", root.c_str());
+        }
+        else
+        {
+            bench::remove_tree(root);
+        }
+    }
+    return 0;
+}
@@ -6,17 +6,27 @@
 #include "coreclr.h"
 
 arguments_t::arguments_t() :
-    managed_application(_X("")),
     own_path(_X("")),
     app_dir(_X("")),
-    app_argc(0),
-    app_argv(nullptr),
-    nuget_packages(_X("")),
-    dotnet_packages_cache(_X("")),
+    deps_path(_X("")),
     dotnet_servicing(_X("")),
+    dotnet_ni_cache(_X("")),
+    dotnet_probe_roots(_X("")),
     dotnet_runtime_servicing(_X("")),
     dotnet_home(_X("")),
-    deps_path(_X(""))
+    nuget_packages(_X("")),
+    dotnet_packages_cache(_X("")),
+    managed_application(_X("")),
+    resource_defaults(true),
+    app_argc(0),
+    app_argv(nullptr),
+    background_bind(true),
+    bind_now(false),
+    resolve_daemon_timeout_ms(50),
+    resolve_daemon_verify(false),
+    prefetch(false),
+    resolve_bench_iterations(0),
+    resolve_bench_dump(false)
 {
 }
 
@@ -24,23 +34,121 @@ void display_help()
 {
     xerr <<
         _X("Usage: " HOST_EXE_NAME " [ASSEMBLY] [ARGUMENTS]\n")
-        _X("Execute the specified managed assembly with the passed in arguments\n\n")
+        _X("       " HOST_EXE_NAME " @FILE\n")
+        _X("Execute the specified managed assembly with the passed in arguments, or each\n")
+        _X("assembly and arguments line of FILE in turn under one runtime\n\n")
         _X("The Host's behavior can be altered using the following environment variables:\n")
         _X(" DOTNET_HOME            Set the dotnet home directory. The CLR is expected to be in the runtime subdirectory of this directory. Overrides all other values for CLR search paths\n")
-        _X(" COREHOST_TRACE          Set to affect trace levels (0 = Errors only (default), 1 = Warnings, 2 = Info, 3 = Verbose)\n");
+        _X(" DOTNET_NI_CACHE        Use precompiled images of package assemblies from the dotnet_ni_cache_index.txt of this directory's <rid> subdirectory\n")
+        _X(" DOTNET_PROBE_ROOTS     Path separated package store dirs to look for package assets in, in order, before NUGET_PACKAGES. Stores\n")
+        _X("                         with a sorted dotnet_store_manifest.txt of their files are looked up in it instead of the file system\n")
+        _X(" COREHOST_ISA            Comma separated instruction set variants of native assets to pick (e.g. avx2,avx), best first, instead of\n")
+        _X("                         those the CPU supports. Set to none for baseline builds only\n")
+        _X(" COREHOST_UI_CULTURES    Comma separated UI cultures (e.g. de-DE,fr) to only probe the culture assets of, with those of their\n")
+        _X("                         parent cultures. Set to 1 for the culture of LC_ALL, LC_MESSAGES or LANG\n")
+        _X(" COREHOST_TRACE          Set to affect trace levels (0 = Errors only (default), 1 = Warnings, 2 = Info, 3 = Verbose)\n")
+        _X(" COREHOST_TRACEFILE      Append trace output to this file instead of stderr\n")
+        _X(" COREHOST_BACKGROUND_BIND  Set to 0 to load CoreCLR only after resolving the app's dependencies\n")
+        _X(" COREHOST_BIND_NOW       Set to 1 to process all CoreCLR relocations when it is loaded\n")
+        _X(" COREHOST_RESOLVE_CACHE  Set to 1, or to a file path, to share resolved probe paths between launches through a memory mapped cache\n")
+        _X(" COREHOST_RESOLVE_DAEMON  Set to 1, or to a socket path, to have a running corehost_resolved resolve the app\n")
+        _X(" COREHOST_RESOLVE_DAEMON_TIMEOUT_MS  How long to wait on the resolution daemon before resolving in-process (default 50)\n")
+        _X(" COREHOST_RESOLVE_DAEMON_VERIFY  Set to 1 to also resolve in-process and report any difference from the daemon's answer\n")
+        _X(" COREHOST_ZYGOTE_SERVE   Set to 1, or to a socket path, to resolve and load the app once and serve corehost_launch requests with forked copies of it\n")
+        _X(" COREHOST_BATCH_RESULTS  In batch mode (" HOST_EXE_NAME " @FILE), write each job's exit code and assembly to this file\n")
+        _X(" COREHOST_SERVER_GC      Set to 0 to use the workstation GC. Overrides System.GC.Server in <app>.runtimeconfig.json\n")
+        _X(" COREHOST_GC_CONCURRENT, COREHOST_GC_RETAIN_VM, COREHOST_GC_HEAP_COUNT, COREHOST_GC_HEAP_AFFINITIZE_MASK,\n")
+        _X(" COREHOST_GC_NO_AFFINITIZE, COREHOST_GC_HEAP_HARD_LIMIT, COREHOST_GC_HEAP_HARD_LIMIT_PERCENT,\n")
+        _X(" COREHOST_GC_LARGE_PAGES, COREHOST_THREADPOOL_MIN_THREADS, COREHOST_THREADPOOL_MAX_THREADS\n")
+        _X("                         Override the System.GC.* and System.Threading.ThreadPool.* properties of the same name in <app>.runtimeconfig.json\n")
+        _X(" COREHOST_FAST_EXIT      Set to 1 to exit with the app's exit code as soon as it returns, without shutting CoreCLR down or unloading it.\n")
+        _X("                         Overrides Microsoft.Host.FastExit in <app>.runtimeconfig.json\n")
+        _X(" COREHOST_SHUTDOWN_TIMEOUT_MS  Shut CoreCLR down on a helper thread and exit anyway if that takes longer than this.\n")
+        _X("                         Overrides Microsoft.Host.ShutdownTimeoutMs in <app>.runtimeconfig.json\n")
+        _X(" COREHOST_TRIM_TPA       Set to 1 to only put the assemblies the app references, directly or not, in the TPA and probe for\n")
+        _X("                         the rest. Overrides Microsoft.Host.TrimTpa in <app>.runtimeconfig.json\n")
+        _X(" COREHOST_NATIVE_VIEW    Set to 1 to probe for native libraries in one dir of links to them, kept in <app>.native_view, and\n")
+        _X("                         then the CLR dir. Overrides Microsoft.Host.NativeView in <app>.runtimeconfig.json\n")
+        _X(" COREHOST_RESOURCE_DEFAULTS  Set to 0 to not derive unset GC and thread pool knobs from the CPU quota, affinity and memory limit\n")
+        _X(" COREHOST_PREFETCH       Set to 1 to record the files the app maps in <app>.prefetch and prefetch them on the next launch\n")
+        _X(" COREHOST_PRELOAD_NATIVE  Comma separated file names of native assets (e.g. libSkiaSharp.so) to load on helper threads, their\n")
+        _X("                         dependencies first, while CoreCLR starts. Set to 1 for the native assets in <app>.prefetch\n")
+        _X(" COREHOST_RESOLVE_BENCH  Resolve the app this many times, report per-phase timings and exit without running it\n")
+        _X(" COREHOST_RESOLVE_BENCH_DUMP  Set to 1 to also print the resolved paths in resolve benchmark mode\n");
 }
 
-bool parse_arguments(const int argc, const pal::char_t* argv[], arguments_t& args)
+pal::string_t get_default_deps_path(const pal::string_t& app_base, const pal::string_t& managed_application)
 {
-    // Get the full name of the application
-    if (!pal::get_own_executable_path(&args.own_path) || !pal::realpath(&args.own_path))
+    auto app_name = get_filename(managed_application);
+
+    pal::string_t deps_path;
+    deps_path.reserve(app_base.length() + 1 + app_name.length() + 5);
+    deps_path.append(app_base);
+    deps_path.push_back(DIR_SEPARATOR);
+    deps_path.append(app_name, 0, app_name.find_last_of(_X(".")));
+    deps_path.append(_X(".deps"));
+    return deps_path;
+}
+
+// -----------------------------------------------------------------------------
+// The UI culture the runtime takes from the locale environment, by POSIX
+// precedence: "de_DE.UTF-8@euro" and "de_DE" are "de-DE". The C and POSIX
+// locales have none, nor does an unset locale, and so yield "none".
+//
+static void get_locale_ui_culture(const host_context_t* context, pal::string_t* culture)
+{
+    culture->clear();
+    for (const pal::char_t* name : { _X("LC_ALL"), _X("LC_MESSAGES"), _X("LANG") })
+    {
+        // An empty variable counts as unset.
+        if (host_context_getenv(context, name, culture) && !culture->empty())
+        {
+            break;
+        }
+    }
+
+    // The codeset and the modifier are both optional.
+    auto end = culture->find_first_of(_X(".@"));
+    if (end != pal::string_t::npos)
+    {
+        culture->resize(end);
+    }
+    replace_char(culture, _X('_'), _X('-'));
+    if (culture->empty() || *culture == _X("C") || *culture == _X("POSIX"))
+    {
+        culture->assign(_X("none"));
+    }
+}
+
+bool set_managed_application(const pal::string_t& path, arguments_t& args)
+{
+    args.managed_application = path;
+    if (!pal::realpath(&args.managed_application))
+    {
+        trace::error(_X("Failed to locate managed application: %s"), path.c_str());
+        return false;
+    }
+    args.app_dir = get_directory(args.managed_application);
+    args.deps_path = get_default_deps_path(args.app_dir, args.managed_application);
+    args.runtime_config_path = get_default_runtime_config_path(args.app_dir, args.managed_application);
+    return true;
+}
+
+bool parse_arguments(const int argc, const pal::char_t* argv[], arguments_t& args, const host_context_t* context)
+{
+    // Get the full name of the application, unless the executable already has
+    if (context != nullptr && context->own_path != nullptr)
+    {
+        args.own_path = context->own_path;
+    }
+    else if (!pal::get_own_executable_path(&args.own_path) || !pal::realpath(&args.own_path))
     {
         trace::error(_X("Failed to locate current executable"));
         return false;
     }
 
     auto own_name = get_filename(args.own_path);
-    auto own_dir = get_directory(args.own_path);
+    auto own_dir = (context != nullptr && context->own_dir != nullptr) ? pal::string_t(context->own_dir) : get_directory(args.own_path);
 
     if (own_name.compare(HOST_EXE_NAME) == 0)
     {
@@ -50,15 +158,33 @@ bool parse_arguments(const int argc, const pal::char_t* argv[], arguments_t& arg
             display_help();
             return false;
         }
-        args.managed_application = pal::string_t(argv[1]);
-        if (!pal::realpath(&args.managed_application))
+        if (argv[1][0] == _X('@'))
         {
-            trace::error(_X("Failed to locate managed application: %s"), args.managed_application.c_str());
-            return false;
+            // Batch mode: the jobs in the response file name the apps.
+            args.batch_file = &argv[1][1];
+            if (argc > 2)
+            {
+                trace::error(_X("Batch mode takes no arguments after %s, give each job its own in the batch file"), argv[1]);
+                return false;
+            }
+            if (!pal::realpath(&args.batch_file))
+            {
+                trace::error(_X("Failed to locate batch file: %s"), &argv[1][1]);
+                return false;
+            }
+        }
+        else
+        {
+            args.managed_application = pal::string_t(argv[1]);
+            if (!pal::realpath(&args.managed_application))
+            {
+                trace::error(_X("Failed to locate managed application: %s"), args.managed_application.c_str());
+                return false;
+            }
+            args.app_dir = get_directory(args.managed_application);
+            args.app_argc = argc - 2;
+            args.app_argv = &argv[2];
         }
-        args.app_dir = get_directory(args.managed_application);
-        args.app_argc = argc - 2;
-        args.app_argv = &argv[2];
     }
     else
     {
@@ -96,22 +222,106 @@ bool parse_arguments(const int argc, const pal::char_t* argv[], arguments_t& arg
         }
     }
     
-    if (args.deps_path.empty())
+    if (args.deps_path.empty() && !args.managed_application.empty())
+    {
+        args.deps_path = get_default_deps_path(args.app_dir, args.managed_application);
+    }
+    if (!args.managed_application.empty())
     {
-        const auto& app_base = args.app_dir;
-        auto app_name = get_filename(args.managed_application);
+        args.runtime_config_path = get_default_runtime_config_path(args.app_dir, args.managed_application);
+    }
+    read_runtime_config_overrides(context, &args.runtime_config_overrides);
+
+    host_context_getenv(context, _X("NUGET_PACKAGES"), &args.nuget_packages);
+    host_context_getenv(context, _X("DOTNET_PACKAGES_CACHE"), &args.dotnet_packages_cache);
+    host_context_getenv(context, _X("DOTNET_SERVICING"), &args.dotnet_servicing);
+    host_context_getenv(context, _X("DOTNET_NI_CACHE"), &args.dotnet_ni_cache);
+    host_context_getenv(context, _X("DOTNET_PROBE_ROOTS"), &args.dotnet_probe_roots);
+    host_context_getenv(context, _X("COREHOST_ISA"), &args.isa_variants);
+    host_context_getenv(context, _X("DOTNET_RUNTIME_SERVICING"), &args.dotnet_runtime_servicing);
+    host_context_getenv(context, _X("DOTNET_HOME"), &args.dotnet_home);
 
-        args.deps_path.reserve(app_base.length() + 1 + app_name.length() + 5);
-        args.deps_path.append(app_base);
-        args.deps_path.push_back(DIR_SEPARATOR);
-        args.deps_path.append(app_name, 0, app_name.find_last_of(_X(".")));
-        args.deps_path.append(_X(".deps"));
+    pal::string_t flag;
+    if (host_context_getenv(context, _X("COREHOST_RESOURCE_DEFAULTS"), &flag))
+    {
+        args.resource_defaults = pal::xtoi(flag.c_str()) != 0;
+    }
+    if (host_context_getenv(context, _X("COREHOST_BACKGROUND_BIND"), &flag))
+    {
+        args.background_bind = pal::xtoi(flag.c_str()) != 0;
+    }
+    if (host_context_getenv(context, _X("COREHOST_BIND_NOW"), &flag))
+    {
+        args.bind_now = pal::xtoi(flag.c_str()) != 0;
+    }
+    if (host_context_getenv(context, _X("COREHOST_PREFETCH"), &flag))
+    {
+        args.prefetch = pal::xtoi(flag.c_str()) != 0;
     }
+    if (host_context_getenv(context, _X("COREHOST_PRELOAD_NATIVE"), &flag) && flag != _X("0"))
+    {
+        args.preload_native = flag;
+    }
+    if (host_context_getenv(context, _X("COREHOST_RESOLVE_CACHE"), &flag) && flag != _X("0"))
+    {
+        if (flag == _X("1"))
+        {
+            pal::get_default_resolve_cache_path(&args.resolve_cache);
+        }
+        else
+        {
+            args.resolve_cache = flag;
+        }
+    }
+    if (host_context_getenv(context, _X("COREHOST_RESOLVE_DAEMON"), &flag) && flag != _X("0"))
+    {
+        if (flag == _X("1"))
+        {
+            pal::get_default_resolve_daemon_path(&args.resolve_daemon);
+        }
+        else
+        {
+            args.resolve_daemon = flag;
+        }
+        if (host_context_getenv(context, _X("COREHOST_RESOLVE_DAEMON_TIMEOUT_MS"), &flag))
+        {
+            args.resolve_daemon_timeout_ms = std::max(1, pal::xtoi(flag.c_str()));
+        }
+        args.resolve_daemon_verify = host_context_getenv(context, _X("COREHOST_RESOLVE_DAEMON_VERIFY"), &flag) && pal::xtoi(flag.c_str()) != 0;
+    }
+
+    if (host_context_getenv(context, _X("COREHOST_UI_CULTURES"), &flag) && flag != _X("0"))
+    {
+        if (flag == _X("1"))
+        {
+            get_locale_ui_culture(context, &args.ui_cultures);
+        }
+        else
+        {
+            args.ui_cultures = flag;
+        }
+        trace::verbose(_X("Only probing the culture assets of UI cultures %s"), args.ui_cultures.c_str());
+    }
+
+    host_context_getenv(context, _X("COREHOST_BATCH_RESULTS"), &args.batch_results);
 
-    pal::getenv(_X("NUGET_PACKAGES"), &args.nuget_packages);
-    pal::getenv(_X("DOTNET_PACKAGES_CACHE"), &args.dotnet_packages_cache);
-    pal::getenv(_X("DOTNET_SERVICING"), &args.dotnet_servicing);
-    pal::getenv(_X("DOTNET_RUNTIME_SERVICING"), &args.dotnet_runtime_servicing);
-    pal::getenv(_X("DOTNET_HOME"), &args.dotnet_home);
+    if (host_context_getenv(context, _X("COREHOST_ZYGOTE_SERVE"), &flag) && flag != _X("0"))
+    {
+        if (flag == _X("1"))
+        {
+            pal::get_default_zygote_path(args.managed_application, &args.zygote);
+        }
+        else
+        {
+            args.zygote = flag;
+        }
+    }
+
+    pal::string_t bench;
+    if (host_context_getenv(context, _X("COREHOST_RESOLVE_BENCH"), &bench))
+    {
+        args.resolve_bench_iterations = pal::xtoi(bench.c_str());
+        args.resolve_bench_dump = host_context_getenv(context, _X("COREHOST_RESOLVE_BENCH_DUMP"), &bench) && pal::xtoi(bench.c_str()) > 0;
+    }
     return true;
 }
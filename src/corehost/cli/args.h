@@ -7,6 +7,8 @@
 #include "utils.h"
 #include "pal.h"
 #include "trace.h"
+#include "libhost.h"
+#include "runtime_config.h"
 
 static const pal::string_t s_depsArgPrefix = _X("--depsfile:");
 
@@ -16,18 +18,82 @@ struct arguments_t
     pal::string_t app_dir;
     pal::string_t deps_path;
     pal::string_t dotnet_servicing;
+    pal::string_t dotnet_ni_cache;
+
+    // Package store roots to look for package assets in, in order, before
+    // the package restore dir.
+    pal::string_t dotnet_probe_roots;
+
+    // Comma separated ISA variants of native assets to pick, instead of
+    // those the CPU supports. Empty when not overridden.
+    pal::string_t isa_variants;
+
+    // Comma separated UI cultures whose culture assets alone to probe, or
+    // "none" for no culture assets. Empty to probe those of every culture.
+    pal::string_t ui_cultures;
+
     pal::string_t dotnet_runtime_servicing;
     pal::string_t dotnet_home;
     pal::string_t nuget_packages;
     pal::string_t dotnet_packages_cache;
     pal::string_t managed_application;
 
+    // The app's runtime config file, and the knobs the environment overrides.
+    pal::string_t runtime_config_path;
+    runtime_config_t::properties_t runtime_config_overrides;
+
+    // Derive the GC and thread pool knobs left unset from the CPU and memory
+    // limits of the process (default on).
+    bool resource_defaults;
+
     int app_argc;
     const pal::char_t** app_argv;
 
+    // Bind CoreCLR on a helper thread while resolving (default on), and
+    // whether to resolve all of its relocations at load time.
+    bool background_bind;
+    bool bind_now;
+
+    // Shared resolution cache file, empty when not in use.
+    pal::string_t resolve_cache;
+
+    // Resolution daemon socket, empty when not in use, how long to wait on
+    // it and whether to check its answers against an in-process resolution.
+    pal::string_t resolve_daemon;
+    int resolve_daemon_timeout_ms;
+    bool resolve_daemon_verify;
+
+    // Batch mode: response file of jobs (corehost @FILE), and where to write
+    // their exit codes. Empty otherwise.
+    pal::string_t batch_file;
+    pal::string_t batch_results;
+
+    // Socket to serve the app on as a fork server, empty when not in use.
+    pal::string_t zygote;
+
+    // Warm the page cache from, and record, the app's prefetch profile.
+    bool prefetch;
+
+    // Native libraries to load on helper threads while CoreCLR starts: "1"
+    // for those in the app's prefetch profile, or comma separated file
+    // names. Empty when not in use.
+    pal::string_t preload_native;
+
+    // Resolve-only benchmark mode: when non-zero, resolve this many times,
+    // report timings and exit without running the app.
+    int resolve_bench_iterations;
+    bool resolve_bench_dump;
+
     arguments_t();
 };
 
-bool parse_arguments(const int argc, const pal::char_t* argv[], arguments_t& args);
+// Point "args" at the app "path": its dir and its default deps and runtime
+// config files.
+bool set_managed_application(const pal::string_t& path, arguments_t& args);
+
+// "context", when not null, is what the executable already knows about this
+// launch and is used instead of asking the system again.
+
+bool parse_arguments(const int argc, const pal::char_t* argv[], arguments_t& args, const host_context_t* context = nullptr);
 
 #endif // ARGS_H
@@ -0,0 +1,367 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "trace.h"
+#include "assembly_refs.h"
+
+namespace
+{
+// Metadata tables, by number (ECMA-335 II.22). Only those that come before
+// AssemblyRef, or that coded indices of those point into, are needed.
+enum table_t
+{
+    Module = 0x00, TypeRef = 0x01, TypeDef = 0x02, FieldPtr = 0x03, Field = 0x04, MethodPtr = 0x05,
+    MethodDef = 0x06, ParamPtr = 0x07, Param = 0x08, InterfaceImpl = 0x09, MemberRef = 0x0a,
+    Constant = 0x0b, CustomAttribute = 0x0c, FieldMarshal = 0x0d, DeclSecurity = 0x0e,
+    ClassLayout = 0x0f, FieldLayout = 0x10, StandAloneSig = 0x11, EventMap = 0x12, EventPtr = 0x13,
+    Event = 0x14, PropertyMap = 0x15, PropertyPtr = 0x16, Property = 0x17, MethodSemantics = 0x18,
+    MethodImpl = 0x19, ModuleRef = 0x1a, TypeSpec = 0x1b, ImplMap = 0x1c, FieldRVA = 0x1d,
+    ENCLog = 0x1e, ENCMap = 0x1f, Assembly = 0x20, AssemblyProcessor = 0x21, AssemblyOS = 0x22,
+    AssemblyRef = 0x23, File = 0x26, ExportedType = 0x27, ManifestResource = 0x28,
+    GenericParam = 0x2a, MethodSpec = 0x2b, GenericParamConstraint = 0x2c,
+    TableCount = 0x40
+};
+
+// Bounds checked little-endian reads from part of a mapped file.
+struct view_t
+{
+    const uint8_t* data;
+    size_t size;
+
+    bool has(uint64_t offset, uint64_t length) const
+    {
+        return offset <= size && length <= size - offset;
+    }
+
+    // "length" is 1, 2 or 4 and the caller checked has().
+    uint32_t read(size_t offset, size_t length) const
+    {
+        uint32_t value = 0;
+        for (size_t i = 0; i < length; ++i)
+        {
+            value |= (uint32_t) data[offset + i] << (8 * i);
+        }
+        return value;
+    }
+
+    view_t sub(size_t offset, size_t length) const
+    {
+        return view_t { data + offset, length };
+    }
+};
+
+// -----------------------------------------------------------------------------
+// The metadata of a PE file: find the CLI header through the data
+// directories and map its RVA to a file offset through the section table.
+//
+bool find_metadata(const view_t& file, view_t* metadata)
+{
+    if (!file.has(0, 0x40) || file.read(0, 2) != 0x5a4d) // "MZ"
+    {
+        return false;
+    }
+    size_t pe = file.read(0x3c, 4);
+    if (!file.has(pe, 24) || file.read(pe, 4) != 0x00004550) // "PE\0\0"
+    {
+        return false;
+    }
+
+    size_t coff = pe + 4;
+    size_t section_count = file.read(coff + 2, 2);
+    size_t optional_size = file.read(coff + 16, 2);
+    size_t optional = coff + 20;
+    if (optional_size < 2 || !file.has(optional, optional_size))
+    {
+        return false;
+    }
+
+    // The data directories follow the PE32 or PE32+ specific fields; the
+    // CLI header is the 15th.
+    uint32_t magic = file.read(optional, 2);
+    size_t directories = (magic == 0x10b) ? 96 : (magic == 0x20b) ? 112 : 0;
+    const size_t CLI_HEADER_DIRECTORY = 14;
+    if (directories == 0 || optional_size < directories + (CLI_HEADER_DIRECTORY + 1) * 8 ||
+        file.read(optional + directories - 4, 4) <= CLI_HEADER_DIRECTORY)
+    {
+        return false;
+    }
+    uint32_t cli_rva = file.read(optional + directories + CLI_HEADER_DIRECTORY * 8, 4);
+
+    size_t sections = optional + optional_size;
+    if (cli_rva == 0 || !file.has(sections, section_count * 40))
+    {
+        return false;
+    }
+    auto to_offset = [&] (uint32_t rva, size_t* offset) {
+        for (size_t i = 0; i < section_count; ++i)
+        {
+            size_t section = sections + i * 40;
+            uint32_t address = file.read(section + 12, 4);
+            uint32_t raw_size = file.read(section + 16, 4);
+            if (rva >= address && rva - address < raw_size)
+            {
+                *offset = (size_t) file.read(section + 20, 4) + (rva - address);
+                return true;
+            }
+        }
+        return false;
+    };
+
+    size_t cli;
+    if (!to_offset(cli_rva, &cli) || !file.has(cli, 16))
+    {
+        return false;
+    }
+    size_t offset;
+    uint32_t size = file.read(cli + 12, 4);
+    if (!to_offset(file.read(cli + 8, 4), &offset) || !file.has(offset, size))
+    {
+        return false;
+    }
+    *metadata = file.sub(offset, size);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// The table ("#~", or "#-" when uncompressed) and "#Strings" streams of the
+// metadata.
+//
+bool find_streams(const view_t& metadata, view_t* tables, view_t* strings)
+{
+    if (!metadata.has(0, 16) || metadata.read(0, 4) != 0x424a5342) // "BSJB"
+    {
+        return false;
+    }
+    size_t offset = 16 + (size_t) metadata.read(12, 4);
+    if (!metadata.has(offset, 4))
+    {
+        return false;
+    }
+    size_t stream_count = metadata.read(offset + 2, 2);
+    offset += 4;
+
+    bool have_tables = false;
+    bool have_strings = false;
+    for (size_t i = 0; i < stream_count; ++i)
+    {
+        if (!metadata.has(offset, 8))
+        {
+            return false;
+        }
+        uint32_t stream_offset = metadata.read(offset, 4);
+        uint32_t stream_size = metadata.read(offset + 4, 4);
+        offset += 8;
+
+        // Null terminated name, padded to four bytes.
+        std::string name;
+        while (metadata.has(offset, 1) && metadata.data[offset] != 0 && name.length() < 32)
+        {
+            name.push_back((char) metadata.data[offset++]);
+        }
+        offset = (offset + 4) & ~(size_t) 3;
+
+        if (!metadata.has(stream_offset, stream_size))
+        {
+            return false;
+        }
+        if (name == "#~" || name == "#-")
+        {
+            *tables = metadata.sub(stream_offset, stream_size);
+            have_tables = true;
+        }
+        else if (name == "#Strings")
+        {
+            *strings = metadata.sub(stream_offset, stream_size);
+            have_strings = true;
+        }
+    }
+    return have_tables && have_strings;
+}
+
+// -----------------------------------------------------------------------------
+// Sizes of the columns of the table stream, which depend on the heap sizes
+// and the row counts (ECMA-335 II.24.2.6).
+//
+class columns_t
+{
+public:
+    columns_t(uint32_t heap_sizes, const uint32_t* rows)
+        : m_rows(rows)
+    {
+        string = (heap_sizes & 0x01) ? 4 : 2;
+        guid = (heap_sizes & 0x02) ? 4 : 2;
+        blob = (heap_sizes & 0x04) ? 4 : 2;
+    }
+
+    size_t index(table_t table) const
+    {
+        return m_rows[table] < 0x10000 ? 2 : 4;
+    }
+
+    // An index into one of "tables", with the table in its low "tag_bits".
+    size_t coded(std::initializer_list<table_t> tables, unsigned tag_bits) const
+    {
+        for (table_t table : tables)
+        {
+            if (m_rows[table] >= (1u << (16 - tag_bits)))
+            {
+                return 4;
+            }
+        }
+        return 2;
+    }
+
+    size_t type_def_or_ref() const { return coded({ TypeDef, TypeRef, TypeSpec }, 2); }
+    size_t has_constant() const { return coded({ Field, Param, Property }, 2); }
+    size_t has_custom_attribute() const
+    {
+        return coded({ MethodDef, Field, TypeRef, TypeDef, Param, InterfaceImpl, MemberRef, Module,
+            DeclSecurity, Property, Event, StandAloneSig, ModuleRef, TypeSpec, Assembly, AssemblyRef,
+            File, ExportedType, ManifestResource, GenericParam, GenericParamConstraint, MethodSpec }, 5);
+    }
+    size_t has_field_marshal() const { return coded({ Field, Param }, 1); }
+    size_t has_decl_security() const { return coded({ TypeDef, MethodDef, Assembly }, 2); }
+    size_t member_ref_parent() const { return coded({ TypeDef, TypeRef, ModuleRef, MethodDef, TypeSpec }, 3); }
+    size_t has_semantics() const { return coded({ Event, Property }, 1); }
+    size_t method_def_or_ref() const { return coded({ MethodDef, MemberRef }, 1); }
+    size_t member_forwarded() const { return coded({ Field, MethodDef }, 1); }
+    size_t custom_attribute_type() const { return coded({ MethodDef, MemberRef }, 3); }
+    size_t resolution_scope() const { return coded({ Module, ModuleRef, AssemblyRef, TypeRef }, 2); }
+
+    // Bytes in a row of "table", for the tables up to AssemblyRef.
+    size_t row_size(table_t table) const
+    {
+        switch (table)
+        {
+        case Module: return 2 + string + 3 * guid;
+        case TypeRef: return resolution_scope() + 2 * string;
+        case TypeDef: return 4 + 2 * string + type_def_or_ref() + index(Field) + index(MethodDef);
+        case FieldPtr: return index(Field);
+        case Field: return 2 + string + blob;
+        case MethodPtr: return index(MethodDef);
+        case MethodDef: return 4 + 2 + 2 + string + blob + index(Param);
+        case ParamPtr: return index(Param);
+        case Param: return 2 + 2 + string;
+        case InterfaceImpl: return index(TypeDef) + type_def_or_ref();
+        case MemberRef: return member_ref_parent() + string + blob;
+        case Constant: return 2 + has_constant() + blob;
+        case CustomAttribute: return has_custom_attribute() + custom_attribute_type() + blob;
+        case FieldMarshal: return has_field_marshal() + blob;
+        case DeclSecurity: return 2 + has_decl_security() + blob;
+        case ClassLayout: return 2 + 4 + index(TypeDef);
+        case FieldLayout: return 4 + index(Field);
+        case StandAloneSig: return blob;
+        case EventMap: return index(TypeDef) + index(Event);
+        case EventPtr: return index(Event);
+        case Event: return 2 + string + type_def_or_ref();
+        case PropertyMap: return index(TypeDef) + index(Property);
+        case PropertyPtr: return index(Property);
+        case Property: return 2 + string + blob;
+        case MethodSemantics: return 2 + index(MethodDef) + has_semantics();
+        case MethodImpl: return index(TypeDef) + 2 * method_def_or_ref();
+        case ModuleRef: return string;
+        case TypeSpec: return blob;
+        case ImplMap: return 2 + member_forwarded() + string + index(ModuleRef);
+        case FieldRVA: return 4 + index(Field);
+        case ENCLog: return 4 + 4;
+        case ENCMap: return 4;
+        case Assembly: return 4 + 4 * 2 + 4 + blob + 2 * string;
+        case AssemblyProcessor: return 4;
+        case AssemblyOS: return 4 + 4 + 4;
+        case AssemblyRef: return 4 * 2 + 4 + blob + 2 * string + blob;
+        default: return 0;
+        }
+    }
+
+    size_t string;
+    size_t guid;
+    size_t blob;
+
+private:
+    const uint32_t* m_rows;
+};
+
+bool read_refs(const view_t& file, std::vector<pal::string_t>* names)
+{
+    view_t metadata, tables, strings;
+    if (!find_metadata(file, &metadata) || !find_streams(metadata, &tables, &strings) || !tables.has(0, 24))
+    {
+        return false;
+    }
+
+    uint32_t heap_sizes = tables.read(6, 1);
+    uint64_t valid = tables.read(8, 4) | ((uint64_t) tables.read(12, 4) << 32);
+    uint32_t rows[TableCount] = { };
+    size_t offset = 24;
+    for (int table = 0; table < TableCount; ++table)
+    {
+        if (valid & ((uint64_t) 1 << table))
+        {
+            if (!tables.has(offset, 4))
+            {
+                return false;
+            }
+            rows[table] = tables.read(offset, 4);
+            offset += 4;
+        }
+    }
+    // Uncompressed streams may have four more bytes here.
+    if (heap_sizes & 0x40)
+    {
+        offset += 4;
+    }
+
+    columns_t columns(heap_sizes, rows);
+    uint64_t table_offset = offset;
+    for (int table = 0; table < AssemblyRef; ++table)
+    {
+        table_offset += (uint64_t) rows[table] * columns.row_size((table_t) table);
+    }
+    size_t row_size = columns.row_size(AssemblyRef);
+    if (!tables.has(table_offset, (uint64_t) rows[AssemblyRef] * row_size))
+    {
+        return false;
+    }
+
+    size_t name_column = 4 * 2 + 4 + columns.blob;
+    for (uint32_t row = 0; row < rows[AssemblyRef]; ++row)
+    {
+        size_t name = tables.read(table_offset + row * row_size + name_column, columns.string);
+        if (!strings.has(name, 1))
+        {
+            return false;
+        }
+        const char* str = (const char*) strings.data + name;
+        size_t length = strnlen(str, strings.size - name);
+        if (length == strings.size - name)
+        {
+            return false;
+        }
+        pal::string_t value;
+        pal::to_palstring(std::string(str, length).c_str(), &value);
+        names->push_back(value);
+    }
+    return true;
+}
+} // end of anonymous namespace
+
+bool read_assembly_refs(const pal::string_t& path, std::vector<pal::string_t>* names)
+{
+    names->clear();
+
+    pal::mapped_file_t file;
+    if (!pal::map_file(path, &file))
+    {
+        trace::verbose(_X("Could not map %s to read its assembly references"), path.c_str());
+        return false;
+    }
+
+    bool ok = read_refs(view_t { (const uint8_t*) file.data, file.size }, names);
+    pal::unmap_file(&file);
+    if (!ok)
+    {
+        trace::verbose(_X("Could not read the assembly references of %s"), path.c_str());
+        names->clear();
+    }
+    return ok;
+}
@@ -0,0 +1,21 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef ASSEMBLY_REFS_H
+#define ASSEMBLY_REFS_H
+
+#include "pal.h"
+
+// -----------------------------------------------------------------------------
+// Simple names of the assemblies the assembly at "path" references, from the
+// AssemblyRef table of its ECMA-335 metadata. Only the PE headers, the
+// metadata root, the table header and that one table are read, through a
+// read-only mapping of the file. IL assemblies and precompiled images both
+// carry the table.
+//
+// Returns false if the file cannot be mapped or is not an assembly this can
+// read, with "names" left empty.
+//
+bool read_assembly_refs(const pal::string_t& path, std::vector<pal::string_t>* names);
+
+#endif // ASSEMBLY_REFS_H
@@ -0,0 +1,137 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <unordered_set>
+
+#include "batch.h"
+#include "trace.h"
+#include "utils.h"
+
+namespace
+{
+bool is_blank(pal::char_t c)
+{
+    return c == _X(' ') || c == _X('\t') || c == _X('\r');
+}
+
+// Split "line" into whitespace separated, optionally quoted, tokens. Returns
+// false on an unterminated quote.
+bool tokenize(const pal::string_t& line, std::vector<pal::string_t>* tokens)
+{
+    size_t i = 0;
+    while (i < line.length())
+    {
+        if (is_blank(line[i]))
+        {
+            ++i;
+            continue;
+        }
+
+        pal::string_t token;
+        bool quoted = false;
+        for (; i < line.length(); ++i)
+        {
+            pal::char_t c = line[i];
+            if (quoted && c == _X('\\') && i + 1 < line.length() && (line[i + 1] == _X('"') || line[i + 1] == _X('\\')))
+            {
+                token.push_back(line[++i]);
+            }
+            else if (c == _X('"'))
+            {
+                quoted = !quoted;
+            }
+            else if (!quoted && is_blank(c))
+            {
+                break;
+            }
+            else
+            {
+                token.push_back(c);
+            }
+        }
+        if (quoted)
+        {
+            return false;
+        }
+        tokens->push_back(token);
+    }
+    return true;
+}
+
+void merge_dirs(const pal::string_t& from, pal::string_t* into)
+{
+    std::vector<pal::string_t> dirs;
+    split(*into, PATH_SEPARATOR, &dirs);
+    std::unordered_set<pal::string_t> existing(dirs.begin(), dirs.end());
+    dirs.clear();
+    split(from, PATH_SEPARATOR, &dirs);
+    for (const auto& dir : dirs)
+    {
+        if (existing.insert(dir).second)
+        {
+            into->append(dir);
+            into->push_back(PATH_SEPARATOR);
+        }
+    }
+}
+} // end of anonymous namespace
+
+bool read_batch_file(const pal::string_t& path, std::vector<batch_job_t>* jobs)
+{
+    pal::ifstream_t file(path);
+    if (!file.good())
+    {
+        trace::error(_X("Could not open batch file %s"), path.c_str());
+        return false;
+    }
+
+    pal::string_t line;
+    for (int line_number = 1; std::getline(file, line); ++line_number)
+    {
+        std::vector<pal::string_t> tokens;
+        if (!tokenize(line, &tokens))
+        {
+            trace::error(_X("Unterminated quote in %s line %d"), path.c_str(), line_number);
+            return false;
+        }
+        if (tokens.empty() || tokens[0][0] == _X('#'))
+        {
+            continue;
+        }
+
+        batch_job_t job;
+        job.assembly = tokens[0];
+        job.argv.assign(tokens.begin() + 1, tokens.end());
+        jobs->push_back(std::move(job));
+    }
+    return true;
+}
+
+void merge_probe_paths(const probe_paths_t& from, probe_paths_t* into)
+{
+    std::vector<pal::string_t> assets;
+    split(into->tpa, PATH_SEPARATOR, &assets);
+    std::unordered_set<pal::string_t> names;
+    for (const auto& asset : assets)
+    {
+        names.insert(get_assembly_name(asset));
+    }
+    assets.clear();
+    split(from.tpa, PATH_SEPARATOR, &assets);
+    for (const auto& asset : assets)
+    {
+        if (names.insert(get_assembly_name(asset)).second)
+        {
+            into->tpa.append(asset);
+            into->tpa.push_back(PATH_SEPARATOR);
+        }
+        else
+        {
+            trace::verbose(_X("Batch TPA already has %s, skipping %s"), get_assembly_name(asset).c_str(), asset.c_str());
+        }
+    }
+
+    merge_dirs(from.native, &into->native);
+    merge_dirs(from.culture, &into->culture);
+    merge_dirs(from.app, &into->app);
+}
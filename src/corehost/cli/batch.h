@@ -0,0 +1,28 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "pal.h"
+#include "deps_resolver.h"
+
+// -----------------------------------------------------------------------------
+// Batch mode (corehost @FILE): the response file lists one job per line, an
+// assembly followed by its arguments, separated by whitespace. Arguments
+// with whitespace are double quoted, with \" and \\ escapes inside quotes.
+// Blank lines and lines starting with # are skipped.
+//
+struct batch_job_t
+{
+    pal::string_t assembly;
+    std::vector<pal::string_t> argv;
+};
+
+bool read_batch_file(const pal::string_t& path, std::vector<batch_job_t>* jobs);
+
+// Add the probe paths of another app in "from" to "into": assemblies whose
+// simple name "into" already has, and dirs it already has, are skipped.
+void merge_probe_paths(const probe_paths_t& from, probe_paths_t* into);
+
+#endif // BATCH_H
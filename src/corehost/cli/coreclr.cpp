@@ -2,12 +2,17 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <cassert>
+#include <future>
+#include <system_error>
 
 #include "coreclr.h"
 #include "utils.h"
 
 static pal::dll_t g_coreclr = nullptr;
 
+// Pending result of bind_async().
+static std::future<bool> g_bind_result;
+
 // Prototype of the coreclr_initialize function from coreclr.dll
 typedef pal::hresult_t(*coreclr_initialize_fn)(
     const char* exePath,
@@ -36,14 +41,14 @@ static coreclr_shutdown_fn coreclr_shutdown = nullptr;
 static coreclr_initialize_fn coreclr_initialize = nullptr;
 static coreclr_execute_assembly_fn coreclr_execute_assembly = nullptr;
 
-bool coreclr::bind(const pal::string_t& libcoreclr_path)
+bool coreclr::bind(const pal::string_t& libcoreclr_path, bool resolve_now)
 {
     assert(g_coreclr == nullptr);
 
     pal::string_t coreclr_dll_path(libcoreclr_path);
     append_path(&coreclr_dll_path, LIBCORECLR_NAME);
 
-    if (!pal::load_library(coreclr_dll_path.c_str(), &g_coreclr))
+    if (!pal::load_library(coreclr_dll_path.c_str(), &g_coreclr, resolve_now))
     {
         return false;
     }
@@ -55,6 +60,33 @@ bool coreclr::bind(const pal::string_t& libcoreclr_path)
     return true;
 }
 
+void coreclr::bind_async(const pal::string_t& libcoreclr_path, bool resolve_now)
+{
+    assert(!g_bind_result.valid());
+
+    try
+    {
+        g_bind_result = std::async(std::launch::async, [libcoreclr_path, resolve_now] () {
+            return coreclr::bind(libcoreclr_path, resolve_now);
+        });
+    }
+    catch (const std::system_error&)
+    {
+        // No thread available, bind inline instead.
+        trace::info(_X("Could not start background bind, binding CoreCLR inline"));
+        std::promise<bool> inline_result;
+        inline_result.set_value(bind(libcoreclr_path, resolve_now));
+        g_bind_result = inline_result.get_future();
+    }
+}
+
+bool coreclr::wait_for_bind()
+{
+    assert(g_bind_result.valid());
+
+    return g_bind_result.get();
+}
+
 void coreclr::unload()
 {
     assert(g_coreclr != nullptr && coreclr_initialize != nullptr);
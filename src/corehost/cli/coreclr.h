@@ -12,7 +12,13 @@ namespace coreclr
     typedef void* host_handle_t;
     typedef unsigned int domain_id_t;
 
-    bool bind(const pal::string_t& libcoreclr_path);
+    bool bind(const pal::string_t& libcoreclr_path, bool resolve_now = false);
+
+    // Start bind() on a helper thread so that loading and relocating the
+    // runtime overlaps with deps resolution. wait_for_bind() joins it and
+    // returns its result; it must be called before initialize().
+    void bind_async(const pal::string_t& libcoreclr_path, bool resolve_now);
+    bool wait_for_bind();
 
     void unload();
 
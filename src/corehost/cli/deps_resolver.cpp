@@ -123,7 +123,7 @@ void add_mscorlib_to_tpa(const pal::string_t& clr_dir, std::set<pal::string_t>*
     pal::string_t mscorlib_path = clr_dir + DIR_SEPARATOR + _X("mscorlib.dll");
     if (pal::file_exists(mscorlib_path))
     {
-        add_tpa_asset(_X("mscorlib"), mscorlib_ni_path, items, output);
+        add_tpa_asset(_X("mscorlib"), mscorlib_path, items, output);
         return;
     }
 }
@@ -155,21 +155,132 @@ void add_unique_path(
     existing->insert(real);
 }
 
+pal::string_t library_key(const deps_entry_t& entry)
+{
+    return entry.library_name + _X('|') + entry.library_version;
+}
+
+// Culture of a culture asset: the name of the dir it is in, as "de" is of
+// "lib/dnxcore50/de/Foo.resources.dll".
+pal::string_t get_asset_culture(const deps_entry_t& entry)
+{
+    size_t end = entry.relative_path.find_last_of(_X('/'));
+    if (end == pal::string_t::npos || end == 0)
+    {
+        return pal::string_t();
+    }
+    size_t start = entry.relative_path.find_last_of(_X('/'), end - 1);
+    start = (start == pal::string_t::npos) ? 0 : start + 1;
+    return entry.relative_path.substr(start, end - start);
+}
+
+bool contains_culture(const std::vector<pal::string_t>& cultures, const pal::string_t& culture)
+{
+    return std::any_of(cultures.begin(), cultures.end(),
+        [&] (const pal::string_t& c) { return pal::strcasecmp(c.c_str(), culture.c_str()) == 0; });
+}
+
+// Path of the asset of "entry" in the first of "stores" that has it.
+bool find_in_stores(const std::vector<package_store_t>& stores, const deps_entry_t& entry, pal::string_t* candidate)
+{
+    for (const package_store_t& store : stores)
+    {
+        if (store.find(entry, candidate))
+        {
+            return true;
+        }
+    }
+    return false;
+}
 } // end of anonymous namespace
 
+pal::string_t get_assembly_name(const pal::string_t& path)
+{
+    const pal::string_t managed_ext[] = { _X(".ni.dll"), _X(".dll"), _X(".ni.exe"), _X(".exe") };
+
+    pal::string_t file = get_filename(path);
+    for (const auto& ext : managed_ext)
+    {
+        if (file.length() > ext.length() &&
+            pal::strcasecmp(file.c_str() + file.length() - ext.length(), ext.c_str()) == 0)
+        {
+            return file.substr(0, file.length() - ext.length());
+        }
+    }
+    return file;
+}
+
+std::vector<pal::string_t> get_isa_variants(const arguments_t& args)
+{
+    if (args.isa_variants.empty())
+    {
+        return pal::get_cpu_isa_variants();
+    }
+
+    // "none" asks for baseline builds only.
+    std::vector<pal::string_t> variants;
+    pal::stringstream_t list(args.isa_variants);
+    pal::string_t variant;
+    while (std::getline(list, variant, _X(',')))
+    {
+        if (!variant.empty() && variant != _X("none"))
+        {
+            variants.push_back(variant);
+        }
+    }
+    return variants;
+}
+
 // -----------------------------------------------------------------------------
-// Given a "base" directory, yield the relative path of this file in the package
-// layout.
+// Expand the UI cultures of COREHOST_UI_CULTURES with their resource fallbacks:
+// "zh-Hans-CN" falls back to "zh-Hans" and then "zh", and Chinese regions fall
+// back to their script first, "zh-TW" to "zh-Hant".
 //
-// Parameters:
-//    base - The base directory to look for the relative path of this entry
-//    str  - If the method returns true, contains the file path for this deps
-//           entry relative to the "base" directory
-//
-// Returns:
-//    If the file exists in the path relative to the "base" directory.
+std::vector<pal::string_t> get_ui_cultures(const arguments_t& args)
+{
+    const std::pair<const pal::char_t*, const pal::char_t*> scripts[] = {
+        { _X("zh-CN"), _X("zh-Hans") },
+        { _X("zh-SG"), _X("zh-Hans") },
+        { _X("zh-TW"), _X("zh-Hant") },
+        { _X("zh-HK"), _X("zh-Hant") },
+        { _X("zh-MO"), _X("zh-Hant") },
+    };
+
+    // "none" asks for no culture assets at all.
+    std::vector<pal::string_t> cultures;
+    pal::stringstream_t list(args.ui_cultures);
+    pal::string_t culture;
+    while (std::getline(list, culture, _X(',')))
+    {
+        if (culture == _X("none"))
+        {
+            continue;
+        }
+        while (!culture.empty())
+        {
+            if (!contains_culture(cultures, culture))
+            {
+                cultures.push_back(culture);
+            }
+            for (const auto& script : scripts)
+            {
+                if (pal::strcasecmp(culture.c_str(), script.first) == 0 && !contains_culture(cultures, script.second))
+                {
+                    cultures.push_back(script.second);
+                }
+            }
+            size_t dash = culture.find_last_of(_X('-'));
+            culture.resize(dash == pal::string_t::npos ? 0 : dash);
+        }
+    }
+    return cultures;
+}
+
+// -----------------------------------------------------------------------------
+// Given a "base" directory, yield the path of this file in the package layout,
+// whether it exists or not.
 //
-bool deps_entry_t::to_full_path(const pal::string_t& base, pal::string_t* str) const
+void deps_entry_t::to_package_path(const pal::string_t& base, pal::string_t* str) const
 {
     pal::string_t& candidate = *str;
 
@@ -193,11 +304,28 @@ bool deps_entry_t::to_full_path(const pal::string_t& base, pal::string_t* str) c
     append_path(&candidate, library_name.c_str());
     append_path(&candidate, library_version.c_str());
     append_path(&candidate, pal_relative_path.c_str());
+}
+
+// -----------------------------------------------------------------------------
+// Given a "base" directory, yield the relative path of this file in the package
+// layout.
+//
+// Parameters:
+//    base - The base directory to look for the relative path of this entry
+//    str  - If the method returns true, contains the file path for this deps
+//           entry relative to the "base" directory
+//
+// Returns:
+//    If the file exists in the path relative to the "base" directory.
+//
+bool deps_entry_t::to_full_path(const pal::string_t& base, pal::string_t* str) const
+{
+    to_package_path(base, str);
 
-    bool exists = pal::file_exists(candidate);
+    bool exists = pal::file_exists(*str);
     if (!exists)
     {
-        candidate.clear();
+        str->clear();
     }
     return exists;
 }
@@ -235,34 +363,16 @@ bool deps_entry_t::to_hash_matched_path(const pal::string_t& base, pal::string_t
         return false;
     }
 
-    // First detect position of hyphen in [Algorithm]-[Hash] in the string.
-    size_t pos = library_hash.find(_X("-"));
-    if (pos == 0 || pos == pal::string_t::npos)
+    // Build the hash file path str.
+    pal::string_t hash_file;
+    if (!to_hash_file_path(base, &hash_file))
     {
-        trace::verbose(_X("Invalid hash %s value for deps file entry: %s"), library_hash.c_str(), library_name.c_str());
         return false;
     }
 
-    // Build the nupkg file name. Just reserve approx 8 char_t's for the algorithm name.
-    pal::string_t nupkg_filename;
-    nupkg_filename.reserve(library_name.length() + 1 + library_version.length() + 16);
-    nupkg_filename.append(library_name);
-    nupkg_filename.append(_X("."));
-    nupkg_filename.append(library_version);
-    nupkg_filename.append(_X(".nupkg."));
-    nupkg_filename.append(library_hash.substr(0, pos));
-
-    // Build the hash file path str.
-    pal::string_t hash_file;
-    hash_file.reserve(base.length() + library_name.length() + library_version.length() + nupkg_filename.length() + 3);
-    hash_file.assign(base);
-    append_path(&hash_file, library_name.c_str());
-    append_path(&hash_file, library_version.c_str());
-    append_path(&hash_file, nupkg_filename.c_str());
-
     // Read the contents of the hash file.
-    pal::ifstream_t fstream(hash_file);
-    if (!fstream.good())
+    auto fstream = pal::open_file(hash_file);
+    if (!fstream)
     {
         trace::verbose(_X("The hash file is invalid [%s]"), hash_file.c_str());
         return false;
@@ -270,13 +380,13 @@ bool deps_entry_t::to_hash_matched_path(const pal::string_t& base, pal::string_t
 
     // Obtain the hash from the file.
     std::string hash;
-    hash.assign(pal::istreambuf_iterator_t(fstream),
+    hash.assign(pal::istreambuf_iterator_t(*fstream),
         pal::istreambuf_iterator_t());
     pal::string_t pal_hash;
     pal::to_palstring(hash.c_str(), &pal_hash);
 
     // Check if contents match deps entry.
-    pal::string_t entry_hash = library_hash.substr(pos + 1);
+    pal::string_t entry_hash = library_hash.substr(library_hash.find(_X("-")) + 1);
     if (entry_hash != pal_hash)
     {
         trace::verbose(_X("The file hash [%s][%d] did not match entry hash [%s][%d]"),
@@ -288,6 +398,44 @@ bool deps_entry_t::to_hash_matched_path(const pal::string_t& base, pal::string_t
     return to_full_path(base, &candidate);
 }
 
+// -----------------------------------------------------------------------------
+// Given a "base" directory, yield the path of the hash file of this entry's
+// package, "{PackageName}/{PackageVersion}/{PackageName}.{PackageVersion}.nupkg.{HashAlgorithm}",
+// whether it exists or not.
+//
+// Returns:
+//    False if the entry's hash is not of the [Algorithm]-[Hash] form.
+//
+bool deps_entry_t::to_hash_file_path(const pal::string_t& base, pal::string_t* str) const
+{
+    pal::string_t& hash_file = *str;
+
+    hash_file.clear();
+
+    // First detect position of hyphen in [Algorithm]-[Hash] in the string.
+    size_t pos = library_hash.find(_X("-"));
+    if (pos == 0 || pos == pal::string_t::npos)
+    {
+        trace::verbose(_X("Invalid hash %s value for deps file entry: %s"), library_hash.c_str(), library_name.c_str());
+        return false;
+    }
+
+    // Build the nupkg file name. Just reserve approx 8 char_t's for the algorithm name.
+    pal::string_t nupkg_filename;
+    nupkg_filename.reserve(library_name.length() + 1 + library_version.length() + 16);
+    nupkg_filename.append(library_name);
+    nupkg_filename.append(_X("."));
+    nupkg_filename.append(library_version);
+    nupkg_filename.append(_X(".nupkg."));
+    nupkg_filename.append(library_hash.substr(0, pos));
+
+    hash_file.reserve(base.length() + library_name.length() + library_version.length() + nupkg_filename.length() + 3);
+    hash_file.assign(base);
+    append_path(&hash_file, library_name.c_str());
+    append_path(&hash_file, library_version.c_str());
+    append_path(&hash_file, nupkg_filename.c_str());
+    return true;
+}
 
 // -----------------------------------------------------------------------------
 // Load the deps file and parse its "entry" lines which contain the "fields" of
@@ -302,15 +450,15 @@ bool deps_resolver_t::load()
     }
 
     // Somehow the file stream could not be opened. This is an error.
-    pal::ifstream_t file(m_deps_path);
-    if (!file.good())
+    auto file = pal::open_file(m_deps_path);
+    if (!file)
     {
         return false;
     }
 
     // Parse the "entry" lines of the deps file.
     std::string stdline;
-    while (std::getline(file, stdline))
+    while (std::getline(*file, stdline))
     {
         pal::string_t line;
         pal::to_palstring(stdline.c_str(), &line);
@@ -329,9 +477,10 @@ bool deps_resolver_t::load()
             // &is_serviceable
         };
 
-        std::vector<pal::char_t> buf(line.length());
+        std::vector<pal::char_t> buf(line.length() + 1);
 
-        for (unsigned i = 0, offset = 0; i < sizeof(fields) / sizeof(fields[0]); ++i)
+        unsigned offset = 0;
+        for (unsigned i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i)
         {
             if (!(read_field(line, buf.data(), &offset, fields[i])))
             {
@@ -339,6 +488,12 @@ bool deps_resolver_t::load()
             }
         }
 
+        // Optional ISA variant of native assets.
+        if (offset < line.length() && line[offset] == _X('"') && !read_field(line, buf.data(), &offset, &entry.asset_variant))
+        {
+            return false;
+        }
+
         // Serviceable, if not false, default is true.
         entry.is_serviceable = pal::strcasecmp(is_serviceable.c_str(), _X("false")) != 0;
 
@@ -419,24 +574,27 @@ void deps_resolver_t::get_local_assemblies(const pal::string_t& dir)
 //
 // Description:
 //    First, add mscorlib to the TPA. Then for each deps entry, check if they
-//    are serviced. If they are not serviced, then look if they are present
-//    app local. Worst case, default to the primary and seconday package
-//    caches. Finally, for cases where deps file may not be present or if deps
-//    did not have an entry for an app local assembly, just use them from the
-//    app dir in the TPA path.
+//    are serviced. If they are not serviced, then look for a precompiled image
+//    of package assets in the NI cache, then whether they are present app
+//    local. Worst case, default to the primary and seconday package caches.
+//    Finally, for cases where deps file may not be present or if deps did not
+//    have an entry for an app local assembly, just use them from the app dir
+//    in the TPA path.
 //
 //  Parameters:
 //     app_dir           - The application local directory
-//     package_dir       - The directory path to where packages are restored
+//     stores            - The package stores of the probe roots, in order, and
+//                         the package restore dir
 //     package_cache_dir - The directory path to secondary cache for packages
 //     clr_dir           - The directory where the host loads the CLR
 //
 //  Returns:
 //     output - Pointer to a string that will hold the resolved TPA paths
+//     Whether every runtime asset of the deps file was found.
 //
-void deps_resolver_t::resolve_tpa_list(
+bool deps_resolver_t::resolve_tpa_list(
         const pal::string_t& app_dir,
-        const pal::string_t& package_dir,
+        const std::vector<package_store_t>& stores,
         const pal::string_t& package_cache_dir,
         const pal::string_t& clr_dir,
         pal::string_t* output)
@@ -445,6 +603,7 @@ void deps_resolver_t::resolve_tpa_list(
     get_local_assemblies(app_dir);
 
     std::set<pal::string_t> items;
+    bool complete = true;
 
     add_mscorlib_to_tpa(clr_dir, &items, output);
 
@@ -464,6 +623,12 @@ void deps_resolver_t::resolve_tpa_list(
         {
             add_tpa_asset(entry.asset_name, candidate, &items, output);
         }
+        // Is there a precompiled image of this package asset?
+        else if (entry.library_type == _X("Package") &&
+                m_ni_cache.find_image(entry.library_name, entry.library_version, entry.relative_path, &candidate))
+        {
+            add_tpa_asset(entry.asset_name, candidate, &items, output);
+        }
         // Is this entry present in the secondary package cache?
         else if (entry.to_hash_matched_path(package_cache_dir, &candidate))
         {
@@ -475,11 +640,16 @@ void deps_resolver_t::resolve_tpa_list(
             // TODO: Case insensitive look up?
             add_tpa_asset(entry.asset_name, m_local_assemblies.find(entry.asset_name)->second, &items, output);
         }
-        // Is this entry present in the package restore dir?
-        else if (entry.to_full_path(package_dir, &candidate))
+        // Is this entry present in a package store or the package restore dir?
+        else if (find_in_stores(stores, entry, &candidate))
         {
             add_tpa_asset(entry.asset_name, candidate, &items, output);
         }
+        else
+        {
+            trace::verbose(_X("Could not find %s of %s %s"), entry.relative_path.c_str(), entry.library_name.c_str(), entry.library_version.c_str());
+            complete = false;
+        }
     }
 
     // Finally, if the deps file wasn't present or has missing entries, then
@@ -488,6 +658,71 @@ void deps_resolver_t::resolve_tpa_list(
     {
         add_tpa_asset(kv.first, kv.second, &items, output);
     }
+    return complete;
+}
+
+// -----------------------------------------------------------------------------
+// Pick, for every library that ships variants of its native assets, the first
+// of "m_isa_variants" it ships, else its baseline build. A library with
+// neither gets none of its native assets probed rather than code this CPU
+// cannot run.
+//
+void deps_resolver_t::select_native_variants()
+{
+    m_native_variants.clear();
+
+    std::unordered_map<pal::string_t, std::set<pal::string_t>> shipped;
+    for (const deps_entry_t& entry : m_deps_entries)
+    {
+        if (entry.asset_type == _X("native"))
+        {
+            shipped[library_key(entry)].insert(entry.asset_variant);
+        }
+    }
+
+    for (const auto& library : shipped)
+    {
+        const std::set<pal::string_t>& variants = library.second;
+        if (variants.size() == 1 && variants.count(pal::string_t()))
+        {
+            continue;
+        }
+
+        auto best = std::find_if(m_isa_variants.begin(), m_isa_variants.end(),
+            [&] (const pal::string_t& variant) { return variants.count(variant) != 0; });
+        if (best != m_isa_variants.end())
+        {
+            trace::verbose(_X("Using the %s native assets of %s"), best->c_str(), library.first.c_str());
+            m_native_variants[library.first] = std::make_pair(true, *best);
+        }
+        else if (variants.count(pal::string_t()))
+        {
+            trace::verbose(_X("Using the baseline native assets of %s"), library.first.c_str());
+            m_native_variants[library.first] = std::make_pair(true, pal::string_t());
+        }
+        else
+        {
+            trace::warning(_X("No native assets of %s are built for this CPU"), library.first.c_str());
+            m_native_variants[library.first] = std::make_pair(false, pal::string_t());
+        }
+    }
+}
+
+bool deps_resolver_t::is_selected_variant(const deps_entry_t& entry) const
+{
+    if (entry.asset_type != _X("native") || m_native_variants.empty())
+    {
+        return true;
+    }
+    auto iter = m_native_variants.find(library_key(entry));
+    return iter == m_native_variants.end() ||
+        (iter->second.first && iter->second.second == entry.asset_variant);
+}
+
+bool deps_resolver_t::is_ui_culture(const deps_entry_t& entry) const
+{
+    return entry.asset_type != _X("culture") || !m_ui_cultures_only ||
+        contains_culture(m_ui_cultures, get_asset_culture(entry));
 }
 
 // -----------------------------------------------------------------------------
@@ -498,13 +733,16 @@ void deps_resolver_t::resolve_tpa_list(
 //    for both native images and culture specific resource images. Lookup for
 //    culture assemblies is done by looking up two levels above from the file
 //    path. Lookup for native images is done by looking up one level from the
-//    file path.
+//    file path. Of native assets built for several instruction sets, only the
+//    variant picked for this CPU is looked up, and with COREHOST_UI_CULTURES,
+//    only the culture assets of the UI cultures and their parents are.
 //
 //  Parameters:
 //     asset_type        - The type of the asset that needs lookup, currently
 //                         supports "culture" and "native"
 //     app_dir           - The application local directory
-//     package_dir       - The directory path to where packages are restored
+//     stores            - The package stores of the probe roots, in order, and
+//                         the package restore dir
 //     package_cache_dir - The directory path to secondary cache for packages
 //     clr_dir           - The directory where the host loads the CLR
 //
@@ -514,7 +752,7 @@ void deps_resolver_t::resolve_tpa_list(
 void deps_resolver_t::resolve_probe_dirs(
         const pal::string_t& asset_type,
         const pal::string_t& app_dir,
-        const pal::string_t& package_dir,
+        const std::vector<package_store_t>& stores,
         const pal::string_t& package_cache_dir,
         const pal::string_t& clr_dir,
         pal::string_t* output)
@@ -532,6 +770,10 @@ void deps_resolver_t::resolve_probe_dirs(
     };
     std::function<pal::string_t(const pal::string_t&)>& action = (asset_type == _X("culture")) ? culture : native;
 
+    auto probed = [&] (const deps_entry_t& entry) {
+        return entry.asset_type == asset_type && is_selected_variant(entry) && is_ui_culture(entry);
+    };
+
     std::set<pal::string_t> items;
 
     // Fill the "output" with serviced DLL directories if they are serviceable
@@ -539,7 +781,7 @@ void deps_resolver_t::resolve_probe_dirs(
     for (const deps_entry_t& entry : m_deps_entries)
     {
         pal::string_t redirection_path;
-        if (entry.is_serviceable && entry.asset_type == asset_type && entry.library_type == _X("Package") &&
+        if (entry.is_serviceable && entry.library_type == _X("Package") && probed(entry) &&
                 m_svc.find_redirection(entry.library_name, entry.library_version, entry.relative_path, &redirection_path))
         {
             add_unique_path(asset_type, action(redirection_path), &items, output);
@@ -551,7 +793,7 @@ void deps_resolver_t::resolve_probe_dirs(
     // Take care of the secondary cache path
     for (const deps_entry_t& entry : m_deps_entries)
     {
-        if (entry.asset_type == asset_type && entry.to_hash_matched_path(package_cache_dir, &candidate))
+        if (probed(entry) && entry.to_hash_matched_path(package_cache_dir, &candidate))
         {
             add_unique_path(asset_type, action(candidate), &items, output);
         }
@@ -560,10 +802,10 @@ void deps_resolver_t::resolve_probe_dirs(
     // App local path
     add_unique_path(asset_type, app_dir, &items, output);
 
-    // Take care of the package restore path
+    // Take care of the package stores and the package restore path
     for (const deps_entry_t& entry : m_deps_entries)
     {
-        if (entry.asset_type == asset_type && entry.to_full_path(package_dir, &candidate))
+        if (probed(entry) && find_in_stores(stores, entry, &candidate))
         {
             add_unique_path(asset_type, action(candidate), &items, output);
         }
@@ -579,7 +821,8 @@ void deps_resolver_t::resolve_probe_dirs(
 //
 //  Parameters:
 //     app_dir           - The application local directory
-//     package_dir       - The directory path to where packages are restored
+//     package_dir       - The directory path to where packages are restored,
+//                         probed after the package stores of DOTNET_PROBE_ROOTS
 //     package_cache_dir - The directory path to secondary cache for packages
 //     clr_dir           - The directory where the host loads the CLR
 //     probe_paths       - Pointer to struct containing fields that will contain
@@ -593,8 +836,56 @@ bool deps_resolver_t::resolve_probe_paths(
     const pal::string_t& clr_dir,
     probe_paths_t* probe_paths)
 {
-    resolve_tpa_list(app_dir, package_dir, package_cache_dir, clr_dir, &probe_paths->tpa);
-    resolve_probe_dirs(_X("native"), app_dir, package_dir, package_cache_dir, clr_dir, &probe_paths->native);
-    resolve_probe_dirs(_X("culture"), app_dir, package_dir, package_cache_dir, clr_dir, &probe_paths->culture);
+    // Package assets are looked for in the probe roots in order, and then in
+    // the package restore dir.
+    std::vector<package_store_t> stores;
+    stores.reserve(m_probe_roots.size() + 1);
+    for (const auto& root : m_probe_roots)
+    {
+        stores.emplace_back(root);
+    }
+    if (!package_dir.empty())
+    {
+        stores.emplace_back(package_dir);
+    }
+
+    select_native_variants();
+    probe_paths->complete = resolve_tpa_list(app_dir, stores, package_cache_dir, clr_dir, &probe_paths->tpa);
+    resolve_probe_dirs(_X("native"), app_dir, stores, package_cache_dir, clr_dir, &probe_paths->native);
+    resolve_probe_dirs(_X("culture"), app_dir, stores, package_cache_dir, clr_dir, &probe_paths->culture);
     return true;
 }
+
+// -----------------------------------------------------------------------------
+// Collect the paths whose identity decides what the package assets of the deps
+// file resolve to: the hash file of each package in "package_cache_dir", and
+// its version dir in each package store and "package_dir", whether they exist
+// or not.
+//
+void deps_resolver_t::get_package_paths(
+    const pal::string_t& package_dir,
+    const pal::string_t& package_cache_dir,
+    std::set<pal::string_t>* paths) const
+{
+    std::vector<pal::string_t> roots = m_probe_roots;
+    if (!package_dir.empty())
+    {
+        roots.push_back(package_dir);
+    }
+
+    pal::string_t path;
+    for (const deps_entry_t& entry : m_deps_entries)
+    {
+        if (!package_cache_dir.empty() && entry.to_hash_file_path(package_cache_dir, &path))
+        {
+            paths->insert(path);
+        }
+        for (const auto& root : roots)
+        {
+            path = root;
+            append_path(&path, entry.library_name.c_str());
+            append_path(&path, entry.library_version.c_str());
+            paths->insert(path);
+        }
+    }
+}
@@ -4,11 +4,15 @@
 #ifndef DEPS_RESOLVER_H
 #define DEPS_RESOLVER_H
 
+#include <set>
 #include <vector>
 
 #include "pal.h"
 #include "trace.h"
+#include "utils.h"
 
+#include "ni_cache_index.h"
+#include "package_store.h"
 #include "servicing_index.h"
 
 struct deps_entry_t
@@ -20,30 +24,68 @@ struct deps_entry_t
     pal::string_t asset_type;
     pal::string_t asset_name;
     pal::string_t relative_path;
+
+    // Instruction set a native asset was built for, e.g. "avx2", from the
+    // optional eighth field of its line. Empty for the baseline build.
+    pal::string_t asset_variant;
     bool is_serviceable;
 
     // Given a "base" dir, yield the relative path in the package layout.
+    void to_package_path(const pal::string_t& root, pal::string_t* str) const;
+
+    // Given a "base" dir, yield the relative path in the package layout only if
+    // the file exists.
     bool to_full_path(const pal::string_t& root, pal::string_t* str) const;
 
     // Given a "base" dir, yield the relative path in the package layout only if
     // the hash matches contents of the hash file.
     bool to_hash_matched_path(const pal::string_t& root, pal::string_t* str) const;
+
+    // Given a "base" dir, yield the path of the hash file of this entry's
+    // package, false if the entry has no valid hash.
+    bool to_hash_file_path(const pal::string_t& base, pal::string_t* str) const;
 };
 
 // Probe paths to be resolved for ordering
 struct probe_paths_t
 {
+    probe_paths_t() : complete(false) { }
+
     pal::string_t tpa;
     pal::string_t native;
     pal::string_t culture;
+
+    // Dirs of the assemblies TPA trimming left out of the TPA, for the runtime
+    // to probe through APP_PATHS instead. Never set by resolution itself.
+    pal::string_t app;
+
+    // Whether every runtime asset of the deps file was found, so that adding
+    // a missing one later cannot change the resolution.
+    bool complete;
 };
 
+// Simple name of the assembly at "path", as the TPA is unique-fied by.
+pal::string_t get_assembly_name(const pal::string_t& path);
+
+// Variants of native assets to pick, best first: those COREHOST_ISA lists,
+// else those the CPU supports.
+std::vector<pal::string_t> get_isa_variants(const arguments_t& args);
+
+// UI cultures whose culture assets to probe, each followed by its parents,
+// from COREHOST_UI_CULTURES. Only meaningful when that is set.
+std::vector<pal::string_t> get_ui_cultures(const arguments_t& args);
+
 class deps_resolver_t
 {
 public:
     deps_resolver_t(const arguments_t& args)
         : m_svc(args.dotnet_servicing)
+        , m_ni_cache(args.dotnet_ni_cache)
+        , m_isa_variants(get_isa_variants(args))
+        , m_ui_cultures_only(!args.ui_cultures.empty())
+        , m_ui_cultures(get_ui_cultures(args))
     {
+        split(args.dotnet_probe_roots, PATH_SEPARATOR, &m_probe_roots);
         m_deps_valid = parse_deps_file(args);
     }
 
@@ -56,6 +98,14 @@ public:
       const pal::string_t& clr_dir,
       probe_paths_t* probe_paths);
 
+    // Paths whose identity decides what the package assets resolve to: the
+    // hash file of every package in "package_cache_dir", and its version dir
+    // in each package store and "package_dir".
+    void get_package_paths(
+      const pal::string_t& package_dir,
+      const pal::string_t& package_cache_dir,
+      std::set<pal::string_t>* paths) const;
+
 private:
 
     bool load();
@@ -63,9 +113,9 @@ private:
     bool parse_deps_file(const arguments_t& args);
 
     // Resolve order for TPA lookup.
-    void resolve_tpa_list(
+    bool resolve_tpa_list(
         const pal::string_t& app_dir,
-        const pal::string_t& package_dir,
+        const std::vector<package_store_t>& stores,
         const pal::string_t& package_cache_dir,
         const pal::string_t& clr_dir,
         pal::string_t* output);
@@ -74,7 +124,7 @@ private:
     void resolve_probe_dirs(
         const pal::string_t& asset_type,
         const pal::string_t& app_dir,
-        const pal::string_t& package_dir,
+        const std::vector<package_store_t>& stores,
         const pal::string_t& package_cache_dir,
         const pal::string_t& clr_dir,
         pal::string_t* output);
@@ -82,9 +132,32 @@ private:
     // Populate local assemblies from app_dir listing.
     void get_local_assemblies(const pal::string_t& dir);
 
+    // Pick the variant of each library's native assets to use, and whether
+    // "entry" is of a picked one.
+    void select_native_variants();
+    bool is_selected_variant(const deps_entry_t& entry) const;
+
+    // Whether "entry" is not a culture asset, or one of a UI culture.
+    bool is_ui_culture(const deps_entry_t& entry) const;
+
     // Servicing index to resolve serviced assembly paths.
     servicing_index_t m_svc;
 
+    // Precompiled images to use in place of package assemblies.
+    ni_cache_index_t m_ni_cache;
+
+    // Package store roots to look in before the package restore dir.
+    std::vector<pal::string_t> m_probe_roots;
+
+    // Variants of native assets to pick, best first, and for every library
+    // with variants, whether one could be picked and which.
+    std::vector<pal::string_t> m_isa_variants;
+    std::unordered_map<pal::string_t, std::pair<bool, pal::string_t>> m_native_variants;
+
+    // Whether to only probe the culture assets of "m_ui_cultures".
+    bool m_ui_cultures_only;
+    std::vector<pal::string_t> m_ui_cultures;
+
     // Map of simple name -> full path of local assemblies populated in priority
     // order of their extensions.
     std::unordered_map<pal::string_t, pal::string_t> m_local_assemblies;
@@ -1,12 +1,30 @@
 // Copyright (c) .NET Foundation and contributors. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
 #include "pal.h"
 #include "args.h"
+#include "batch.h"
 #include "trace.h"
 #include "deps_resolver.h"
 #include "utils.h"
 #include "coreclr.h"
+#include "prefetch_profile.h"
+#include "resolve_cache.h"
+#include "resolve_daemon.h"
+#include "resolver_context.h"
+#include "tpa_closure.h"
+#include "native_view.h"
+#include "native_preload.h"
+#include "zygote.h"
 
 enum StatusCode
 {
@@ -18,6 +36,7 @@ enum StatusCode
     CoreClrExeFailure      = 0x85,
     ResolverInitFailure    = 0x86,
     ResolverResolveFailure = 0x87,
+    RuntimeConfigFailure   = 0x88,
 };
 
 // ----------------------------------------------------------------------
@@ -72,7 +91,171 @@ bool resolve_clr_path(const arguments_t& args, pal::string_t* clr_path)
     return false;
 }
 
-int run(const arguments_t& args, const pal::string_t& clr_path)
+// The package restore dir: NUGET_PACKAGES if it exists, else the default.
+pal::string_t get_packages_dir(const arguments_t& args)
+{
+    pal::string_t packages_dir = args.nuget_packages;
+    if (!pal::directory_exists(packages_dir))
+    {
+        (void)pal::get_default_packages_directory(&packages_dir);
+    }
+    trace::info(_X("Package directory: %s"), packages_dir.empty() ? _X("not specified") : packages_dir.c_str());
+    return packages_dir;
+}
+
+namespace
+{
+// -----------------------------------------------------------------------------
+// A pass-through file system that counts the probes made through the PAL.
+//
+class counting_file_system_t : public pal::file_system_t
+{
+public:
+    counting_file_system_t(pal::file_system_t* inner)
+        : m_inner(inner)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        stat = readdir_count = realpath_count = open = 0;
+    }
+
+    bool realpath(pal::string_t* path) override { realpath_count++; return m_inner->realpath(path); }
+    bool file_exists(const pal::string_t& path) override { stat++; return m_inner->file_exists(path); }
+    void readdir(const pal::string_t& path, std::vector<pal::string_t>* list) override { readdir_count++; m_inner->readdir(path, list); }
+    std::unique_ptr<std::istream> open_file(const pal::string_t& path) override { open++; return m_inner->open_file(path); }
+
+    unsigned long stat;
+    unsigned long readdir_count;
+    unsigned long realpath_count;
+    unsigned long open;
+
+private:
+    pal::file_system_t* m_inner;
+};
+
+// Timings and the probes of the last iteration for one resolution phase.
+struct bench_phase_t
+{
+    const pal::char_t* name;
+    std::vector<double> samples_us;
+    unsigned long stat;
+    unsigned long readdir;
+    unsigned long realpath;
+    unsigned long open;
+
+    bench_phase_t(const pal::char_t* phase_name)
+        : name(phase_name), stat(0), readdir(0), realpath(0), open(0)
+    {
+    }
+
+    template <typename F>
+    bool measure(counting_file_system_t* fs, F phase)
+    {
+        fs->reset();
+        auto start = std::chrono::steady_clock::now();
+        bool ok = phase();
+        samples_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        stat = fs->stat;
+        readdir = fs->readdir_count;
+        realpath = fs->realpath_count;
+        open = fs->open;
+        return ok;
+    }
+
+    void report()
+    {
+        std::sort(samples_us.begin(), samples_us.end());
+        size_t n = samples_us.size();
+        size_t p99 = (n * 99 + 99) / 100;
+        xout << name
+            << _X(": n=") << n
+            << _X(" min_us=") << (long) samples_us.front()
+            << _X(" median_us=") << (long) samples_us[(n - 1) / 2]
+            << _X(" p99_us=") << (long) samples_us[p99 - 1]
+            << _X(" stat=") << stat
+            << _X(" readdir=") << readdir
+            << _X(" realpath=") << realpath
+            << _X(" open=") << open
+            << std::endl;
+    }
+};
+} // end of anonymous namespace
+
+// -----------------------------------------------------------------------------
+// Resolve-only benchmark mode.
+//
+// Description:
+//    Runs CLR path resolution, deps parsing and probe path resolution
+//    "resolve_bench_iterations" times against the real file systems and
+//    package stores, and reports per-phase timings and probe counts on
+//    stdout. CoreCLR is never loaded.
+//
+int run_resolve_bench(const arguments_t& args)
+{
+    counting_file_system_t fs(pal::get_file_system());
+    pal::set_file_system(&fs);
+
+    bench_phase_t clr_phase(_X("resolve_clr_path"));
+    bench_phase_t parse_phase(_X("deps_parse"));
+    bench_phase_t probe_phase(_X("resolve_probe_paths"));
+
+    pal::string_t packages_dir = get_packages_dir(args);
+    probe_paths_t probe_paths;
+    pal::string_t clr_path;
+    int code = 0;
+
+    for (int i = 0; i < args.resolve_bench_iterations && code == 0; ++i)
+    {
+        clr_path.clear();
+        if (!clr_phase.measure(&fs, [&] () { return resolve_clr_path(args, &clr_path) && pal::realpath(&clr_path); }))
+        {
+            trace::error(_X("Could not resolve coreclr path"));
+            code = StatusCode::CoreClrResolveFailure;
+            break;
+        }
+
+        std::unique_ptr<deps_resolver_t> resolver;
+        if (!parse_phase.measure(&fs, [&] () { resolver.reset(new deps_resolver_t(args)); return resolver->valid(); }))
+        {
+            trace::error(_X("Invalid .deps file"));
+            code = StatusCode::ResolverInitFailure;
+            break;
+        }
+
+        probe_paths = probe_paths_t();
+        if (!probe_phase.measure(&fs, [&] () {
+                return resolver->resolve_probe_paths(args.app_dir, packages_dir, args.dotnet_packages_cache, clr_path, &probe_paths); }))
+        {
+            code = StatusCode::ResolverResolveFailure;
+            break;
+        }
+    }
+
+    pal::set_file_system(nullptr);
+
+    if (code != 0)
+    {
+        return code;
+    }
+
+    clr_phase.report();
+    parse_phase.report();
+    probe_phase.report();
+
+    if (args.resolve_bench_dump)
+    {
+        xout << _X("CLR path = ") << clr_path << std::endl;
+        xout << _X("TRUSTED_PLATFORM_ASSEMBLIES = ") << probe_paths.tpa << std::endl;
+        xout << _X("NATIVE_DLL_SEARCH_DIRECTORIES = ") << probe_paths.native << std::endl;
+        xout << _X("PLATFORM_RESOURCE_ROOTS = ") << probe_paths.culture << std::endl;
+    }
+    return 0;
+}
+
+int resolve_in_process(const arguments_t& args, const pal::string_t& packages_dir, const pal::string_t& clr_path, probe_paths_t* probe_paths)
 {
     // Load the deps resolver
     deps_resolver_t resolver(args);
@@ -82,164 +265,797 @@ int run(const arguments_t& args, const pal::string_t& clr_path)
         return StatusCode::ResolverInitFailure;
     }
 
+    if (!resolver.resolve_probe_paths(args.app_dir, packages_dir, args.dotnet_packages_cache, clr_path, probe_paths))
+    {
+        return StatusCode::ResolverResolveFailure;
+    }
+    return 0;
+}
+
+// Have the resolution daemon resolve the app. With "resolve_daemon_verify",
+// its answer is checked against an in-process resolution, which wins.
+bool resolve_with_daemon(const arguments_t& args, const pal::string_t& packages_dir, const pal::string_t& clr_path, probe_paths_t* probe_paths)
+{
+    resolve_request_t request;
+    request.app_dir = args.app_dir;
+    request.deps_path = args.deps_path;
+    request.package_dir = packages_dir;
+    request.package_cache_dir = args.dotnet_packages_cache;
+    request.clr_dir = clr_path;
+    request.servicing_dir = args.dotnet_servicing;
+    request.ni_cache_dir = args.dotnet_ni_cache;
+    request.isa_variants = args.isa_variants;
+    request.probe_roots = args.dotnet_probe_roots;
+    request.ui_cultures = args.ui_cultures;
+
+    probe_paths_t from_daemon;
+    if (!query_resolve_daemon(args.resolve_daemon, args.resolve_daemon_timeout_ms, request, &from_daemon))
+    {
+        trace::verbose(_X("Resolving in-process instead"));
+        return false;
+    }
+    trace::info(_X("Using resolution from daemon at %s"), args.resolve_daemon.c_str());
+
+    if (args.resolve_daemon_verify)
+    {
+        probe_paths_t local;
+        if (resolve_in_process(args, packages_dir, clr_path, &local) != 0)
+        {
+            return false;
+        }
+        if (local.tpa != from_daemon.tpa || local.native != from_daemon.native || local.culture != from_daemon.culture)
+        {
+            trace::error(_X("Resolution daemon at %s returned stale probe paths for %s"), args.resolve_daemon.c_str(), args.deps_path.c_str());
+        }
+        *probe_paths = std::move(local);
+        return true;
+    }
+
+    *probe_paths = std::move(from_daemon);
+    return true;
+}
+
+// Knobs from the environment win over the file; what is still unset then
+// follows the CPU and memory limits of this process.
+void apply_runtime_config_overrides(const arguments_t& args, runtime_config_t* runtime_config)
+{
+    runtime_config->apply_overrides(args.runtime_config_overrides);
+
+    pal::resource_limits_t limits;
+    if (args.resource_defaults && pal::get_resource_limits(&limits))
+    {
+        runtime_config->apply_resource_defaults(limits);
+    }
+}
+
+// What resolve_app does after resolving, whether resolution was cached or not.
+void finish_resolution(const arguments_t& args, const pal::string_t& clr_path, probe_paths_t* probe_paths, runtime_config_t* runtime_config)
+{
+    apply_runtime_config_overrides(args, runtime_config);
+
+    std::string trim_tpa;
+    if (runtime_config->get("Microsoft.Host.TrimTpa", &trim_tpa) && trim_tpa == "true")
+    {
+        tpa_closure_t closure(args.deps_path);
+        closure.trim(args.managed_application, args.app_dir, probe_paths);
+    }
+
+    std::string native_view;
+    if (runtime_config->get("Microsoft.Host.NativeView", &native_view) && native_view == "true")
+    {
+        native_view_t view(args.deps_path);
+        view.apply(clr_path, probe_paths);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Resolve the app's probe paths and read its runtime config: from the shared
+// resolution cache when another launch already did the same work, else from
+// the resolution daemon, else by parsing the deps file here. Environment
+// overrides, then defaults for the CPU and memory limits of this process, are
+// applied to the runtime config last, and never cached. So are trimming the
+// TPA and collapsing the native dirs into a view when the runtime config asks
+// for them (Microsoft.Host.TrimTpa, Microsoft.Host.NativeView), which keep
+// their own caches.
+//
+// Returns:
+//    Zero on success, else the exit code for the failure.
+//
+int resolve_app(const arguments_t& args, const pal::string_t& clr_path, probe_paths_t* probe_paths, runtime_config_t* runtime_config)
+{
     // Add packages directory
-    pal::string_t packages_dir = args.nuget_packages;
-    if (!pal::directory_exists(packages_dir))
+    pal::string_t packages_dir = get_packages_dir(args);
+
+    std::unique_ptr<resolve_cache_t> cache;
+    resolve_cache_t::key_t cache_key;
+    if (!args.resolve_cache.empty())
     {
-        (void)pal::get_default_packages_directory(&packages_dir);
+        cache.reset(new resolve_cache_t(args.resolve_cache));
+        if (cache->valid())
+        {
+            cache_key = resolve_cache_t::compute_key(args, packages_dir, clr_path);
+            if (cache->lookup(cache_key, probe_paths, runtime_config))
+            {
+                trace::info(_X("Using cached resolution from %s"), args.resolve_cache.c_str());
+                finish_resolution(args, clr_path, probe_paths, runtime_config);
+                return 0;
+            }
+        }
     }
-    trace::info(_X("Package directory: %s"), packages_dir.empty() ? _X("not specified") : packages_dir.c_str());
 
-    probe_paths_t probe_paths;
-    if (!resolver.resolve_probe_paths(args.app_dir, packages_dir, args.dotnet_packages_cache, clr_path, &probe_paths))
+    if (!runtime_config->load(args.runtime_config_path))
     {
-        return StatusCode::ResolverResolveFailure;
+        return StatusCode::RuntimeConfigFailure;
     }
 
-    // Build CoreCLR properties
-    const char* property_keys[] = {
-        "TRUSTED_PLATFORM_ASSEMBLIES",
-        "APP_PATHS",
-        "APP_NI_PATHS",
-        "NATIVE_DLL_SEARCH_DIRECTORIES",
-        "PLATFORM_RESOURCE_ROOTS",
-        "AppDomainCompatSwitch",
-        // TODO: pipe this from corehost.json
-        "SERVER_GC",
-        // Workaround: mscorlib does not resolve symlinks for AppContext.BaseDirectory dotnet/coreclr/issues/2128
-        "APP_CONTEXT_BASE_DIRECTORY",
-    };
+    if (args.resolve_daemon.empty() || !resolve_with_daemon(args, packages_dir, clr_path, probe_paths))
+    {
+        int code = resolve_in_process(args, packages_dir, clr_path, probe_paths);
+        if (code != 0)
+        {
+            return code;
+        }
+    }
 
-    auto tpa_paths_cstr = pal::to_stdstring(probe_paths.tpa);
-    auto app_base_cstr = pal::to_stdstring(args.app_dir);
-    auto native_dirs_cstr = pal::to_stdstring(probe_paths.native);
-    auto culture_dirs_cstr = pal::to_stdstring(probe_paths.culture);
-
-    // Workaround for dotnet/cli Issue #488 and #652
-    pal::string_t server_gc;
-    std::string server_gc_cstr = (pal::getenv(_X("COREHOST_SERVER_GC"), &server_gc) && !server_gc.empty()) ? pal::to_stdstring(server_gc) : "1";
-
-    const char* property_values[] = {
-        // TRUSTED_PLATFORM_ASSEMBLIES
-        tpa_paths_cstr.c_str(),
-        // APP_PATHS
-        app_base_cstr.c_str(),
-        // APP_NI_PATHS
-        app_base_cstr.c_str(),
-        // NATIVE_DLL_SEARCH_DIRECTORIES
-        native_dirs_cstr.c_str(),
-        // PLATFORM_RESOURCE_ROOTS
-        culture_dirs_cstr.c_str(),
-        // AppDomainCompatSwitch
-        "UseLatestBehaviorWhenTFMNotSpecified",
-        // SERVER_GC
-        server_gc_cstr.c_str(),
-        // APP_CONTEXT_BASE_DIRECTORY
-        app_base_cstr.c_str()
-    };
+    // An asset missing now may be restored before the next launch, without
+    // changing anything the cache key covers.
+    if (cache && cache->valid() && probe_paths->complete)
+    {
+        cache->store(cache_key, *probe_paths, *runtime_config);
+    }
+    else if (cache && cache->valid())
+    {
+        trace::verbose(_X("Not caching a resolution with missing assets"));
+    }
+    finish_resolution(args, clr_path, probe_paths, runtime_config);
+    return 0;
+}
 
-    size_t property_size = sizeof(property_keys) / sizeof(property_keys[0]);
+// -----------------------------------------------------------------------------
+// CoreCLR properties of a resolved app. The runtime reads the strings during
+// initialization, so they must outlive it.
+//
+class clr_properties_t
+{
+public:
+    clr_properties_t(const arguments_t& args, const probe_paths_t& probe_paths, const runtime_config_t& runtime_config)
+        : clr_properties_t(args.app_dir, args.app_dir, args.dotnet_ni_cache, probe_paths, runtime_config)
+    {
+    }
 
-    // Bind CoreCLR
-    if (!coreclr::bind(clr_path))
+    // "app_paths" lists the dirs of every app that will run, "app_base" is
+    // the dir of the first one. Images are also looked for in "ni_cache_dir",
+    // if not empty.
+    clr_properties_t(const pal::string_t& app_paths, const pal::string_t& app_base, const pal::string_t& ni_cache_dir,
+        const probe_paths_t& probe_paths, const runtime_config_t& runtime_config)
     {
-        trace::error(_X("Failed to bind to coreclr"));
-        return StatusCode::CoreClrBindFailure;
+        auto app_paths_cstr = pal::to_stdstring(app_paths);
+        auto app_base_cstr = pal::to_stdstring(app_base);
+
+        // Assemblies left out of the TPA are probed for after the app's own.
+        if (!probe_paths.app.empty())
+        {
+            app_paths_cstr.push_back(PATH_SEPARATOR);
+            app_paths_cstr.append(pal::to_stdstring(probe_paths.app));
+            app_paths_cstr.pop_back();
+        }
+
+        auto app_ni_paths_cstr = app_paths_cstr;
+        if (!ni_cache_dir.empty())
+        {
+            app_ni_paths_cstr.push_back(PATH_SEPARATOR);
+            app_ni_paths_cstr.append(pal::to_stdstring(ni_cache_index_t::get_images_dir(ni_cache_dir)));
+        }
+
+        // Workaround for dotnet/cli Issue #488 and #652: server GC unless the
+        // runtime config or COREHOST_SERVER_GC turns it off.
+        std::string server_gc;
+        std::string server_gc_cstr = (runtime_config.get("System.GC.Server", &server_gc) && server_gc == "false") ? "0" : "1";
+
+        add("TRUSTED_PLATFORM_ASSEMBLIES", pal::to_stdstring(probe_paths.tpa));
+        add("APP_PATHS", app_paths_cstr);
+        add("APP_NI_PATHS", app_ni_paths_cstr);
+        add("NATIVE_DLL_SEARCH_DIRECTORIES", pal::to_stdstring(probe_paths.native));
+        add("PLATFORM_RESOURCE_ROOTS", pal::to_stdstring(probe_paths.culture));
+        add("AppDomainCompatSwitch", "UseLatestBehaviorWhenTFMNotSpecified");
+        add("SERVER_GC", server_gc_cstr);
+        // Workaround: mscorlib does not resolve symlinks for AppContext.BaseDirectory dotnet/coreclr/issues/2128
+        add("APP_CONTEXT_BASE_DIRECTORY", app_base_cstr);
+
+        size_t host_count = m_key_strs.size();
+        for (const auto& property : runtime_config.properties())
+        {
+            if (runtime_config_t::is_host_property(property.first))
+            {
+                continue;
+            }
+            if (std::find(m_key_strs.begin(), m_key_strs.begin() + host_count, property.first) != m_key_strs.begin() + host_count)
+            {
+                trace::warning(_X("Ignoring runtime config property %s, which the host sets"), pal::to_palstring(property.first).c_str());
+                continue;
+            }
+            add(property.first, property.second);
+        }
+
+        for (size_t i = 0; i < m_key_strs.size(); ++i)
+        {
+            m_keys.push_back(m_key_strs[i].c_str());
+            m_values.push_back(m_value_strs[i].c_str());
+        }
     }
 
-    // Verbose logging
-    if (trace::is_enabled())
+    const char** keys() { return m_keys.data(); }
+    const char** values() { return m_values.data(); }
+    int count() const { return (int) m_keys.size(); }
+
+    void log() const
     {
-        for (size_t i = 0; i < property_size; ++i)
+        if (!trace::is_enabled())
+        {
+            return;
+        }
+        for (size_t i = 0; i < m_keys.size(); ++i)
         {
             pal::string_t key, val;
-            pal::to_palstring(property_keys[i], &key);
-            pal::to_palstring(property_values[i], &val);
+            pal::to_palstring(m_keys[i], &key);
+            pal::to_palstring(m_values[i], &val);
             trace::verbose(_X("Property %s = %s"), key.c_str(), val.c_str());
         }
     }
 
+private:
+    void add(const std::string& key, const std::string& value)
+    {
+        m_key_strs.push_back(key);
+        m_value_strs.push_back(value);
+    }
+
+    std::vector<std::string> m_key_strs;
+    std::vector<std::string> m_value_strs;
+    std::vector<const char*> m_keys;
+    std::vector<const char*> m_values;
+};
+
+// -----------------------------------------------------------------------------
+// Initialize the bound CoreCLR with "properties".
+//
+// Returns:
+//    Zero on success, else the exit code for the failure.
+//
+int initialize_clr(const arguments_t& args, clr_properties_t& properties, coreclr::host_handle_t* host_handle, coreclr::domain_id_t* domain_id)
+{
     std::string own_path;
     pal::to_stdstring(args.own_path.c_str(), &own_path);
 
+    // Resolution is done, write out its trace before the runtime takes over.
+    trace::flush();
+
     // Initialize CoreCLR
-    coreclr::host_handle_t host_handle;
-    coreclr::domain_id_t domain_id;
     auto hr = coreclr::initialize(
         own_path.c_str(),
         "clrhost",
-        property_keys,
-        property_values,
-        property_size,
-        &host_handle,
-        &domain_id);
+        properties.keys(),
+        properties.values(),
+        properties.count(),
+        host_handle,
+        domain_id);
     if (!SUCCEEDED(hr))
     {
         trace::error(_X("Failed to initialize CoreCLR, HRESULT: 0x%X"), hr);
         return StatusCode::CoreClrInitFailure;
     }
+    return 0;
+}
 
+// -----------------------------------------------------------------------------
+// Run "args.managed_application" with "argc" and "argv" in the initialized
+// CoreCLR.
+//
+// Returns:
+//    Zero with the app's exit code in "exit_code", else the exit code for
+//    the failure.
+//
+int execute_in_clr(
+    const arguments_t& args,
+    coreclr::host_handle_t host_handle,
+    coreclr::domain_id_t domain_id,
+    int argc,
+    const pal::char_t** app_argv,
+    unsigned int* exit_code)
+{
     if (trace::is_enabled())
     {
         pal::string_t arg_str;
-        for (int i = 0; i < args.app_argc; i++)
+        for (int i = 0; i < argc; i++)
         {
-            arg_str.append(args.app_argv[i]);
+            arg_str.append(app_argv[i]);
             arg_str.append(_X(","));
         }
         trace::info(_X("Launch host: %s app: %s, argc: %d args: %s"), args.own_path.c_str(),
-            args.managed_application.c_str(), args.app_argc, arg_str.c_str());
+            args.managed_application.c_str(), argc, arg_str.c_str());
     }
 
     // Initialize with empty strings
-    std::vector<std::string> argv_strs(args.app_argc);
-    std::vector<const char*> argv(args.app_argc);
-    for (int i = 0; i < args.app_argc; i++)
+    std::vector<std::string> argv_strs(argc);
+    std::vector<const char*> argv(argc);
+    for (int i = 0; i < argc; i++)
     {
-        pal::to_stdstring(args.app_argv[i], &argv_strs[i]);
+        pal::to_stdstring(app_argv[i], &argv_strs[i]);
         argv[i] = argv_strs[i].c_str();
     }
 
     std::string managed_app = pal::to_stdstring(args.managed_application);
 
+    // The app may terminate the process without returning to us.
+    trace::flush();
+
     // Execute the application
-    unsigned int exit_code = 1;
-    hr = coreclr::execute_assembly(
+    *exit_code = 1;
+    auto hr = coreclr::execute_assembly(
         host_handle,
         domain_id,
         argv.size(),
         argv.data(),
         managed_app.c_str(),
-        &exit_code);
+        exit_code);
     if (!SUCCEEDED(hr))
     {
         trace::error(_X("Failed to execute managed app, HRESULT: 0x%X"), hr);
         return StatusCode::CoreClrExeFailure;
     }
+    return 0;
+}
 
+void shutdown_clr(coreclr::host_handle_t host_handle, coreclr::domain_id_t domain_id)
+{
     // Shut down the CoreCLR
-    hr = coreclr::shutdown(host_handle, domain_id);
+    auto hr = coreclr::shutdown(host_handle, domain_id);
     if (!SUCCEEDED(hr))
     {
         trace::warning(_X("Failed to shut down CoreCLR, HRESULT: 0x%X"), hr);
     }
+}
 
-    coreclr::unload();
+// -----------------------------------------------------------------------------
+// Initialize the bound CoreCLR, run the app with "argc" and "argv" and shut
+// the runtime down.
+//
+// Returns:
+//    Zero with the app's exit code in "exit_code", else the exit code for
+//    the failure.
+//
+int execute_app(const arguments_t& args, clr_properties_t& properties, int argc, const pal::char_t** app_argv, unsigned int* exit_code)
+{
+    coreclr::host_handle_t host_handle;
+    coreclr::domain_id_t domain_id;
+    int code = initialize_clr(args, properties, &host_handle, &domain_id);
+    if (code != 0)
+    {
+        return code;
+    }
+
+    code = execute_in_clr(args, host_handle, domain_id, argc, app_argv, exit_code);
+    if (code != 0)
+    {
+        return code;
+    }
+
+    shutdown_clr(host_handle, domain_id);
+    return 0;
+}
 
+// -----------------------------------------------------------------------------
+// Shut down and unload CoreCLR once the app returned "exit_code", unless the
+// app's runtime config or the environment asks to skip that:
+//
+//    Microsoft.Host.FastExit (COREHOST_FAST_EXIT): exit right away, leaving
+//    it to the OS to reclaim the runtime.
+//
+//    Microsoft.Host.ShutdownTimeoutMs (COREHOST_SHUTDOWN_TIMEOUT_MS): shut
+//    down on a helper thread and exit right away if that is not done in time.
+//
+// Exiting right away flushes stdio and the trace first, and does not return.
+//
+// Returns:
+//    The exit code of the host.
+//
+int exit_clr(
+    const runtime_config_t& runtime_config,
+    coreclr::host_handle_t host_handle,
+    coreclr::domain_id_t domain_id,
+    unsigned int exit_code)
+{
+    auto exit_now = [&] () {
+        std::fflush(nullptr);
+        trace::flush();
+        pal::exit_now((int) exit_code);
+    };
+
+    std::string fast_exit;
+    if (runtime_config.get("Microsoft.Host.FastExit", &fast_exit) && fast_exit == "true")
+    {
+        trace::info(_X("Fast exit with exit code %d, without shutting CoreCLR down"), exit_code);
+        exit_now();
+    }
+
+    uint64_t timeout_ms = runtime_config.get_integer("Microsoft.Host.ShutdownTimeoutMs", 0);
+    if (timeout_ms == 0)
+    {
+        shutdown_clr(host_handle, domain_id);
+        coreclr::unload();
+        return exit_code;
+    }
+
+    // The helper may outlive this frame: it only touches what it shares.
+    struct shutdown_state_t
+    {
+        std::mutex lock;
+        std::condition_variable done_signal;
+        bool done = false;
+    };
+    auto state = std::make_shared<shutdown_state_t>();
+    std::thread([state, host_handle, domain_id] () {
+        shutdown_clr(host_handle, domain_id);
+        std::lock_guard<std::mutex> lock(state->lock);
+        state->done = true;
+        state->done_signal.notify_all();
+    }).detach();
+
+    bool done;
+    {
+        std::unique_lock<std::mutex> lock(state->lock);
+        done = state->done_signal.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] () { return state->done; });
+    }
+    if (!done)
+    {
+        trace::info(_X("CoreCLR did not shut down within %llu ms, exiting with exit code %d"),
+            (unsigned long long) timeout_ms, exit_code);
+        exit_now();
+    }
+    coreclr::unload();
     return exit_code;
 }
 
-SHARED_API int corehost_main(const int argc, const pal::char_t* argv[])
+int run(const arguments_t& args, const pal::string_t& clr_path)
 {
-    trace::setup();
+    // Start reading what the last run mapped before anything else hits the disk.
+    prefetch_profile_t prefetch(args.deps_path);
+    if (args.prefetch)
+    {
+        prefetch.start();
+    }
 
+    // The CLR path is already known: load the runtime while we resolve.
+    if (args.background_bind)
+    {
+        coreclr::bind_async(clr_path, args.bind_now);
+    }
+
+    probe_paths_t probe_paths;
+    runtime_config_t runtime_config;
+    int code = resolve_app(args, clr_path, &probe_paths, &runtime_config);
+    if (code != 0)
+    {
+        return code;
+    }
+
+    // Load the app's heavy native libraries while CoreCLR starts.
+    native_preload_t preload;
+    if (!args.preload_native.empty())
+    {
+        preload.start(args, probe_paths, clr_path);
+    }
+
+    // Build CoreCLR properties
+    clr_properties_t properties(args, probe_paths, runtime_config);
+
+    // Bind CoreCLR
+    bool bound = args.background_bind ? coreclr::wait_for_bind() : coreclr::bind(clr_path, args.bind_now);
+    if (!bound)
+    {
+        trace::error(_X("Failed to bind to coreclr"));
+        return StatusCode::CoreClrBindFailure;
+    }
+
+    // Verbose logging
+    properties.log();
+
+    coreclr::host_handle_t host_handle;
+    coreclr::domain_id_t domain_id;
+    code = initialize_clr(args, properties, &host_handle, &domain_id);
+    if (code != 0)
+    {
+        return code;
+    }
+
+    unsigned int exit_code;
+    code = execute_in_clr(args, host_handle, domain_id, args.app_argc, args.app_argv, &exit_code);
+    if (code != 0)
+    {
+        return code;
+    }
+
+    // Everything the app loaded is still mapped until the runtime is unloaded.
+    if (args.prefetch)
+    {
+        prefetch.record(probe_paths.tpa, probe_paths.native, clr_path);
+    }
+
+    return exit_clr(runtime_config, host_handle, domain_id, exit_code);
+}
+
+// -----------------------------------------------------------------------------
+// Fork server mode: resolve the app and bind CoreCLR, with all of its
+// relocations processed, once; then run the app in a forked child for every
+// corehost_launch request until the app's inputs change. The runtime itself
+// starts threads and so is only initialized in the children.
+//
+int run_zygote(const arguments_t& args, const pal::string_t& clr_path)
+{
+    probe_paths_t probe_paths;
+    runtime_config_t runtime_config;
+    int code = resolve_app(args, clr_path, &probe_paths, &runtime_config);
+    if (code != 0)
+    {
+        return code;
+    }
+
+    clr_properties_t properties(args, probe_paths, runtime_config);
+
+    // No helper threads here: only the forking thread survives fork().
+    if (!coreclr::bind(clr_path, true))
+    {
+        trace::error(_X("Failed to bind to coreclr"));
+        return StatusCode::CoreClrBindFailure;
+    }
+    properties.log();
+
+    pal::string_t packages_dir = get_packages_dir(args);
+    resolve_cache_t::key_t inputs = resolve_cache_t::compute_key(args, packages_dir, clr_path);
+
+    pal::string_t libcoreclr = clr_path;
+    append_path(&libcoreclr, LIBCORECLR_NAME);
+
+    zygote_config_t config;
+    config.socket_path = args.zygote;
+    config.managed_application = args.managed_application;
+    config.files = { args.managed_application, args.app_dir, clr_path, libcoreclr };
+    config.validate = [&] () {
+        resolve_cache_t::key_t now = resolve_cache_t::compute_key(args, packages_dir, clr_path);
+        return now.lo == inputs.lo && now.hi == inputs.hi;
+    };
+    config.run = [&] (int argc, const pal::char_t** argv) {
+        unsigned int exit_code;
+        int code = execute_app(args, properties, argc, argv, &exit_code);
+        return (code != 0) ? code : (int) exit_code;
+    };
+
+    code = run_zygote_server(config);
+    coreclr::unload();
+    return code;
+}
+
+// -----------------------------------------------------------------------------
+// Resolve the pending jobs, bind and initialize CoreCLR for the union of their
+// probe paths and run them. The runtime is the one job "first" resolves to,
+// and its runtime config that of the first job that resolves.
+//
+// Returns:
+//    Zero once every job that could run did, with their exit codes in
+//    "codes"; else the exit code for the failure that kept the rest from
+//    running.
+//
+int run_batch_jobs(const std::vector<batch_job_t>& jobs, const std::vector<arguments_t>& job_args, size_t first, std::vector<int>* codes)
+{
+    const int PENDING = -1;
+    const arguments_t& args = job_args[first];
+
+    pal::string_t clr_path;
+    if (!resolve_clr_path(args, &clr_path))
+    {
+        trace::error(_X("Could not resolve coreclr path"));
+        return StatusCode::CoreClrResolveFailure;
+    }
+    pal::realpath(&clr_path);
+
+    if (args.background_bind)
+    {
+        coreclr::bind_async(clr_path, args.bind_now);
+    }
+
+    // Resolve every app once, in job order.
+    probe_paths_t probe_paths;
+    runtime_config_t runtime_config;
+    bool have_runtime_config = false;
+    pal::string_t app_paths;
+    std::set<pal::string_t> app_dirs;
+    std::unordered_map<pal::string_t, int> resolved;
+    for (size_t i = first; i < jobs.size(); ++i)
+    {
+        if ((*codes)[i] != PENDING)
+        {
+            continue;
+        }
+
+        pal::string_t job_clr_path;
+        if (!resolve_clr_path(job_args[i], &job_clr_path) || !pal::realpath(&job_clr_path) || job_clr_path != clr_path)
+        {
+            trace::error(_X("%s does not run on the batch's runtime in %s"), jobs[i].assembly.c_str(), clr_path.c_str());
+            (*codes)[i] = StatusCode::CoreClrResolveFailure;
+            continue;
+        }
+
+        auto iter = resolved.find(job_args[i].deps_path);
+        if (iter == resolved.end())
+        {
+            probe_paths_t app_probe_paths;
+            runtime_config_t app_runtime_config;
+            int code = resolve_app(job_args[i], clr_path, &app_probe_paths, &app_runtime_config);
+            if (code == 0)
+            {
+                merge_probe_paths(app_probe_paths, &probe_paths);
+                if (!have_runtime_config)
+                {
+                    runtime_config = std::move(app_runtime_config);
+                    have_runtime_config = true;
+                }
+                if (app_dirs.insert(job_args[i].app_dir).second)
+                {
+                    if (!app_paths.empty())
+                    {
+                        app_paths.push_back(PATH_SEPARATOR);
+                    }
+                    app_paths.append(job_args[i].app_dir);
+                }
+            }
+            iter = resolved.emplace(job_args[i].deps_path, code).first;
+        }
+        if (iter->second != 0)
+        {
+            (*codes)[i] = iter->second;
+        }
+    }
+
+    clr_properties_t properties(app_paths, args.app_dir, args.dotnet_ni_cache, probe_paths, runtime_config);
+
+    bool bound = args.background_bind ? coreclr::wait_for_bind() : coreclr::bind(clr_path, args.bind_now);
+    if (!bound)
+    {
+        trace::error(_X("Failed to bind to coreclr"));
+        return StatusCode::CoreClrBindFailure;
+    }
+    properties.log();
+
+    coreclr::host_handle_t host_handle;
+    coreclr::domain_id_t domain_id;
+    int code = initialize_clr(args, properties, &host_handle, &domain_id);
+    if (code != 0)
+    {
+        return code;
+    }
+
+    for (size_t i = first; i < jobs.size(); ++i)
+    {
+        if ((*codes)[i] != PENDING)
+        {
+            continue;
+        }
+
+        std::vector<const pal::char_t*> argv;
+        for (const auto& arg : jobs[i].argv)
+        {
+            argv.push_back(arg.c_str());
+        }
+        unsigned int exit_code;
+        code = execute_in_clr(job_args[i], host_handle, domain_id, (int) argv.size(), argv.data(), &exit_code);
+        (*codes)[i] = (code != 0) ? code : (int) exit_code;
+    }
+
+    shutdown_clr(host_handle, domain_id);
+    coreclr::unload();
+    return 0;
+}
+
+// Write "exit code<TAB>assembly" for every job to "path".
+void write_batch_results(const pal::string_t& path, const std::vector<batch_job_t>& jobs, const std::vector<int>& codes)
+{
+    FILE* file = pal::file_open(path, _X("w"));
+    if (file == nullptr)
+    {
+        trace::error(_X("Could not write batch results to %s"), path.c_str());
+        return;
+    }
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        std::fprintf(file, "%d\t%s\n", codes[i], pal::to_stdstring(jobs[i].assembly).c_str());
+    }
+    std::fclose(file);
+}
+
+// -----------------------------------------------------------------------------
+// Batch mode: run every job of "args.batch_file" in turn under one CoreCLR,
+// initialized with the union of the jobs' probe paths. When two apps bring
+// assemblies of the same name, the first job's wins. Jobs share the runtime
+// and its app domain, so static state carries over from one job to the next,
+// and a job that exits the process ends the batch.
+//
+// Returns:
+//    Zero if every job ran and returned zero, else the first non-zero exit
+//    code.
+//
+int run_batch(const arguments_t& args)
+{
+    std::vector<batch_job_t> jobs;
+    if (!read_batch_file(args.batch_file, &jobs))
+    {
+        return StatusCode::InvalidArgFailure;
+    }
+
+    // Exit code of every job, or -1 while it is still to run.
+    const int PENDING = -1;
+    std::vector<int> codes(jobs.size(), PENDING);
+    std::vector<arguments_t> job_args(jobs.size(), args);
+    size_t first = jobs.size();
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (!set_managed_application(jobs[i].assembly, job_args[i]))
+        {
+            codes[i] = StatusCode::InvalidArgFailure;
+        }
+        else if (first == jobs.size())
+        {
+            first = i;
+        }
+    }
+
+    int code = 0;
+    if (first < jobs.size())
+    {
+        code = run_batch_jobs(jobs, job_args, first, &codes);
+    }
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (codes[i] == PENDING)
+        {
+            codes[i] = code;
+        }
+        trace::info(_X("Batch job %d, %s: exit code %d"), (int) i + 1, jobs[i].assembly.c_str(), codes[i]);
+    }
+
+    if (!args.batch_results.empty())
+    {
+        write_batch_results(args.batch_results, jobs, codes);
+    }
+
+    for (int job_code : codes)
+    {
+        if (job_code != 0)
+        {
+            return job_code;
+        }
+    }
+    return 0;
+}
+
+int run_main(const int argc, const pal::char_t* argv[], const host_context_t* context)
+{
     // Take care of arguments
     arguments_t args;
-    if (!parse_arguments(argc, argv, args))
+    if (!parse_arguments(argc, argv, args, context))
     {
         return StatusCode::InvalidArgFailure;
     }
 
+    if (args.resolve_bench_iterations > 0)
+    {
+        return run_resolve_bench(args);
+    }
+
+    if (!args.batch_file.empty())
+    {
+        return run_batch(args);
+    }
+
     // Resolve CLR path
     pal::string_t clr_path;
     if (!resolve_clr_path(args, &clr_path))
@@ -248,5 +1064,156 @@ SHARED_API int corehost_main(const int argc, const pal::char_t* argv[])
         return StatusCode::CoreClrResolveFailure;
     }
     pal::realpath(&clr_path);
+
+    if (!args.zygote.empty())
+    {
+        return run_zygote(args, clr_path);
+    }
     return run(args, clr_path);
 }
+
+SHARED_API int corehost_main(const int argc, const pal::char_t* argv[])
+{
+    trace::setup();
+
+    return run_main(argc, argv, nullptr);
+}
+
+SHARED_API int corehost_main_with_context(const host_context_t* context, const int argc, const pal::char_t* argv[])
+{
+    // Only use a context we understand, else do the work ourselves.
+    if (context == nullptr || context->version < 1 || context->size < sizeof(host_context_t))
+    {
+        return corehost_main(argc, argv);
+    }
+
+    trace::setup(context->trace_level, context->trace_file);
+
+    return run_main(argc, argv, context);
+}
+
+SHARED_API int corehost_resolver_create(const corehost_resolver_options_t* options, corehost_resolver_t** resolver)
+{
+    trace::setup();
+
+    // Version 1 callers pass the options up to dotnet_home, version 2 ones up
+    // to ni_cache_dir.
+    const size_t v1_size = offsetof(corehost_resolver_options_t, ni_cache_dir);
+    const size_t v2_size = offsetof(corehost_resolver_options_t, probe_roots);
+    if (options == nullptr || resolver == nullptr || options->version < 1 || options->size < v1_size ||
+        (options->version == 2 && options->size < v2_size) ||
+        (options->version >= 3 && options->size < sizeof(corehost_resolver_options_t)))
+    {
+        return StatusCode::InvalidArgFailure;
+    }
+    bool has_v2 = options->version >= 2;
+    bool has_v3 = options->version >= 3;
+
+    std::unique_ptr<corehost_resolver_t> created(new corehost_resolver_t());
+    arguments_t& args = created->args;
+    const std::pair<const pal::char_t*, pal::string_t*> roots[] = {
+        { _X("NUGET_PACKAGES"), &args.nuget_packages },
+        { _X("DOTNET_PACKAGES_CACHE"), &args.dotnet_packages_cache },
+        { _X("DOTNET_SERVICING"), &args.dotnet_servicing },
+        { _X("DOTNET_RUNTIME_SERVICING"), &args.dotnet_runtime_servicing },
+        { _X("DOTNET_HOME"), &args.dotnet_home },
+        { _X("DOTNET_NI_CACHE"), &args.dotnet_ni_cache },
+        { _X("DOTNET_PROBE_ROOTS"), &args.dotnet_probe_roots },
+    };
+    const pal::char_t* values[] = {
+        options->package_dir,
+        options->package_cache_dir,
+        options->servicing_dir,
+        options->runtime_servicing_dir,
+        options->dotnet_home,
+        has_v2 ? options->ni_cache_dir : nullptr,
+        has_v3 ? options->probe_roots : nullptr,
+    };
+    for (size_t i = 0; i < sizeof(roots) / sizeof(roots[0]); ++i)
+    {
+        if (values[i] != nullptr)
+        {
+            roots[i].second->assign(values[i]);
+        }
+        else
+        {
+            pal::getenv(roots[i].first, roots[i].second);
+        }
+    }
+
+    thread_file_system_scope_t scope(&created->fs);
+    created->packages_dir = get_packages_dir(args);
+
+    *resolver = created.release();
+    return 0;
+}
+
+SHARED_API int corehost_resolver_resolve(corehost_resolver_t* resolver, const pal::char_t* managed_application,
+    const pal::char_t* deps_path, corehost_resolution_t** resolution)
+{
+    if (resolver == nullptr || managed_application == nullptr || resolution == nullptr)
+    {
+        return StatusCode::InvalidArgFailure;
+    }
+
+    thread_file_system_scope_t scope(&resolver->fs);
+
+    arguments_t args = resolver->args;
+    if (!set_managed_application(managed_application, args))
+    {
+        return StatusCode::InvalidArgFailure;
+    }
+    if (deps_path != nullptr)
+    {
+        args.deps_path = deps_path;
+    }
+
+    pal::string_t clr_path;
+    if (!resolve_clr_path(args, &clr_path))
+    {
+        trace::error(_X("Could not resolve coreclr path"));
+        return StatusCode::CoreClrResolveFailure;
+    }
+    pal::realpath(&clr_path);
+
+    probe_paths_t probe_paths;
+    int code = resolve_in_process(args, resolver->packages_dir, clr_path, &probe_paths);
+    if (code != 0)
+    {
+        return code;
+    }
+
+    // One block for the struct and its strings, freed with a single free().
+    const pal::string_t* strings[] = { &clr_path, &probe_paths.tpa, &probe_paths.native, &probe_paths.culture };
+    size_t size = sizeof(corehost_resolution_t);
+    for (const pal::string_t* str : strings)
+    {
+        size += (str->length() + 1) * sizeof(pal::char_t);
+    }
+    corehost_resolution_t* result = (corehost_resolution_t*) std::malloc(size);
+    if (result == nullptr)
+    {
+        return StatusCode::ResolverResolveFailure;
+    }
+    const pal::char_t** fields[] = { &result->clr_dir, &result->tpa, &result->native, &result->culture };
+    pal::char_t* next = (pal::char_t*) (result + 1);
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); ++i)
+    {
+        std::memcpy(next, strings[i]->c_str(), (strings[i]->length() + 1) * sizeof(pal::char_t));
+        *fields[i] = next;
+        next += strings[i]->length() + 1;
+    }
+
+    *resolution = result;
+    return 0;
+}
+
+SHARED_API void corehost_resolution_free(corehost_resolution_t* resolution)
+{
+    std::free(resolution);
+}
+
+SHARED_API void corehost_resolver_destroy(corehost_resolver_t* resolver)
+{
+    delete resolver;
+}
@@ -0,0 +1,35 @@
+# Copyright (c) .NET Foundation and contributors. All rights reserved.
+# Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+# Sources of hostpolicy, shared by the hostpolicy library (cli/dll) and the
+# corehost built with it linked in (cli/static), which compile them with
+# different definitions.
+set(HOSTPOLICY_SOURCES
+    ${CMAKE_CURRENT_LIST_DIR}/../common/trace.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../common/utils.cpp
+
+    ${CMAKE_CURRENT_LIST_DIR}/args.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/assembly_refs.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/batch.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/hostpolicy.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/coreclr.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/deps_resolver.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/ni_cache_index.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/package_store.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/prefetch_profile.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/resolve_cache.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/resolve_daemon.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/resolver_context.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/runtime_config.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/servicing_index.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/tpa_closure.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/native_view.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/native_refs.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/native_preload.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/zygote.cpp)
+
+if(WIN32)
+    list(APPEND HOSTPOLICY_SOURCES ${CMAKE_CURRENT_LIST_DIR}/../common/pal.windows.cpp)
+else()
+    list(APPEND HOSTPOLICY_SOURCES ${CMAKE_CURRENT_LIST_DIR}/../common/pal.unix.cpp)
+endif()
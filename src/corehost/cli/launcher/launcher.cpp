@@ -0,0 +1,93 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// corehost_launch: thin client of the corehost fork server. Runs the app in
+// a copy forked from the server started for it with COREHOST_ZYGOTE_SERVE,
+// and falls back to running it with the corehost next to this executable
+// when there is no such server or it refuses.
+//
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "utils.h"
+#include "zygote.h"
+
+namespace
+{
+volatile sig_atomic_t g_child = 0;
+
+void forward_signal(int sig)
+{
+    if (g_child > 0)
+    {
+        ::kill(g_child, sig);
+    }
+}
+
+void on_started(int pid)
+{
+    g_child = pid;
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = forward_signal;
+    action.sa_flags = SA_RESTART;
+    for (int sig : { SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGUSR1, SIGUSR2 })
+    {
+        ::sigaction(sig, &action, nullptr);
+    }
+}
+
+void display_help()
+{
+    xerr <<
+        _X("Usage: corehost_launch [ASSEMBLY] [ARGUMENTS]\n")
+        _X("Execute the specified managed assembly through its fork server, if one runs\n\n")
+        _X(" COREHOST_ZYGOTE  Socket path of the fork server, if not the one COREHOST_ZYGOTE_SERVE=1 uses\n");
+}
+} // end of anonymous namespace
+
+int main(const int argc, const pal::char_t* argv[])
+{
+    trace::setup();
+
+    if (argc < 2)
+    {
+        display_help();
+        return 1;
+    }
+
+    pal::string_t app = argv[1];
+    pal::string_t socket_path;
+    if (pal::realpath(&app) &&
+        (pal::getenv(_X("COREHOST_ZYGOTE"), &socket_path) || pal::get_default_zygote_path(app, &socket_path)))
+    {
+        int exit_code;
+        if (launch_in_zygote(socket_path, app, argc - 2, &argv[2], on_started, &exit_code))
+        {
+            return exit_code;
+        }
+    }
+
+    // Run the app the usual way.
+    pal::string_t host;
+    if (!pal::get_own_executable_path(&host) || !pal::realpath(&host))
+    {
+        trace::error(_X("Failed to locate current executable"));
+        return 1;
+    }
+    host = get_directory(host);
+    append_path(&host, HOST_EXE_NAME);
+
+    std::vector<const pal::char_t*> host_argv = { host.c_str() };
+    host_argv.insert(host_argv.end(), &argv[1], &argv[argc]);
+    host_argv.push_back(nullptr);
+
+    trace::flush();
+    ::execv(host.c_str(), (char* const*) host_argv.data());
+    trace::error(_X("Failed to run %s: %s"), host.c_str(), std::strerror(errno));
+    return 1;
+}
@@ -1,4 +1,60 @@
 // Copyright (c) .NET Foundation and contributors. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#ifndef LIBHOST_H
+#define LIBHOST_H
+
+#include "pal.h"
+
 #define LIBHOST_NAME MAKE_LIBNAME("hostpolicy")
+
+// -----------------------------------------------------------------------------
+// What corehost has already worked out about this launch. It is passed to
+// hostpolicy's "corehost_main_with_context" so that hostpolicy does not have
+// to work it out again.
+//
+// The layout only grows. New fields are appended and "version" is bumped, and
+// "size" tells hostpolicy how much of the struct the caller filled in. Strings
+// belong to the caller and stay valid for the duration of the call.
+//
+#define HOST_CONTEXT_VERSION 1
+
+struct host_context_t
+{
+    size_t size;
+    int version;
+
+    // Resolved (realpath) path of the running executable and its directory.
+    const pal::char_t* own_path;
+    const pal::char_t* own_dir;
+
+    // COREHOST_TRACE level (0 when unset) and COREHOST_TRACEFILE (null when unset).
+    int trace_level;
+    const pal::char_t* trace_file;
+
+    // The environment variables corehost has read, with a null value for those
+    // that were not set. Variables not listed here must be read from the
+    // environment.
+    size_t env_count;
+    const pal::char_t* const* env_names;
+    const pal::char_t* const* env_values;
+};
+
+typedef int (*corehost_main_fn) (const int argc, const pal::char_t* argv[]);
+typedef int (*corehost_main_with_context_fn) (const host_context_t* context, const int argc, const pal::char_t* argv[]);
+
+// pal::getenv, answered from the snapshot in "context" when it has "name".
+inline bool host_context_getenv(const host_context_t* context, const pal::char_t* name, pal::string_t* recv)
+{
+    for (size_t i = 0; context != nullptr && i < context->env_count; ++i)
+    {
+        if (pal::strcmp(context->env_names[i], name) == 0)
+        {
+            recv->assign(context->env_values[i] != nullptr ? context->env_values[i] : _X(""));
+            return !recv->empty();
+        }
+    }
+    return pal::getenv(name, recv);
+}
+
+#endif // LIBHOST_H
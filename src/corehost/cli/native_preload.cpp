@@ -0,0 +1,298 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <algorithm>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "trace.h"
+#include "utils.h"
+#include "native_refs.h"
+#include "prefetch_profile.h"
+#include "native_preload.h"
+
+namespace
+{
+// Loaders such as glibc's hold one lock for the whole of a load, so more
+// threads would mostly wait on each other: what pays is loading alongside
+// CoreCLR's own startup.
+const size_t PRELOAD_THREADS = 2;
+
+// The first of "dirs" that has a file called "name", the way the runtime
+// probes for a native library.
+bool find_in_dirs(const std::vector<pal::string_t>& dirs, const pal::string_t& name, pal::string_t* path)
+{
+    for (const auto& dir : dirs)
+    {
+        pal::string_t candidate = dir + DIR_SEPARATOR + name;
+        if (pal::file_exists(candidate))
+        {
+            path->swap(candidate);
+            return true;
+        }
+    }
+    return false;
+}
+} // end of anonymous namespace
+
+native_preload_t::native_preload_t()
+    : m_remaining(0)
+    , m_loaded(0)
+    , m_failed(0)
+{
+}
+
+native_preload_t::~native_preload_t()
+{
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void native_preload_t::start(const arguments_t& args, const probe_paths_t& probe_paths, const pal::string_t& clr_dir)
+{
+    // CoreCLR loads what it needs from its own dir, leave that to it. Native
+    // dirs are real paths, compare them with the real CLR dir.
+    pal::string_t real_clr_dir = clr_dir;
+    pal::realpath(&real_clr_dir);
+    std::vector<pal::string_t> native;
+    split(probe_paths.native, PATH_SEPARATOR, &native);
+    std::vector<pal::string_t> dirs;
+    for (const auto& dir : native)
+    {
+        if (dir != real_clr_dir)
+        {
+            dirs.push_back(dir);
+        }
+    }
+
+    // The profile lists the assemblies the app mapped too: leave out those of
+    // the TPA, and anything else the loader could not load.
+    std::vector<pal::string_t> names;
+    bool profiled = args.preload_native == _X("1");
+    if (profiled)
+    {
+        std::vector<pal::string_t> tpa;
+        split(probe_paths.tpa, PATH_SEPARATOR, &tpa);
+        std::unordered_set<pal::string_t> tpa_names;
+        for (const auto& path : tpa)
+        {
+            tpa_names.insert(get_filename(path));
+        }
+
+        std::vector<pal::string_t> files;
+        prefetch_profile_t(args.deps_path).read(&files);
+        for (const auto& file : files)
+        {
+            pal::string_t name = get_filename(file);
+            if (get_directory(file) != real_clr_dir && !tpa_names.count(name))
+            {
+                names.push_back(name);
+            }
+        }
+    }
+    else
+    {
+        split(args.preload_native, _X(','), &names);
+    }
+
+    pal::string_t path;
+    for (const auto& name : names)
+    {
+        if (!find_in_dirs(dirs, name, &path))
+        {
+            trace::info(_X("Not preloading %s, it is not in the native probe dirs"), name.c_str());
+        }
+        else if (!add(path, profiled) && !profiled)
+        {
+            trace::info(_X("Could not read the dependencies of %s, preloading it anyway"), path.c_str());
+        }
+    }
+
+    // Add what the libraries need from the native dirs, so that they find
+    // the app's copies and not whatever the loader's own search turns up.
+    std::unordered_set<pal::string_t> searched;
+    for (size_t i = 0; i < m_libraries.size(); ++i)
+    {
+        std::vector<pal::string_t> needed = m_libraries[i].needed;
+        for (const auto& name : needed)
+        {
+            if (searched.insert(name).second && find_in_dirs(dirs, name, &path))
+            {
+                add(path, false);
+            }
+        }
+    }
+
+    if (!order())
+    {
+        return;
+    }
+
+    trace::verbose(_X("Preloading %d native libraries on helper threads"), (int) m_remaining);
+    try
+    {
+        size_t threads = std::min(PRELOAD_THREADS, m_queue.size());
+        for (size_t i = 0; i < threads; ++i)
+        {
+            m_threads.emplace_back([this] () { load(); });
+        }
+    }
+    catch (const std::system_error&)
+    {
+        // Preloading is only a head start, the runtime still loads what it
+        // needs. Any thread started finishes the work alone.
+        trace::info(_X("Could not start the native preload threads"));
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Add the library at "path" unless one of that file name is already there.
+// Returns false if its dependencies could not be read, in which case it is
+// only added when "require_refs" is false.
+//
+bool native_preload_t::add(const pal::string_t& path, bool require_refs)
+{
+    pal::string_t name = get_filename(path);
+    for (const auto& library : m_libraries)
+    {
+        if (get_filename(library.path) == name)
+        {
+            return true;
+        }
+    }
+
+    library_t library;
+    library.path = path;
+    library.pending = 0;
+    library.skip = false;
+    bool read = read_native_refs(path, &library.soname, &library.needed);
+    if (read || !require_refs)
+    {
+        m_libraries.push_back(std::move(library));
+    }
+    return read;
+}
+
+// -----------------------------------------------------------------------------
+// Link every library to those it needs among the others, by file name or
+// DT_SONAME, and queue those that need none of them. Libraries in a cycle have
+// no order to be loaded in and are left to the runtime. Returns false if there
+// is nothing to load.
+//
+bool native_preload_t::order()
+{
+    std::unordered_map<pal::string_t, size_t> by_name;
+    for (size_t i = 0; i < m_libraries.size(); ++i)
+    {
+        by_name.emplace(get_filename(m_libraries[i].path), i);
+        if (!m_libraries[i].soname.empty())
+        {
+            by_name.emplace(m_libraries[i].soname, i);
+        }
+    }
+
+    for (size_t i = 0; i < m_libraries.size(); ++i)
+    {
+        std::unordered_set<size_t> needs;
+        for (const auto& name : m_libraries[i].needed)
+        {
+            auto found = by_name.find(name);
+            if (found != by_name.end() && found->second != i && needs.insert(found->second).second)
+            {
+                m_libraries[found->second].dependents.push_back(i);
+                m_libraries[i].pending++;
+            }
+        }
+    }
+
+    // Walk the graph the way the loads will to find what is never reached.
+    std::vector<size_t> pending;
+    std::vector<size_t> ready;
+    for (size_t i = 0; i < m_libraries.size(); ++i)
+    {
+        pending.push_back(m_libraries[i].pending);
+        if (pending[i] == 0)
+        {
+            ready.push_back(i);
+            m_queue.push_back(i);
+        }
+    }
+    std::vector<bool> reached(m_libraries.size(), false);
+    while (!ready.empty())
+    {
+        size_t i = ready.back();
+        ready.pop_back();
+        reached[i] = true;
+        m_remaining++;
+        for (size_t dependent : m_libraries[i].dependents)
+        {
+            if (--pending[dependent] == 0)
+            {
+                ready.push_back(dependent);
+            }
+        }
+    }
+    for (size_t i = 0; i < m_libraries.size(); ++i)
+    {
+        if (!reached[i])
+        {
+            trace::info(_X("Not preloading %s, it is in a dependency cycle"), m_libraries[i].path.c_str());
+        }
+    }
+    return m_remaining > 0;
+}
+
+void native_preload_t::load()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (true)
+    {
+        m_ready.wait(lock, [this] () { return !m_queue.empty() || m_remaining == 0; });
+        if (m_queue.empty())
+        {
+            return;
+        }
+        size_t i = m_queue.front();
+        m_queue.pop_front();
+
+        const library_t& library = m_libraries[i];
+        bool loaded = false;
+        if (library.skip)
+        {
+            trace::info(_X("Not preloading %s, a library it needs failed to load"), library.path.c_str());
+        }
+        else
+        {
+            lock.unlock();
+            pal::string_t error;
+            loaded = pal::preload_library(library.path, &error);
+            if (loaded)
+            {
+                trace::verbose(_X("Preloaded %s"), library.path.c_str());
+            }
+            else
+            {
+                trace::info(_X("Could not preload %s: %s"), library.path.c_str(), error.c_str());
+            }
+            lock.lock();
+        }
+
+        (loaded ? m_loaded : m_failed)++;
+        for (size_t dependent : library.dependents)
+        {
+            m_libraries[dependent].skip = m_libraries[dependent].skip || !loaded;
+            if (--m_libraries[dependent].pending == 0)
+            {
+                m_queue.push_back(dependent);
+            }
+        }
+        if (--m_remaining == 0)
+        {
+            trace::verbose(_X("Preloaded %d native libraries, %d not loaded"), m_loaded, m_failed);
+        }
+        m_ready.notify_all();
+    }
+}
@@ -0,0 +1,70 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef NATIVE_PRELOAD_H
+#define NATIVE_PRELOAD_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "args.h"
+#include "deps_resolver.h"
+
+// -----------------------------------------------------------------------------
+// Loads some of the app's native assets on helper threads while CoreCLR starts,
+// so that the runtime's own load of them on the first P/Invoke finds them
+// already loaded instead of mapping and relocating them on the app's path.
+//
+// The libraries are those named by args.preload_native, or, when it is "1",
+// the native assets the app's prefetch profile says it mapped last time. Each
+// is looked up in the native probe dirs the way the runtime does, and the ones
+// it needs from those dirs are added. A library is loaded only after those it
+// needs, so that the loader reuses them instead of searching for them itself,
+// and not at all if one of them failed to load. Failures are traced, never
+// fatal, and nothing loaded is ever unloaded.
+//
+class native_preload_t
+{
+public:
+    native_preload_t();
+    ~native_preload_t();
+
+    // Start loading the libraries from the native dirs of "probe_paths",
+    // other than "clr_dir", that "args" asks for.
+    void start(const arguments_t& args, const probe_paths_t& probe_paths, const pal::string_t& clr_dir);
+
+private:
+    struct library_t
+    {
+        pal::string_t path;
+        pal::string_t soname;
+        std::vector<pal::string_t> needed;
+
+        // Libraries that need this one, and how many this one needs that
+        // are not loaded yet.
+        std::vector<size_t> dependents;
+        size_t pending;
+
+        // Set once a library this one needs failed to load.
+        bool skip;
+    };
+
+    bool add(const pal::string_t& path, bool require_refs);
+    bool order();
+    void load();
+
+    std::vector<library_t> m_libraries;
+    std::vector<std::thread> m_threads;
+
+    // Guards what follows, which "m_ready" signals a change of.
+    std::mutex m_lock;
+    std::condition_variable m_ready;
+    std::deque<size_t> m_queue;
+    size_t m_remaining;
+    int m_loaded;
+    int m_failed;
+};
+
+#endif // NATIVE_PRELOAD_H
@@ -0,0 +1,228 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstring>
+
+#include "trace.h"
+#include "native_refs.h"
+
+namespace
+{
+// Program header types and dynamic tags of the System V ABI.
+const uint32_t PT_LOAD = 1;
+const uint32_t PT_DYNAMIC = 2;
+const uint64_t DT_NULL = 0;
+const uint64_t DT_NEEDED = 1;
+const uint64_t DT_STRTAB = 5;
+const uint64_t DT_STRSZ = 10;
+const uint64_t DT_SONAME = 14;
+
+// Bounds checked little-endian reads from a mapped file.
+struct view_t
+{
+    const uint8_t* data;
+    size_t size;
+
+    bool has(uint64_t offset, uint64_t length) const
+    {
+        return offset <= size && length <= size - offset;
+    }
+
+    // "length" is at most 8 and the caller checked has().
+    uint64_t read(size_t offset, size_t length) const
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < length; ++i)
+        {
+            value |= (uint64_t) data[offset + i] << (8 * i);
+        }
+        return value;
+    }
+};
+
+// Where the fields read differ between ELFCLASS32 and ELFCLASS64.
+struct layout_t
+{
+    size_t word;            // Size of an address or offset
+    size_t phoff;           // e_phoff in the ELF header
+    size_t phentsize;       // e_phentsize, followed by e_phnum
+    size_t phdr_size;
+    size_t p_offset;        // In a program header, followed by p_vaddr
+    size_t p_filesz;
+    size_t dyn_size;
+};
+
+const layout_t ELF32 = { 4, 28, 42, 32, 4, 16, 8 };
+const layout_t ELF64 = { 8, 32, 54, 56, 8, 32, 16 };
+
+struct segment_t
+{
+    uint64_t offset;
+    uint64_t vaddr;
+    uint64_t filesz;
+};
+
+segment_t read_segment(const view_t& file, const layout_t& layout, size_t phdr)
+{
+    segment_t segment;
+    segment.offset = file.read(phdr + layout.p_offset, layout.word);
+    segment.vaddr = file.read(phdr + layout.p_offset + layout.word, layout.word);
+    segment.filesz = file.read(phdr + layout.p_filesz, layout.word);
+    return segment;
+}
+
+bool read_refs(const view_t& file, pal::string_t* soname, std::vector<pal::string_t>* needed)
+{
+    // "\x7f" "ELF", little-endian, version 1.
+    if (!file.has(0, 64) || file.read(0, 4) != 0x464c457f || file.data[5] != 1 || file.data[6] != 1)
+    {
+        return false;
+    }
+    if (file.data[4] != 1 && file.data[4] != 2)
+    {
+        return false;
+    }
+    const layout_t& layout = (file.data[4] == 2) ? ELF64 : ELF32;
+
+    uint64_t phoff = file.read(layout.phoff, layout.word);
+    size_t phentsize = file.read(layout.phentsize, 2);
+    size_t phnum = file.read(layout.phentsize + 2, 2);
+    if (phentsize < layout.phdr_size || !file.has(phoff, (uint64_t) phentsize * phnum))
+    {
+        return false;
+    }
+
+    // The string table is given by its address: map it to a file offset
+    // through the loadable segment that holds it.
+    std::vector<segment_t> loads;
+    bool has_dynamic = false;
+    segment_t dynamic = {};
+    for (size_t i = 0; i < phnum; ++i)
+    {
+        size_t phdr = phoff + i * phentsize;
+        uint32_t type = (uint32_t) file.read(phdr, 4);
+        if (type == PT_LOAD)
+        {
+            loads.push_back(read_segment(file, layout, phdr));
+        }
+        else if (type == PT_DYNAMIC)
+        {
+            dynamic = read_segment(file, layout, phdr);
+            has_dynamic = true;
+        }
+    }
+    if (!has_dynamic)
+    {
+        // Linked statically, it needs nothing.
+        return true;
+    }
+    if (!file.has(dynamic.offset, dynamic.filesz))
+    {
+        return false;
+    }
+
+    uint64_t strtab = 0;
+    uint64_t strsz = 0;
+    bool has_strtab = false;
+    size_t count = dynamic.filesz / layout.dyn_size;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t dyn = dynamic.offset + i * layout.dyn_size;
+        uint64_t tag = file.read(dyn, layout.word);
+        uint64_t value = file.read(dyn + layout.word, layout.word);
+        if (tag == DT_NULL)
+        {
+            break;
+        }
+        if (tag == DT_STRTAB)
+        {
+            strtab = value;
+            has_strtab = true;
+        }
+        else if (tag == DT_STRSZ)
+        {
+            strsz = value;
+        }
+    }
+
+    uint64_t strtab_offset = 0;
+    bool mapped = false;
+    for (const auto& load : loads)
+    {
+        if (has_strtab && strtab >= load.vaddr && strtab - load.vaddr < load.filesz)
+        {
+            strtab_offset = load.offset + (strtab - load.vaddr);
+            mapped = true;
+            break;
+        }
+    }
+    if (!mapped || !file.has(strtab_offset, strsz))
+    {
+        return false;
+    }
+
+    auto string_at = [&] (uint64_t index, pal::string_t* str) {
+        if (index >= strsz)
+        {
+            return false;
+        }
+        const char* start = (const char*) file.data + strtab_offset + index;
+        const char* end = (const char*) std::memchr(start, '\0', strsz - index);
+        if (end == nullptr)
+        {
+            return false;
+        }
+        pal::to_palstring(std::string(start, end).c_str(), str);
+        return true;
+    };
+
+    pal::string_t name;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t dyn = dynamic.offset + i * layout.dyn_size;
+        uint64_t tag = file.read(dyn, layout.word);
+        uint64_t value = file.read(dyn + layout.word, layout.word);
+        if (tag == DT_NULL)
+        {
+            break;
+        }
+        if ((tag == DT_NEEDED || tag == DT_SONAME) && !string_at(value, &name))
+        {
+            return false;
+        }
+        if (tag == DT_NEEDED)
+        {
+            needed->push_back(name);
+        }
+        else if (tag == DT_SONAME)
+        {
+            soname->assign(name);
+        }
+    }
+    return true;
+}
+} // end of anonymous namespace
+
+bool read_native_refs(const pal::string_t& path, pal::string_t* soname, std::vector<pal::string_t>* needed)
+{
+    soname->clear();
+    needed->clear();
+
+    pal::mapped_file_t mapped;
+    if (!pal::map_file(path, &mapped))
+    {
+        trace::verbose(_X("Could not map %s to read its dependencies"), path.c_str());
+        return false;
+    }
+
+    view_t file = { (const uint8_t*) mapped.data, mapped.size };
+    bool read = read_refs(file, soname, needed);
+    pal::unmap_file(&mapped);
+    if (!read)
+    {
+        trace::verbose(_X("Could not read the dependencies of %s"), path.c_str());
+        soname->clear();
+        needed->clear();
+    }
+    return read;
+}
@@ -0,0 +1,20 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef NATIVE_REFS_H
+#define NATIVE_REFS_H
+
+#include "pal.h"
+
+// -----------------------------------------------------------------------------
+// The DT_SONAME and DT_NEEDED entries of the little-endian ELF shared library
+// at "path": its own name and those of the libraries the loader loads first.
+// Only the ELF header, the program headers, the dynamic section and the
+// dynamic string table are read, through a read-only mapping of the file.
+//
+// Returns false if the file cannot be mapped or is not an ELF file this can
+// read, with "soname" and "needed" left empty.
+//
+bool read_native_refs(const pal::string_t& path, pal::string_t* soname, std::vector<pal::string_t>* needed);
+
+#endif // NATIVE_REFS_H
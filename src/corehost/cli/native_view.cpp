@@ -0,0 +1,220 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <functional>
+#include <unordered_set>
+
+#include "trace.h"
+#include "native_view.h"
+
+namespace
+{
+// Bump when what goes into a view, or its key, changes.
+const pal::char_t* VIEW_VERSION = _X("2");
+
+// Held shared by every launch that uses the view, or builds it, and
+// exclusively by one removing it.
+const pal::char_t* LOCK_FILE = _X(".lock");
+
+// Whether "name" is that of a native library, versioned ones such as
+// libfoo.so.1 included.
+bool is_native_library(const pal::string_t& name)
+{
+    const pal::string_t ext = LIBRARY_EXT;
+    for (size_t pos = name.find(ext); pos != pal::string_t::npos; pos = name.find(ext, pos + 1))
+    {
+        size_t end = pos + ext.length();
+        if (end == name.length() || name[end] == _X('.'))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Append "<device>,<inode>,<size>,<mtime>|" of "path", or "|" if it is missing.
+void append_identity(const pal::string_t& path, pal::stringstream_t* stream)
+{
+    pal::file_identity_t identity;
+    if (pal::get_file_identity(path, &identity))
+    {
+        *stream << identity.device << _X(',') << identity.inode << _X(',') << identity.size << _X(',') << identity.mtime_ns;
+    }
+    *stream << _X('|');
+}
+
+// Remove the view at "dir" and the links in it, including those to libraries
+// that have since been removed.
+void remove_view(const pal::string_t& dir)
+{
+    if (!pal::remove_directory(dir))
+    {
+        trace::verbose(_X("Could not remove native view %s"), dir.c_str());
+    }
+}
+
+// Keep the view at "dir" from being removed while this process runs. False if
+// it is gone or being removed.
+bool use_view(const pal::string_t& dir)
+{
+    return pal::hold_shared_lock(dir + DIR_SEPARATOR + LOCK_FILE, false);
+}
+} // end of anonymous namespace
+
+native_view_t::native_view_t(const pal::string_t& deps_path)
+{
+    m_root = get_deps_sibling_path(deps_path, _X(".native_view"));
+}
+
+void native_view_t::apply(const pal::string_t& clr_dir, probe_paths_t* probe_paths)
+{
+    // Native dirs are real paths, compare them with the real CLR dir.
+    pal::string_t real_clr_dir = clr_dir;
+    pal::realpath(&real_clr_dir);
+
+    std::vector<pal::string_t> native;
+    split(probe_paths->native, PATH_SEPARATOR, &native);
+    std::vector<pal::string_t> dirs;
+    bool has_clr_dir = false;
+    for (const auto& dir : native)
+    {
+        if (dir == real_clr_dir)
+        {
+            has_clr_dir = true;
+        }
+        else
+        {
+            dirs.push_back(dir);
+        }
+    }
+    if (dirs.size() < 2)
+    {
+        trace::verbose(_X("Not using a native view, there are only %d native dirs besides the CLR dir"), (int) dirs.size());
+        return;
+    }
+
+    // Link each library name to what probing the dirs in order finds first.
+    links_t links;
+    std::unordered_set<pal::string_t> names;
+    std::vector<pal::string_t> files;
+    for (const auto& dir : dirs)
+    {
+        files.clear();
+        pal::readdir(dir, &files);
+        for (const auto& file : files)
+        {
+            if (is_native_library(file) && names.insert(file).second)
+            {
+                links.emplace_back(file, dir + DIR_SEPARATOR + file);
+            }
+        }
+    }
+
+    // A library added, removed or replaced changes the key. Anything else
+    // in the dirs, such as the files the host keeps next to the app, does not.
+    pal::stringstream_t identities;
+    for (const auto& link : links)
+    {
+        identities << link.first << _X('|') << link.second << _X('|');
+        append_identity(link.second, &identities);
+    }
+    pal::stringstream_t key_stream;
+    key_stream << VIEW_VERSION << _X('-') << std::hex << std::hash<pal::string_t>()(identities.str());
+    pal::string_t key = key_stream.str();
+
+    pal::string_t view_dir = m_root + DIR_SEPARATOR + key;
+    if (use_view(view_dir))
+    {
+        trace::verbose(_X("Using native view %s"), view_dir.c_str());
+    }
+    else if (build(view_dir, links))
+    {
+        prune(key);
+    }
+    else
+    {
+        return;
+    }
+
+    pal::string_t view_paths = view_dir;
+    view_paths.push_back(PATH_SEPARATOR);
+    if (has_clr_dir)
+    {
+        view_paths.append(real_clr_dir);
+        view_paths.push_back(PATH_SEPARATOR);
+    }
+    probe_paths->native.swap(view_paths);
+    trace::info(_X("Probing native libraries in a view of %d dirs at %s"), (int) dirs.size(), view_dir.c_str());
+}
+
+bool native_view_t::build(const pal::string_t& view_dir, const links_t& links)
+{
+    pal::create_directory(m_root);
+    pal::string_t temp_dir = get_temp_path(view_dir);
+    if (!pal::create_directory(temp_dir))
+    {
+        trace::verbose(_X("Could not create native view %s"), temp_dir.c_str());
+        return false;
+    }
+
+    // Locked from the start, so that no other launch prunes it half built.
+    if (!pal::hold_shared_lock(temp_dir + DIR_SEPARATOR + LOCK_FILE, true))
+    {
+        trace::verbose(_X("Could not lock native view %s"), temp_dir.c_str());
+        remove_view(temp_dir);
+        return false;
+    }
+    for (const auto& link : links)
+    {
+        if (!pal::create_symlink(link.second, temp_dir + DIR_SEPARATOR + link.first))
+        {
+            trace::verbose(_X("Could not link %s into native view %s"), link.second.c_str(), temp_dir.c_str());
+            remove_view(temp_dir);
+            return false;
+        }
+    }
+
+    // Another launch may have built the same view meanwhile, either will do.
+    if (!pal::rename_file(temp_dir, view_dir))
+    {
+        remove_view(temp_dir);
+        return use_view(view_dir);
+    }
+    trace::verbose(_X("Built native view %s of %d libraries"), view_dir.c_str(), (int) links.size());
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// Remove the views other than that of "key" that no launch uses any more, and
+// what launches that died while building one left behind. Views in use stay
+// until a later build finds them unused.
+//
+void native_view_t::prune(const pal::string_t& key)
+{
+    std::vector<pal::string_t> views;
+    pal::list_directories(m_root, &views);
+    for (const auto& view : views)
+    {
+        if (view == key)
+        {
+            continue;
+        }
+
+        pal::string_t dir = m_root + DIR_SEPARATOR + view;
+        pal::string_t lock_path = dir + DIR_SEPARATOR + LOCK_FILE;
+        intptr_t handle;
+        if (pal::try_lock_path(lock_path, &handle))
+        {
+            trace::verbose(_X("Removing native view %s, no launch uses it"), dir.c_str());
+            remove_view(dir);
+            pal::unlock_path(handle);
+        }
+        else if (!pal::file_exists(lock_path) && view.find(_X(".tmp")) == pal::string_t::npos)
+        {
+            // Views of an earlier version have no lock. A view being built
+            // can have none yet.
+            trace::verbose(_X("Removing native view %s of an earlier version"), dir.c_str());
+            remove_view(dir);
+        }
+    }
+}
@@ -0,0 +1,43 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef NATIVE_VIEW_H
+#define NATIVE_VIEW_H
+
+#include "utils.h"
+#include "deps_resolver.h"
+
+// -----------------------------------------------------------------------------
+// A directory of symlinks that stands in for the native probe dirs of an app,
+// so that the runtime tries one dir, and then the CLR dir, for every native
+// library it loads. A library name links to the file of that name in the first
+// native dir that has one, which is what probing the dirs in order finds.
+//
+// Views are kept next to the deps file, as <app>.native_view/<key>, where the
+// key covers every link and the identity of the library it links to. A view
+// is built once per key, in a temporary dir moved into place. Every launch
+// holds a shared lock on the view it uses, and views that nothing holds are
+// removed once a newer one is built. Libraries that find their dependencies
+// through $ORIGIN see the view as their dir.
+//
+class native_view_t
+{
+public:
+    native_view_t(const pal::string_t& deps_path);
+
+    // Replace the dirs of "probe_paths->native" other than "clr_dir" with a
+    // view of them, ahead of "clr_dir". Leaves them as they are if the view
+    // cannot be built.
+    void apply(const pal::string_t& clr_dir, probe_paths_t* probe_paths);
+
+private:
+    // Library names and the files they link to.
+    typedef std::vector<std::pair<pal::string_t, pal::string_t>> links_t;
+
+    bool build(const pal::string_t& view_dir, const links_t& links);
+    void prune(const pal::string_t& key);
+
+    pal::string_t m_root;
+};
+
+#endif // NATIVE_VIEW_H
@@ -0,0 +1,125 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "trace.h"
+#include "ni_cache_index.h"
+
+static const pal::char_t* DOTNET_NI_CACHE_INDEX_TXT = _X("dotnet_ni_cache_index.txt");
+
+namespace
+{
+pal::string_t make_key(const pal::string_t& name, const pal::string_t& version, const pal::string_t& relative)
+{
+    pal::string_t key;
+    key.reserve(name.length() + version.length() + relative.length() + 2);
+    key.append(name).push_back(_X('|'));
+    key.append(version).push_back(_X('|'));
+    key.append(relative);
+    return key;
+}
+} // end of anonymous namespace
+
+pal::string_t ni_cache_index_t::get_images_dir(const pal::string_t& cache_dir)
+{
+    if (cache_dir.empty())
+    {
+        return pal::string_t();
+    }
+    pal::string_t dir = cache_dir;
+    append_path(&dir, pal::get_host_rid());
+    return dir;
+}
+
+pal::string_t ni_cache_index_t::get_index_path(const pal::string_t& cache_dir)
+{
+    pal::string_t index = get_images_dir(cache_dir);
+    if (!index.empty())
+    {
+        append_path(&index, DOTNET_NI_CACHE_INDEX_TXT);
+    }
+    return index;
+}
+
+ni_cache_index_t::ni_cache_index_t(const pal::string_t& cache_dir)
+{
+    m_images_dir = get_images_dir(cache_dir);
+    m_index_file = get_index_path(cache_dir);
+    m_parsed = m_index_file.empty();
+}
+
+bool ni_cache_index_t::find_image(
+        const pal::string_t& package_name,
+        const pal::string_t& package_version,
+        const pal::string_t& package_relative,
+        pal::string_t* image)
+{
+    ensure_images();
+
+    image->clear();
+
+    if (m_images.empty())
+    {
+        return false;
+    }
+
+    auto iter = m_images.find(make_key(package_name, package_version, package_relative));
+    if (iter == m_images.end())
+    {
+        return false;
+    }
+
+    image->assign(m_images_dir);
+    append_path(image, iter->second.c_str());
+    trace::verbose(_X("Using precompiled image %s for %s %s %s"), image->c_str(),
+        package_name.c_str(), package_version.c_str(), package_relative.c_str());
+    return true;
+}
+
+void ni_cache_index_t::ensure_images()
+{
+    if (m_parsed)
+    {
+        return;
+    }
+    m_parsed = true;
+
+    // No cache for this RID.
+    auto fstream = pal::open_file(m_index_file);
+    if (!fstream)
+    {
+        trace::verbose(_X("No precompiled image index at %s"), m_index_file.c_str());
+        return;
+    }
+
+    const pal::string_t prefix = _X("package|");
+    std::string line;
+    while (std::getline(*fstream, line))
+    {
+        pal::string_t str;
+        pal::to_palstring(line.c_str(), &str);
+
+        if (str.compare(0, prefix.length(), prefix) != 0)
+        {
+            continue;
+        }
+
+        // "<name>|<version>|<relative path>=<image path>"
+        size_t name_end = str.find(_X('|'), prefix.length());
+        size_t version_end = (name_end == pal::string_t::npos) ? name_end : str.find(_X('|'), name_end + 1);
+        size_t relative_end = (version_end == pal::string_t::npos) ? version_end : str.find(_X('='), version_end + 1);
+        if (relative_end == pal::string_t::npos || relative_end + 1 == str.length())
+        {
+            trace::error(_X("Invalid line in precompiled image index. Skipping..."));
+            continue;
+        }
+
+        pal::string_t image = str.substr(relative_end + 1);
+        if (_X('/') != DIR_SEPARATOR)
+        {
+            replace_char(&image, _X('/'), DIR_SEPARATOR);
+        }
+        m_images.emplace(str.substr(prefix.length(), relative_end - prefix.length()), image);
+    }
+
+    trace::verbose(_X("Read %d precompiled images from %s"), (int) m_images.size(), m_index_file.c_str());
+}
@@ -0,0 +1,49 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef NI_CACHE_INDEX_H
+#define NI_CACHE_INDEX_H
+
+#include "utils.h"
+
+// -----------------------------------------------------------------------------
+// Machine-wide cache of precompiled (NI) images of package assemblies, rooted
+// at DOTNET_NI_CACHE:
+//
+//    <cache>/<rid>/dotnet_ni_cache_index.txt
+//    <cache>/<rid>/<images listed in the index>
+//
+// Each index line maps a package's IL asset to its image, relative to the
+// <rid> dir:
+//
+//    package|<name>|<version>|<relative path>=<image path>
+//
+// Only the index is read: images are not probed for one by one. Whatever
+// fills the cache must write an image before listing it, and unlist it
+// before removing it.
+//
+class ni_cache_index_t
+{
+public:
+    ni_cache_index_t(const pal::string_t& cache_dir);
+
+    bool find_image(const pal::string_t& package_name,
+            const pal::string_t& package_version,
+            const pal::string_t& package_relative,
+            pal::string_t* image);
+
+    // "<cache>/<rid>", where the images for this host are, or empty if
+    // "cache_dir" is.
+    static pal::string_t get_images_dir(const pal::string_t& cache_dir);
+    static pal::string_t get_index_path(const pal::string_t& cache_dir);
+
+private:
+    void ensure_images();
+
+    std::unordered_map<pal::string_t, pal::string_t> m_images;
+    pal::string_t m_images_dir;
+    pal::string_t m_index_file;
+    bool m_parsed;
+};
+
+#endif // NI_CACHE_INDEX_H
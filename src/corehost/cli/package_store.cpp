@@ -0,0 +1,109 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <algorithm>
+#include <cstring>
+
+#include "trace.h"
+#include "utils.h"
+#include "deps_resolver.h"
+#include "package_store.h"
+
+static const pal::char_t* DOTNET_STORE_MANIFEST_TXT = _X("dotnet_store_manifest.txt");
+
+pal::string_t package_store_t::get_manifest_path(const pal::string_t& root)
+{
+    pal::string_t manifest = root;
+    append_path(&manifest, DOTNET_STORE_MANIFEST_TXT);
+    return manifest;
+}
+
+package_store_t::package_store_t(const pal::string_t& root)
+    : m_root(root)
+{
+    m_manifest.data = nullptr;
+
+    // Look for the manifest through the file system the host probes with, so
+    // that the resolution daemon sees it change.
+    pal::string_t manifest = get_manifest_path(root);
+    if (pal::file_exists(manifest) && pal::map_file(manifest, &m_manifest))
+    {
+        trace::verbose(_X("Using the %d byte manifest of package store %s"), (int) m_manifest.size, root.c_str());
+    }
+    else
+    {
+        trace::verbose(_X("No manifest in package store %s, probing it"), root.c_str());
+    }
+}
+
+package_store_t::package_store_t(package_store_t&& other)
+    : m_root(std::move(other.m_root))
+    , m_manifest(other.m_manifest)
+{
+    other.m_manifest.data = nullptr;
+}
+
+package_store_t::~package_store_t()
+{
+    pal::unmap_file(&m_manifest);
+}
+
+bool package_store_t::find(const deps_entry_t& entry, pal::string_t* path) const
+{
+    if (m_manifest.data == nullptr)
+    {
+        return entry.to_full_path(m_root, path);
+    }
+
+    pal::string_t file = entry.library_name + _X('/') + entry.library_version + _X('/') + entry.relative_path;
+    if (!manifest_lists(pal::to_stdstring(file)))
+    {
+        path->clear();
+        return false;
+    }
+    entry.to_package_path(m_root, path);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// Binary search the sorted lines of the manifest for "file", touching only the
+// pages of the lines compared.
+//
+bool package_store_t::manifest_lists(const std::string& file) const
+{
+    const char* data = (const char*) m_manifest.data;
+
+    // Lines starting in [low, high) are left to compare.
+    size_t low = 0;
+    size_t high = m_manifest.size;
+    while (low < high)
+    {
+        size_t start = low + (high - low) / 2;
+        while (start > low && data[start - 1] != '\n')
+        {
+            start--;
+        }
+        const char* newline = (const char*) std::memchr(data + start, '\n', m_manifest.size - start);
+        size_t end = (newline != nullptr) ? newline - data : m_manifest.size;
+        size_t length = (end > start && data[end - 1] == '\r') ? end - start - 1 : end - start;
+
+        int compare = std::memcmp(data + start, file.data(), std::min(length, file.length()));
+        if (compare == 0)
+        {
+            if (length == file.length())
+            {
+                return true;
+            }
+            compare = (length < file.length()) ? -1 : 1;
+        }
+        if (compare < 0)
+        {
+            low = end + 1;
+        }
+        else
+        {
+            high = start;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,46 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef PACKAGE_STORE_H
+#define PACKAGE_STORE_H
+
+#include "pal.h"
+
+struct deps_entry_t;
+
+// -----------------------------------------------------------------------------
+// A root of packages in the <name>/<version>/<relative path> layout of the
+// package restore dir. A read-only store can ship a manifest of every file it
+// has, sorted by byte value, one per line and with '/' separators:
+//
+//    <root>/dotnet_store_manifest.txt
+//
+//    <name>/<version>/<relative path>
+//
+// The manifest is mapped and binary searched: files it does not list are not
+// in the store, and files it lists are not checked for. Roots without one
+// are probed for every file.
+//
+class package_store_t
+{
+public:
+    package_store_t(const pal::string_t& root);
+    package_store_t(package_store_t&& other);
+    ~package_store_t();
+
+    package_store_t(const package_store_t&) = delete;
+    package_store_t& operator=(const package_store_t&) = delete;
+
+    // Full path of the asset of "entry" in this store, if the store has it.
+    bool find(const deps_entry_t& entry, pal::string_t* path) const;
+
+    static pal::string_t get_manifest_path(const pal::string_t& root);
+
+private:
+    bool manifest_lists(const std::string& file) const;
+
+    pal::string_t m_root;
+    pal::mapped_file_t m_manifest;
+};
+
+#endif // PACKAGE_STORE_H
@@ -0,0 +1,142 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <system_error>
+#include <unordered_set>
+
+#include "trace.h"
+#include "prefetch_profile.h"
+
+prefetch_profile_t::prefetch_profile_t(const pal::string_t& deps_path)
+{
+    m_profile_path = get_deps_sibling_path(deps_path, _X(".prefetch"));
+}
+
+prefetch_profile_t::~prefetch_profile_t()
+{
+    wait();
+}
+
+void prefetch_profile_t::wait()
+{
+    if (m_prefetch.valid())
+    {
+        m_prefetch.wait();
+    }
+}
+
+bool prefetch_profile_t::read(std::vector<pal::string_t>* files) const
+{
+    auto file = pal::open_file(m_profile_path);
+    if (!file)
+    {
+        trace::verbose(_X("No prefetch profile at %s"), m_profile_path.c_str());
+        return false;
+    }
+
+    std::string line;
+    pal::string_t str;
+    while (std::getline(*file, line))
+    {
+        if (!line.empty() && line[0] != '#')
+        {
+            pal::to_palstring(line.c_str(), &str);
+            files->push_back(str);
+        }
+    }
+    std::sort(files->begin(), files->end());
+    return true;
+}
+
+void prefetch_profile_t::start()
+{
+    if (!read(&m_files))
+    {
+        return;
+    }
+
+    trace::verbose(_X("Prefetching %d files listed in %s"), (int) m_files.size(), m_profile_path.c_str());
+    try
+    {
+        m_prefetch = std::async(std::launch::async, [this] () {
+            int prefetched = 0;
+            for (const auto& path : m_files)
+            {
+                prefetched += pal::prefetch_file(path) ? 1 : 0;
+            }
+            trace::verbose(_X("Prefetched %d of %d files"), prefetched, (int) m_files.size());
+        });
+    }
+    catch (const std::system_error&)
+    {
+        // Prefetching is only a hint, don't hold up startup doing it inline.
+        trace::info(_X("Could not start the prefetch thread"));
+    }
+}
+
+void prefetch_profile_t::record(const pal::string_t& tpa, const pal::string_t& native_dirs, const pal::string_t& clr_dir)
+{
+    std::vector<pal::string_t> mapped;
+    if (!pal::get_mapped_files(&mapped))
+    {
+        return;
+    }
+
+    std::vector<pal::string_t> items;
+    split(tpa, PATH_SEPARATOR, &items);
+    std::unordered_set<pal::string_t> tpa_files(items.begin(), items.end());
+    items.clear();
+    split(native_dirs, PATH_SEPARATOR, &items);
+    std::unordered_set<pal::string_t> lib_dirs(items.begin(), items.end());
+    lib_dirs.insert(clr_dir);
+
+    // Mapped files are real paths, while a native dir can be a view of links
+    // to libraries elsewhere: look the file up in it then.
+    auto in_lib_dir = [&] (const pal::string_t& path) {
+        if (lib_dirs.count(get_directory(path)))
+        {
+            return true;
+        }
+        pal::string_t name = get_filename(path);
+        for (const auto& dir : lib_dirs)
+        {
+            pal::string_t linked = dir + DIR_SEPARATOR + name;
+            if (pal::file_exists(linked) && pal::realpath(&linked) && linked == path)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Files in the TPA that were never loaded are left out, there is no point
+    // reading them next time.
+    std::vector<pal::string_t> files;
+    for (const auto& path : mapped)
+    {
+        if (tpa_files.count(path) || in_lib_dir(path))
+        {
+            files.push_back(path);
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    wait();
+    if (files == m_files)
+    {
+        return;
+    }
+
+    std::string contents;
+    for (const auto& path : files)
+    {
+        contents += pal::to_stdstring(path) + "\n";
+    }
+    if (!write_file_atomically(m_profile_path, contents))
+    {
+        trace::verbose(_X("Could not write prefetch profile %s"), m_profile_path.c_str());
+        return;
+    }
+    trace::verbose(_X("Recorded %d mapped files in %s"), (int) files.size(), m_profile_path.c_str());
+    m_files.swap(files);
+}
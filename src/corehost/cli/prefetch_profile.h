@@ -0,0 +1,41 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef PREFETCH_PROFILE_H
+#define PREFETCH_PROFILE_H
+
+#include <future>
+
+#include "utils.h"
+
+// -----------------------------------------------------------------------------
+// List of the assemblies and native libraries an app actually mapped during its
+// last run, kept next to its deps file as <app>.prefetch. At startup the listed
+// files are pulled into the page cache on a helper thread, so that a cold start
+// does not fault them in one page at a time.
+//
+class prefetch_profile_t
+{
+public:
+    prefetch_profile_t(const pal::string_t& deps_path);
+    ~prefetch_profile_t();
+
+    // Read the profile and start prefetching the files it lists.
+    void start();
+
+    // The files the profile lists, sorted. False if there is no profile.
+    bool read(std::vector<pal::string_t>* files) const;
+
+    // Save which TPA assemblies and which libraries from "native_dirs" or
+    // "clr_dir" are mapped right now, if that differs from the current profile.
+    void record(const pal::string_t& tpa, const pal::string_t& native_dirs, const pal::string_t& clr_dir);
+
+private:
+    void wait();
+
+    pal::string_t m_profile_path;
+    std::vector<pal::string_t> m_files;
+    std::future<void> m_prefetch;
+};
+
+#endif // PREFETCH_PROFILE_H
@@ -0,0 +1,396 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <atomic>
+
+#include "trace.h"
+#include "utils.h"
+#include "resolve_cache.h"
+
+namespace
+{
+const uint32_t CACHE_MAGIC = 0x43524843; // "CHRC"
+
+// Bump when the layout, the key, or what resolution produces for the same
+// inputs, changes.
+const uint32_t CACHE_VERSION = 3;
+
+const size_t CACHE_FILE_SIZE = 64 * 1024 * 1024;
+const size_t CACHE_SLOT_COUNT = 1024;
+
+// Slots looked at for a key, starting at its home slot.
+const size_t CACHE_PROBE_LENGTH = 8;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the cache needs lock free 64-bit atomics to be shared between processes");
+
+// Two 64-bit FNV-1a hashes with different offset bases, mixed at the end.
+class hasher_t
+{
+public:
+    hasher_t() : m_lo(0xcbf29ce484222325ULL), m_hi(0x84222325cbf29ce4ULL) { }
+
+    void add(const void* data, size_t length)
+    {
+        const unsigned char* bytes = (const unsigned char*) data;
+        for (size_t i = 0; i < length; ++i)
+        {
+            m_lo = (m_lo ^ bytes[i]) * 0x100000001b3ULL;
+            m_hi = (m_hi ^ bytes[i]) * 0x100000001b3ULL;
+        }
+        m_hi = (m_hi ^ length) * 0x100000001b3ULL;
+    }
+
+    void add(const pal::string_t& str)
+    {
+        add(str.data(), str.length() * sizeof(pal::char_t));
+    }
+
+    // Contents of "path", or a marker if it cannot be read.
+    // Identity rather than contents, for files too large to read every launch.
+    void add_identity(const pal::string_t& path)
+    {
+        pal::file_identity_t identity;
+        if (!pal::get_file_identity(path, &identity))
+        {
+            add(_X("<missing>"));
+            return;
+        }
+        add(&identity, sizeof(identity));
+    }
+
+    void add_file(const pal::string_t& path)
+    {
+        auto file = pal::open_file(path);
+        if (!file)
+        {
+            add(_X("<missing>"));
+            return;
+        }
+        char buffer[16 * 1024];
+        while (file->read(buffer, sizeof(buffer)) || file->gcount() > 0)
+        {
+            add(buffer, (size_t) file->gcount());
+        }
+    }
+
+    uint64_t lo() const { return mix(m_lo); }
+    uint64_t hi() const { return mix(m_hi ^ m_lo); }
+
+private:
+    static uint64_t mix(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    uint64_t m_lo;
+    uint64_t m_hi;
+};
+
+uint64_t checksum(const char* data, size_t length)
+{
+    hasher_t hasher;
+    hasher.add(data, length);
+    return hasher.lo();
+}
+} // end of anonymous namespace
+
+struct resolve_cache_t::header_t
+{
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint64_t slot_count;
+    uint64_t arena_offset;
+    uint64_t arena_size;
+
+    // Only changed under the writer lock.
+    std::atomic<uint64_t> arena_used;
+};
+
+// Entry data in the arena: four uint64_t lengths, then the TPA, native and
+// culture strings and the serialized runtime config, not terminated.
+struct resolve_cache_t::slot_t
+{
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> key_lo;
+    std::atomic<uint64_t> key_hi;
+    std::atomic<uint64_t> data_offset;
+    std::atomic<uint64_t> data_size;
+    std::atomic<uint64_t> data_checksum;
+};
+
+resolve_cache_t::resolve_cache_t(const pal::string_t& path)
+    : m_header(nullptr)
+{
+    m_file.data = nullptr;
+    size_t arena_offset = sizeof(header_t) + CACHE_SLOT_COUNT * sizeof(slot_t);
+    if (!pal::map_shared_file(path, CACHE_FILE_SIZE, &m_file))
+    {
+        trace::verbose(_X("Could not map resolution cache %s"), path.c_str());
+        return;
+    }
+    if (m_file.size <= arena_offset)
+    {
+        pal::unmap_shared_file(&m_file);
+        return;
+    }
+
+    header_t* header = (header_t*) m_file.data;
+    if (header->magic.load(std::memory_order_acquire) != CACHE_MAGIC)
+    {
+        // New file, lay it out. The magic goes in last so that readers ignore
+        // the file until it is done.
+        pal::lock_file(m_file);
+        if (header->magic.load(std::memory_order_acquire) != CACHE_MAGIC)
+        {
+            header->version = CACHE_VERSION;
+            header->slot_count = CACHE_SLOT_COUNT;
+            header->arena_offset = arena_offset;
+            header->arena_size = m_file.size - arena_offset;
+            header->arena_used.store(0, std::memory_order_relaxed);
+            header->magic.store(CACHE_MAGIC, std::memory_order_release);
+        }
+        pal::unlock_file(m_file);
+    }
+
+    if (header->version != CACHE_VERSION || header->slot_count != CACHE_SLOT_COUNT ||
+        header->arena_offset != arena_offset || header->arena_offset + header->arena_size > m_file.size)
+    {
+        trace::verbose(_X("Ignoring resolution cache %s with an unknown layout"), path.c_str());
+        pal::unmap_shared_file(&m_file);
+        return;
+    }
+
+    m_header = header;
+}
+
+resolve_cache_t::~resolve_cache_t()
+{
+    pal::unmap_shared_file(&m_file);
+}
+
+resolve_cache_t::slot_t* resolve_cache_t::slot(size_t index) const
+{
+    return (slot_t*) ((char*) m_file.data + sizeof(header_t)) + (index % CACHE_SLOT_COUNT);
+}
+
+resolve_cache_t::key_t resolve_cache_t::compute_key(
+    const arguments_t& args,
+    const pal::string_t& package_dir,
+    const pal::string_t& clr_dir)
+{
+    hasher_t hasher;
+    hasher.add(&CACHE_VERSION, sizeof(CACHE_VERSION));
+
+    hasher.add(args.app_dir);
+    hasher.add(args.deps_path);
+    hasher.add(package_dir);
+    hasher.add(args.dotnet_packages_cache);
+    hasher.add(clr_dir);
+    hasher.add(args.dotnet_servicing);
+    hasher.add(args.dotnet_ni_cache);
+    hasher.add(args.dotnet_probe_roots);
+    hasher.add(args.ui_cultures);
+    for (const auto& variant : get_isa_variants(args))
+    {
+        hasher.add(variant);
+    }
+
+    hasher.add_file(args.deps_path);
+    hasher.add_file(args.runtime_config_path);
+    if (!args.dotnet_servicing.empty())
+    {
+        pal::string_t index = args.dotnet_servicing;
+        append_path(&index, _X("dotnet_servicing_index.txt"));
+        hasher.add_file(index);
+    }
+    if (!args.dotnet_ni_cache.empty())
+    {
+        hasher.add_file(ni_cache_index_t::get_index_path(args.dotnet_ni_cache));
+    }
+
+    // Package store manifests decide what resolves to a store, without the
+    // store being probed.
+    std::vector<pal::string_t> roots;
+    split(args.dotnet_probe_roots, PATH_SEPARATOR, &roots);
+    roots.push_back(package_dir);
+    for (const auto& root : roots)
+    {
+        if (!root.empty())
+        {
+            hasher.add_identity(package_store_t::get_manifest_path(root));
+        }
+    }
+
+    // Packages are found through their hash file in the packages cache, else
+    // their version dir in a store or the restore dir: restoring, removing or
+    // re-restoring one replaces those.
+    std::set<pal::string_t> package_paths;
+    deps_resolver_t resolver(args);
+    if (resolver.valid())
+    {
+        resolver.get_package_paths(package_dir, args.dotnet_packages_cache, &package_paths);
+    }
+    for (const auto& path : package_paths)
+    {
+        hasher.add(path);
+        hasher.add_identity(path);
+    }
+
+    // App local assemblies take precedence over packages, and mscorlib comes
+    // from the CLR dir.
+    for (const pal::string_t* dir : { &args.app_dir, &clr_dir })
+    {
+        std::vector<pal::string_t> files;
+        pal::readdir(*dir, &files);
+        std::sort(files.begin(), files.end());
+        for (const auto& file : files)
+        {
+            hasher.add(file);
+        }
+        hasher.add(_X("<end>"));
+    }
+
+    key_t key;
+    key.lo = hasher.lo();
+    key.hi = hasher.hi();
+    return key;
+}
+
+bool resolve_cache_t::lookup(const key_t& key, probe_paths_t* probe_paths, runtime_config_t* runtime_config)
+{
+    const char* arena = (const char*) m_file.data + m_header->arena_offset;
+    std::vector<char> data;
+
+    for (size_t i = 0; i < CACHE_PROBE_LENGTH; ++i)
+    {
+        slot_t* s = slot(key.lo + i);
+
+        uint64_t seq = s->seq.load(std::memory_order_acquire);
+        if (seq & 1)
+        {
+            // Being written; it may well be our key, but don't wait for it.
+            continue;
+        }
+        if (s->key_lo.load(std::memory_order_relaxed) != key.lo || s->key_hi.load(std::memory_order_relaxed) != key.hi)
+        {
+            continue;
+        }
+        uint64_t offset = s->data_offset.load(std::memory_order_relaxed);
+        uint64_t size = s->data_size.load(std::memory_order_relaxed);
+        uint64_t sum = s->data_checksum.load(std::memory_order_relaxed);
+        if (size < 4 * sizeof(uint64_t) || offset > m_header->arena_size || size > m_header->arena_size - offset)
+        {
+            continue;
+        }
+
+        data.assign(arena + offset, arena + offset + size);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s->seq.load(std::memory_order_relaxed) != seq || checksum(data.data(), data.size()) != sum)
+        {
+            continue;
+        }
+
+        uint64_t lengths[4];
+        memcpy(lengths, data.data(), sizeof(lengths));
+        uint64_t paths_size = (lengths[0] + lengths[1] + lengths[2]) * sizeof(pal::char_t);
+        if (paths_size + lengths[3] != size - sizeof(lengths))
+        {
+            continue;
+        }
+        const pal::char_t* str = (const pal::char_t*) (data.data() + sizeof(lengths));
+        if (!runtime_config->deserialize(std::string(data.data() + sizeof(lengths) + paths_size, lengths[3])))
+        {
+            continue;
+        }
+        probe_paths->tpa.assign(str, lengths[0]);
+        probe_paths->native.assign(str + lengths[0], lengths[1]);
+        probe_paths->culture.assign(str + lengths[0] + lengths[1], lengths[2]);
+        return true;
+    }
+    return false;
+}
+
+void resolve_cache_t::reset()
+{
+    for (size_t i = 0; i < CACHE_SLOT_COUNT; ++i)
+    {
+        slot_t* s = slot(i);
+        uint64_t seq = s->seq.load(std::memory_order_relaxed) & ~(uint64_t) 1;
+        s->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s->key_lo.store(0, std::memory_order_relaxed);
+        s->key_hi.store(0, std::memory_order_relaxed);
+        s->data_size.store(0, std::memory_order_relaxed);
+        s->seq.store(seq + 2, std::memory_order_release);
+    }
+    m_header->arena_used.store(0, std::memory_order_relaxed);
+}
+
+void resolve_cache_t::store(const key_t& key, const probe_paths_t& probe_paths, const runtime_config_t& runtime_config)
+{
+    std::string config = runtime_config.serialize();
+    uint64_t lengths[4] = { probe_paths.tpa.length(), probe_paths.native.length(), probe_paths.culture.length(), config.length() };
+    uint64_t size = sizeof(lengths) + (lengths[0] + lengths[1] + lengths[2]) * sizeof(pal::char_t) + lengths[3];
+    if (size > m_header->arena_size / 4)
+    {
+        trace::verbose(_X("Resolution is too large to cache"));
+        return;
+    }
+
+    if (!pal::try_lock_file(m_file))
+    {
+        trace::verbose(_X("Resolution cache is busy, not caching"));
+        return;
+    }
+
+    // Prefer a free slot or one with our key, else evict the home slot.
+    slot_t* target = slot(key.lo);
+    for (size_t i = 0; i < CACHE_PROBE_LENGTH; ++i)
+    {
+        slot_t* s = slot(key.lo + i);
+        bool same_key = s->key_lo.load(std::memory_order_relaxed) == key.lo && s->key_hi.load(std::memory_order_relaxed) == key.hi;
+        if (same_key || s->data_size.load(std::memory_order_relaxed) == 0)
+        {
+            target = s;
+            break;
+        }
+    }
+
+    // Out of arena: start over rather than compact, entries are cheap to redo.
+    uint64_t offset = (m_header->arena_used.load(std::memory_order_relaxed) + 7) & ~(uint64_t) 7;
+    if (offset + size > m_header->arena_size)
+    {
+        trace::verbose(_X("Resolution cache is full, clearing it"));
+        reset();
+        offset = 0;
+        target = slot(key.lo);
+    }
+
+    // A writer that died mid-write leaves an odd sequence number behind.
+    uint64_t seq = target->seq.load(std::memory_order_relaxed) & ~(uint64_t) 1;
+    target->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    char* data = (char*) m_file.data + m_header->arena_offset + offset;
+    memcpy(data, lengths, sizeof(lengths));
+    pal::char_t* str = (pal::char_t*) (data + sizeof(lengths));
+    memcpy(str, probe_paths.tpa.data(), lengths[0] * sizeof(pal::char_t));
+    memcpy(str + lengths[0], probe_paths.native.data(), lengths[1] * sizeof(pal::char_t));
+    memcpy(str + lengths[0] + lengths[1], probe_paths.culture.data(), lengths[2] * sizeof(pal::char_t));
+    memcpy(str + lengths[0] + lengths[1] + lengths[2], config.data(), lengths[3]);
+
+    target->key_lo.store(key.lo, std::memory_order_relaxed);
+    target->key_hi.store(key.hi, std::memory_order_relaxed);
+    target->data_offset.store(offset, std::memory_order_relaxed);
+    target->data_size.store(size, std::memory_order_relaxed);
+    target->data_checksum.store(checksum(data, size), std::memory_order_relaxed);
+    target->seq.store(seq + 2, std::memory_order_release);
+
+    m_header->arena_used.store(offset + size, std::memory_order_relaxed);
+    pal::unlock_file(m_file);
+
+    trace::verbose(_X("Cached resolution of %d bytes"), (int) size);
+}
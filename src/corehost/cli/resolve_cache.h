@@ -0,0 +1,59 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef RESOLVE_CACHE_H
+#define RESOLVE_CACHE_H
+
+#include "args.h"
+#include "deps_resolver.h"
+
+// -----------------------------------------------------------------------------
+// Machine-wide cache of resolved probe paths, shared by every host process of
+// the user through a memory mapped file.
+//
+// Entries are keyed by a hash of everything resolution reads that can change
+// between launches of an app: the deps file, runtime config and servicing
+// index contents, the app and CLR dir listings, the probe roots and the
+// identity of each package's hash file and version dirs. Along with the probe
+// paths, an entry keeps the parsed runtime config. Resolutions that missed an
+// asset are not stored, as restoring it changes nothing the key covers.
+//
+// Readers take no lock: every slot carries a sequence number that is odd
+// while the slot is written, and a reader retries or misses if it changed
+// while the entry was copied out. Writers serialize on flock() and skip
+// caching rather than wait when another writer holds it.
+//
+class resolve_cache_t
+{
+public:
+    struct key_t
+    {
+        uint64_t lo;
+        uint64_t hi;
+    };
+
+    resolve_cache_t(const pal::string_t& path);
+    ~resolve_cache_t();
+
+    bool valid() const { return m_header != nullptr; }
+
+    static key_t compute_key(
+        const arguments_t& args,
+        const pal::string_t& package_dir,
+        const pal::string_t& clr_dir);
+
+    bool lookup(const key_t& key, probe_paths_t* probe_paths, runtime_config_t* runtime_config);
+    void store(const key_t& key, const probe_paths_t& probe_paths, const runtime_config_t& runtime_config);
+
+private:
+    struct header_t;
+    struct slot_t;
+
+    slot_t* slot(size_t index) const;
+    void reset();
+
+    pal::shared_file_t m_file;
+    header_t* m_header;
+};
+
+#endif // RESOLVE_CACHE_H
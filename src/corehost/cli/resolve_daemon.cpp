@@ -0,0 +1,149 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "trace.h"
+#include "resolve_daemon.h"
+
+namespace
+{
+const uint32_t DAEMON_MAGIC = 0x44524843; // "CHRD"
+
+// Bump with any change to the messages or to what deps_resolver_t produces.
+const uint32_t DAEMON_PROTOCOL_VERSION = 6;
+
+// Upper bound for one string, so that a confused peer cannot make us allocate
+// without limit.
+const uint32_t DAEMON_MAX_STRING = 256 * 1024 * 1024;
+
+enum reply_status_t : uint32_t
+{
+    reply_resolved = 0,
+    reply_failed   = 1,
+};
+
+bool send_u32(intptr_t socket, uint32_t value)
+{
+    return pal::local_socket_send(socket, &value, sizeof(value));
+}
+
+bool recv_u32(intptr_t socket, uint32_t* value)
+{
+    return pal::local_socket_recv(socket, value, sizeof(*value));
+}
+
+bool send_string(intptr_t socket, const pal::string_t& str)
+{
+    uint32_t bytes = (uint32_t) (str.length() * sizeof(pal::char_t));
+    return send_u32(socket, bytes) && (bytes == 0 || pal::local_socket_send(socket, str.data(), bytes));
+}
+
+bool recv_string(intptr_t socket, pal::string_t* str)
+{
+    uint32_t bytes;
+    if (!recv_u32(socket, &bytes) || bytes > DAEMON_MAX_STRING || bytes % sizeof(pal::char_t) != 0)
+    {
+        return false;
+    }
+    str->resize(bytes / sizeof(pal::char_t));
+    return bytes == 0 || pal::local_socket_recv(socket, &(*str)[0], bytes);
+}
+
+bool send_header(intptr_t socket)
+{
+    return send_u32(socket, DAEMON_MAGIC) && send_u32(socket, DAEMON_PROTOCOL_VERSION);
+}
+
+bool recv_header(intptr_t socket)
+{
+    uint32_t magic, version;
+    return recv_u32(socket, &magic) && recv_u32(socket, &version) &&
+        magic == DAEMON_MAGIC && version == DAEMON_PROTOCOL_VERSION;
+}
+} // end of anonymous namespace
+
+arguments_t resolve_request_t::to_arguments() const
+{
+    arguments_t args;
+    args.app_dir = app_dir;
+    args.deps_path = deps_path;
+    args.dotnet_packages_cache = package_cache_dir;
+    args.dotnet_servicing = servicing_dir;
+    args.dotnet_ni_cache = ni_cache_dir;
+    args.isa_variants = isa_variants;
+    args.dotnet_probe_roots = probe_roots;
+    args.ui_cultures = ui_cultures;
+    return args;
+}
+
+bool query_resolve_daemon(
+    const pal::string_t& socket_path,
+    int timeout_ms,
+    const resolve_request_t& request,
+    probe_paths_t* probe_paths)
+{
+    intptr_t socket;
+    if (!pal::local_socket_connect(socket_path, timeout_ms, &socket))
+    {
+        trace::verbose(_X("No resolution daemon at %s"), socket_path.c_str());
+        return false;
+    }
+
+    bool sent = send_header(socket) &&
+        send_string(socket, request.app_dir) &&
+        send_string(socket, request.deps_path) &&
+        send_string(socket, request.package_dir) &&
+        send_string(socket, request.package_cache_dir) &&
+        send_string(socket, request.clr_dir) &&
+        send_string(socket, request.servicing_dir) &&
+        send_string(socket, request.ni_cache_dir) &&
+        send_string(socket, request.isa_variants) &&
+        send_string(socket, request.probe_roots) &&
+        send_string(socket, request.ui_cultures);
+
+    uint32_t status = reply_failed;
+    uint32_t complete = 0;
+    bool received = sent && recv_header(socket) && recv_u32(socket, &status) &&
+        recv_string(socket, &probe_paths->tpa) &&
+        recv_string(socket, &probe_paths->native) &&
+        recv_string(socket, &probe_paths->culture) &&
+        recv_u32(socket, &complete);
+    probe_paths->complete = complete != 0;
+    pal::local_socket_close(socket);
+
+    if (!received)
+    {
+        trace::info(_X("Resolution daemon at %s did not answer in time or is stale"), socket_path.c_str());
+        return false;
+    }
+    if (status != reply_resolved)
+    {
+        trace::info(_X("Resolution daemon at %s could not resolve the app"), socket_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool read_resolve_request(intptr_t socket, resolve_request_t* request)
+{
+    return recv_header(socket) &&
+        recv_string(socket, &request->app_dir) &&
+        recv_string(socket, &request->deps_path) &&
+        recv_string(socket, &request->package_dir) &&
+        recv_string(socket, &request->package_cache_dir) &&
+        recv_string(socket, &request->clr_dir) &&
+        recv_string(socket, &request->servicing_dir) &&
+        recv_string(socket, &request->ni_cache_dir) &&
+        recv_string(socket, &request->isa_variants) &&
+        recv_string(socket, &request->probe_roots) &&
+        recv_string(socket, &request->ui_cultures);
+}
+
+bool write_resolve_reply(intptr_t socket, bool resolved, const probe_paths_t& probe_paths)
+{
+    return send_header(socket) &&
+        send_u32(socket, resolved ? reply_resolved : reply_failed) &&
+        send_string(socket, probe_paths.tpa) &&
+        send_string(socket, probe_paths.native) &&
+        send_string(socket, probe_paths.culture) &&
+        send_u32(socket, probe_paths.complete ? 1 : 0);
+}
@@ -0,0 +1,52 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef RESOLVE_DAEMON_H
+#define RESOLVE_DAEMON_H
+
+#include "args.h"
+#include "deps_resolver.h"
+
+// -----------------------------------------------------------------------------
+// Wire protocol between hostpolicy and corehost_resolved, the optional
+// resolution daemon. A request carries what deps_resolver_t needs to resolve
+// an app; the reply carries its probe paths, and whether every runtime asset
+// was found, or a failure status.
+//
+// Messages are a magic, the protocol version and a list of length-prefixed
+// strings, the reply with a status before them and a flag after them. The
+// version also covers the resolution rules: the daemon must be built from the
+// same resolver as the host, else hosts see it as stale and resolve
+// in-process.
+//
+struct resolve_request_t
+{
+    pal::string_t app_dir;
+    pal::string_t deps_path;
+    pal::string_t package_dir;
+    pal::string_t package_cache_dir;
+    pal::string_t clr_dir;
+    pal::string_t servicing_dir;
+    pal::string_t ni_cache_dir;
+    pal::string_t isa_variants;
+    pal::string_t probe_roots;
+    pal::string_t ui_cultures;
+
+    // Arguments the in-process resolver would be constructed with.
+    arguments_t to_arguments() const;
+};
+
+// Ask the daemon listening at "socket_path" to resolve "request". Returns
+// false, without waiting longer than "timeout_ms" per step, if there is no
+// daemon, it is stale or it could not resolve the app.
+bool query_resolve_daemon(
+    const pal::string_t& socket_path,
+    int timeout_ms,
+    const resolve_request_t& request,
+    probe_paths_t* probe_paths);
+
+// Daemon side of the exchange.
+bool read_resolve_request(intptr_t socket, resolve_request_t* request);
+bool write_resolve_reply(intptr_t socket, bool resolved, const probe_paths_t& probe_paths);
+
+#endif // RESOLVE_DAEMON_H
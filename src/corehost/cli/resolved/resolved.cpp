@@ -0,0 +1,565 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// corehost_resolved: optional per-user resolution daemon.
+//
+// Runs the same deps_resolver_t as hostpolicy, but over a view of the file
+// system that remembers every stat, directory listing, realpath and file it
+// has read. inotify watches on the directories involved drop what changed, so
+// the package restore dir, package cache dir and servicing index are only
+// read again when they are modified. Hosts started with COREHOST_RESOLVE_DAEMON
+// send their resolution request over a Unix socket and fall back to resolving
+// in-process when the daemon is missing, slow or stale.
+//
+
+#include <map>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "utils.h"
+#include "resolve_daemon.h"
+
+namespace
+{
+const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY |
+    IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+volatile sig_atomic_t g_stop = 0;
+
+void on_stop_signal(int)
+{
+    g_stop = 1;
+}
+
+// Collapse repeated separators and drop a trailing one, so that every spelling
+// of a path maps to the same cache key.
+pal::string_t normalize(const pal::string_t& path)
+{
+    pal::string_t result;
+    result.reserve(path.length());
+    for (pal::char_t c : path)
+    {
+        if (c != DIR_SEPARATOR || result.empty() || result.back() != DIR_SEPARATOR)
+        {
+            result.push_back(c);
+        }
+    }
+    if (result.length() > 1 && result.back() == DIR_SEPARATOR)
+    {
+        result.pop_back();
+    }
+    return result;
+}
+
+pal::string_t parent_of(const pal::string_t& path)
+{
+    auto sep = path.find_last_of(DIR_SEPARATOR);
+    if (sep == pal::string_t::npos)
+    {
+        return _X(".");
+    }
+    return (sep == 0) ? pal::string_t(1, DIR_SEPARATOR) : path.substr(0, sep);
+}
+
+// Erase "path" and everything under it from "map". Returns whether anything
+// was erased.
+template <typename T>
+bool erase_tree(std::map<pal::string_t, T>* map, const pal::string_t& path)
+{
+    size_t size = map->size();
+    auto iter = map->lower_bound(path);
+    while (iter != map->end() && starts_with(iter->first, path))
+    {
+        const pal::string_t& key = iter->first;
+        if (key.length() == path.length() || key[path.length()] == DIR_SEPARATOR || path == _X("/"))
+        {
+            iter = map->erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+    return map->size() != size;
+}
+
+// -----------------------------------------------------------------------------
+// File system view that caches the native file system and is kept fresh with
+// inotify. A result is only cached once watches cover it: the directory that
+// holds the path or, for a path that does not exist yet, its closest existing
+// ancestor, and every directory above that, so that renaming any of them is
+// seen too. Without watches (e.g. out of inotify watches) calls go straight
+// to the native file system.
+//
+// Changing where a symlink on the way points is only noticed through the
+// events in the directory that holds the link.
+//
+class watched_file_system_t : public pal::file_system_t
+{
+public:
+    watched_file_system_t(int inotify_fd)
+        : m_native(pal::native_file_system())
+        , m_inotify(inotify_fd)
+        , m_generation(0)
+    {
+    }
+
+    bool realpath(pal::string_t* path) override
+    {
+        pal::string_t key = normalize(*path);
+        auto iter = m_realpaths.find(key);
+        if (iter != m_realpaths.end())
+        {
+            if (iter->second.first)
+            {
+                path->assign(iter->second.second);
+            }
+            return iter->second.first;
+        }
+
+        bool watched = watch_parent(key);
+        pal::string_t real = *path;
+        bool ok = m_native->realpath(&real);
+        if (watched)
+        {
+            m_realpaths[key] = std::make_pair(ok, real);
+        }
+        else
+        {
+            ++m_generation;
+        }
+        if (ok)
+        {
+            path->assign(real);
+        }
+        return ok;
+    }
+
+    bool file_exists(const pal::string_t& path) override
+    {
+        pal::string_t key = normalize(path);
+        auto iter = m_exists.find(key);
+        if (iter != m_exists.end())
+        {
+            return iter->second;
+        }
+
+        bool watched = watch_parent(key);
+        bool exists = m_native->file_exists(path);
+        if (watched)
+        {
+            m_exists[key] = exists;
+        }
+        else
+        {
+            ++m_generation;
+        }
+        return exists;
+    }
+
+    void readdir(const pal::string_t& path, std::vector<pal::string_t>* list) override
+    {
+        pal::string_t key = normalize(path);
+        auto iter = m_listings.find(key);
+        if (iter == m_listings.end())
+        {
+            bool watched = watch_tree(key) || watch_parent(key);
+            std::vector<pal::string_t> files;
+            m_native->readdir(path, &files);
+            if (!watched)
+            {
+                ++m_generation;
+                list->insert(list->end(), files.begin(), files.end());
+                return;
+            }
+            iter = m_listings.emplace(key, std::move(files)).first;
+        }
+        list->insert(list->end(), iter->second.begin(), iter->second.end());
+    }
+
+    std::unique_ptr<std::istream> open_file(const pal::string_t& path) override
+    {
+        pal::string_t key = normalize(path);
+        auto iter = m_contents.find(key);
+        if (iter == m_contents.end())
+        {
+            bool watched = watch_parent(key);
+            std::shared_ptr<const std::string> content;
+            auto file = m_native->open_file(path);
+            if (file)
+            {
+                content = std::make_shared<const std::string>(std::istreambuf_iterator<char>(*file), std::istreambuf_iterator<char>());
+            }
+            if (!watched)
+            {
+                ++m_generation;
+                return content ? std::unique_ptr<std::istream>(new std::istringstream(*content)) : nullptr;
+            }
+            iter = m_contents.emplace(key, content).first;
+        }
+        if (!iter->second)
+        {
+            return nullptr;
+        }
+        return std::unique_ptr<std::istream>(new std::istringstream(*iter->second));
+    }
+
+    // Apply every queued inotify event.
+    void process_events()
+    {
+        alignas(struct inotify_event) char buffer[64 * 1024];
+        for (;;)
+        {
+            ssize_t length = ::read(m_inotify, buffer, sizeof(buffer));
+            if (length <= 0)
+            {
+                return;
+            }
+            for (char* p = buffer; p < buffer + length; )
+            {
+                const struct inotify_event* event = (const struct inotify_event*) p;
+                p += sizeof(struct inotify_event) + event->len;
+                process_event(event);
+            }
+        }
+    }
+
+    // Changes whenever something read through this view may have changed
+    // since, or was not cached because it could not be watched.
+    uint64_t generation() const { return m_generation; }
+
+    size_t watch_count() const { return m_watch_dirs.size(); }
+    size_t entry_count() const { return m_exists.size() + m_realpaths.size() + m_listings.size() + m_contents.size(); }
+
+private:
+    void process_event(const struct inotify_event* event)
+    {
+        if (event->mask & IN_Q_OVERFLOW)
+        {
+            trace::info(_X("inotify queue overflowed, dropping all cached file system state"));
+            m_exists.clear();
+            m_realpaths.clear();
+            m_listings.clear();
+            m_contents.clear();
+            ++m_generation;
+            return;
+        }
+
+        auto iter = m_watch_dirs.find(event->wd);
+        if (iter == m_watch_dirs.end())
+        {
+            return;
+        }
+        pal::string_t dir = iter->second;
+
+        if (event->len > 0)
+        {
+            pal::string_t child = dir;
+            if (child != _X("/"))
+            {
+                child.push_back(DIR_SEPARATOR);
+            }
+            child.append(event->name);
+            invalidate(child);
+            if (m_listings.erase(dir) > 0)
+            {
+                ++m_generation;
+            }
+
+            // Watches follow a directory when it moves: drop the ones that no
+            // longer watch the path they were added for.
+            if ((event->mask & IN_ISDIR) && (event->mask & (IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE)))
+            {
+                unwatch_tree(child);
+            }
+        }
+
+        if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+        {
+            invalidate(dir);
+            if (event->mask & IN_IGNORED)
+            {
+                m_dir_watches.erase(dir);
+                m_watch_dirs.erase(iter);
+            }
+            else
+            {
+                unwatch_tree(dir);
+            }
+        }
+    }
+
+    void unwatch_tree(const pal::string_t& path)
+    {
+        auto iter = m_dir_watches.lower_bound(path);
+        while (iter != m_dir_watches.end() && starts_with(iter->first, path))
+        {
+            const pal::string_t& dir = iter->first;
+            if (dir.length() == path.length() || dir[path.length()] == DIR_SEPARATOR || path == _X("/"))
+            {
+                ::inotify_rm_watch(m_inotify, iter->second);
+                m_watch_dirs.erase(iter->second);
+                iter = m_dir_watches.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+
+    void invalidate(const pal::string_t& path)
+    {
+        bool erased = erase_tree(&m_exists, path);
+        erased = erase_tree(&m_realpaths, path) || erased;
+        erased = erase_tree(&m_listings, path) || erased;
+        erased = erase_tree(&m_contents, path) || erased;
+        if (erased)
+        {
+            ++m_generation;
+        }
+    }
+
+    // Watch "dir" and all of its ancestors. Returns false, with errno set, if
+    // one of them cannot be watched, e.g. because "dir" does not exist.
+    bool watch_tree(const pal::string_t& dir)
+    {
+        if (m_dir_watches.count(dir))
+        {
+            return true;
+        }
+        pal::string_t parent = parent_of(dir);
+        if (parent != dir && !watch_tree(parent))
+        {
+            return false;
+        }
+        int wd = ::inotify_add_watch(m_inotify, dir.c_str(), WATCH_MASK);
+        if (wd < 0)
+        {
+            if (errno == ENOSPC)
+            {
+                trace::warning(_X("Out of inotify watches, not caching under %s"), dir.c_str());
+            }
+            return false;
+        }
+        m_dir_watches[dir] = wd;
+        m_watch_dirs[wd] = dir;
+        return true;
+    }
+
+    // Watch the closest existing ancestor of "path".
+    bool watch_parent(const pal::string_t& path)
+    {
+        pal::string_t dir = parent_of(path);
+        for (;;)
+        {
+            if (watch_tree(dir))
+            {
+                return true;
+            }
+            if ((errno != ENOENT && errno != ENOTDIR) || dir == _X("/") || dir == _X("."))
+            {
+                return false;
+            }
+            dir = parent_of(dir);
+        }
+    }
+
+    pal::file_system_t* m_native;
+    int m_inotify;
+    uint64_t m_generation;
+
+    std::unordered_map<int, pal::string_t> m_watch_dirs;
+    std::map<pal::string_t, int> m_dir_watches;
+
+    std::map<pal::string_t, bool> m_exists;
+    std::map<pal::string_t, std::pair<bool, pal::string_t>> m_realpaths;
+    std::map<pal::string_t, std::vector<pal::string_t>> m_listings;
+    std::map<pal::string_t, std::shared_ptr<const std::string>> m_contents;
+};
+
+// Replies resolved at the current file system generation, so that repeated
+// launches of an unchanged app skip the resolver altogether.
+struct reply_t
+{
+    bool resolved;
+    probe_paths_t probe_paths;
+};
+
+class reply_memo_t
+{
+public:
+    reply_memo_t() : m_generation(0) { }
+
+    const reply_t* find(uint64_t generation, const pal::string_t& key)
+    {
+        if (generation != m_generation)
+        {
+            m_replies.clear();
+            m_generation = generation;
+        }
+        auto iter = m_replies.find(key);
+        return (iter == m_replies.end()) ? nullptr : &iter->second;
+    }
+
+    void add(uint64_t generation, const pal::string_t& key, const reply_t& reply)
+    {
+        if (generation != m_generation || m_replies.size() >= 256)
+        {
+            m_replies.clear();
+            m_generation = generation;
+        }
+        m_replies[key] = reply;
+    }
+
+private:
+    uint64_t m_generation;
+    std::unordered_map<pal::string_t, reply_t> m_replies;
+};
+
+pal::string_t memo_key(const resolve_request_t& request)
+{
+    pal::string_t key;
+    for (const pal::string_t* field : { &request.app_dir, &request.deps_path, &request.package_dir,
+        &request.package_cache_dir, &request.clr_dir, &request.servicing_dir, &request.ni_cache_dir,
+        &request.isa_variants, &request.probe_roots, &request.ui_cultures })
+    {
+        key.append(*field);
+        key.push_back(_X('\0'));
+    }
+    return key;
+}
+
+bool resolve(const resolve_request_t& request, probe_paths_t* probe_paths)
+{
+    arguments_t args = request.to_arguments();
+    deps_resolver_t resolver(args);
+    if (!resolver.valid())
+    {
+        return false;
+    }
+    return resolver.resolve_probe_paths(request.app_dir, request.package_dir, request.package_cache_dir, request.clr_dir, probe_paths);
+}
+
+void serve(intptr_t client, watched_file_system_t* fs, reply_memo_t* memo)
+{
+    // Anything changed before the host sent its request must be seen.
+    fs->process_events();
+
+    resolve_request_t request;
+    if (!read_resolve_request(client, &request))
+    {
+        write_resolve_reply(client, false, probe_paths_t());
+        return;
+    }
+
+    pal::string_t key = memo_key(request);
+    uint64_t generation = fs->generation();
+    const reply_t* known = memo->find(generation, key);
+    if (known != nullptr)
+    {
+        write_resolve_reply(client, known->resolved, known->probe_paths);
+        trace::verbose(_X("Resolved %s: unchanged"), request.deps_path.c_str());
+        return;
+    }
+
+    reply_t reply;
+    reply.resolved = resolve(request, &reply.probe_paths);
+    write_resolve_reply(client, reply.resolved, reply.probe_paths);
+    if (fs->generation() == generation)
+    {
+        memo->add(generation, key, reply);
+    }
+
+    trace::verbose(_X("Resolved %s: %s; %d watches, %d cached entries"), request.deps_path.c_str(),
+        reply.resolved ? _X("ok") : _X("failed"), (int) fs->watch_count(), (int) fs->entry_count());
+}
+
+void display_help()
+{
+    xerr <<
+        _X("Usage: corehost_resolved [--socket=PATH]\n\n")
+        _X("Serves app resolution requests from hosts run with COREHOST_RESOLVE_DAEMON=1 (or\n")
+        _X("set to PATH) until interrupted. The default socket is\n")
+        _X("$XDG_RUNTIME_DIR/corehost_resolved.<uid>.sock, or under /tmp.\n");
+}
+} // end of anonymous namespace
+
+int main(const int argc, const pal::char_t* argv[])
+{
+    trace::setup();
+
+    pal::string_t socket_path;
+    pal::get_default_resolve_daemon_path(&socket_path);
+    for (int i = 1; i < argc; ++i)
+    {
+        pal::string_t arg = argv[i];
+        if (starts_with(arg, _X("--socket=")))
+        {
+            socket_path = arg.substr(9);
+        }
+        else
+        {
+            display_help();
+            return 1;
+        }
+    }
+
+    int inotify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0)
+    {
+        trace::error(_X("inotify is not available: %s"), std::strerror(errno));
+        return 1;
+    }
+    watched_file_system_t fs(inotify_fd);
+    reply_memo_t memo;
+    pal::set_file_system(&fs);
+
+    intptr_t listener;
+    if (!pal::local_socket_listen(socket_path, &listener))
+    {
+        return 1;
+    }
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = on_stop_signal;
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+    ::signal(SIGPIPE, SIG_IGN);
+
+    trace::info(_X("Listening on %s"), socket_path.c_str());
+    trace::flush();
+
+    while (!g_stop)
+    {
+        struct pollfd fds[2] = { { (int) listener, POLLIN, 0 }, { inotify_fd, POLLIN, 0 } };
+        if (::poll(fds, 2, -1) < 0)
+        {
+            continue;
+        }
+        if (fds[1].revents & POLLIN)
+        {
+            fs.process_events();
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            intptr_t client;
+            if (pal::local_socket_accept(listener, 5000, &client))
+            {
+                serve(client, &fs, &memo);
+                pal::local_socket_close(client);
+                trace::flush();
+            }
+        }
+    }
+
+    pal::local_socket_close(listener);
+    ::unlink(socket_path.c_str());
+    pal::set_file_system(nullptr);
+    return 0;
+}
@@ -0,0 +1,72 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef RESOLVER_API_H
+#define RESOLVER_API_H
+
+#include "pal.h"
+
+// -----------------------------------------------------------------------------
+// hostpolicy's embedding API: resolve apps the way corehost would, without
+// running them, for launchers and test runners that prepare many launches.
+//
+//   corehost_resolver_create   Create a resolver for a set of probe roots.
+//   corehost_resolver_resolve  Resolve an app, as many times and from as many
+//                              threads as needed.
+//   corehost_resolution_free   Free what corehost_resolver_resolve returned.
+//   corehost_resolver_destroy  Destroy the resolver, once no resolve is in
+//                              progress.
+//
+// A resolver remembers every directory listing, existence check, realpath and
+// file (deps, hash, servicing and image index files) it has read, so that resolving
+// the next app only probes what has not been seen. It assumes none of that
+// changes while it lives: destroy and recreate it after changing the package
+// roots or an app it has already resolved.
+//
+// The functions return 0 on success, else one of hostpolicy's exit codes.
+//
+#define COREHOST_RESOLVER_VERSION 3
+
+// The layout only grows, as for host_context_t.
+struct corehost_resolver_options_t
+{
+    size_t size;
+    int version;
+
+    // Probe roots. A null root is read from the same environment variable as
+    // corehost reads it from.
+    const pal::char_t* package_dir;             // NUGET_PACKAGES
+    const pal::char_t* package_cache_dir;       // DOTNET_PACKAGES_CACHE
+    const pal::char_t* servicing_dir;           // DOTNET_SERVICING
+    const pal::char_t* runtime_servicing_dir;   // DOTNET_RUNTIME_SERVICING
+    const pal::char_t* dotnet_home;             // DOTNET_HOME
+
+    // Version 2.
+    const pal::char_t* ni_cache_dir;            // DOTNET_NI_CACHE
+
+    // Version 3.
+    const pal::char_t* probe_roots;             // DOTNET_PROBE_ROOTS
+};
+
+// The CoreCLR dir and the values of the app's TRUSTED_PLATFORM_ASSEMBLIES,
+// NATIVE_DLL_SEARCH_DIRECTORIES and PLATFORM_RESOURCE_ROOTS properties.
+struct corehost_resolution_t
+{
+    const pal::char_t* clr_dir;
+    const pal::char_t* tpa;
+    const pal::char_t* native;
+    const pal::char_t* culture;
+};
+
+struct corehost_resolver_t;
+
+typedef int (*corehost_resolver_create_fn) (const corehost_resolver_options_t* options, corehost_resolver_t** resolver);
+
+// "deps_path" may be null for the deps file next to "managed_application".
+typedef int (*corehost_resolver_resolve_fn) (corehost_resolver_t* resolver, const pal::char_t* managed_application,
+    const pal::char_t* deps_path, corehost_resolution_t** resolution);
+
+typedef void (*corehost_resolution_free_fn) (corehost_resolution_t* resolution);
+typedef void (*corehost_resolver_destroy_fn) (corehost_resolver_t* resolver);
+
+#endif // RESOLVER_API_H
@@ -0,0 +1,112 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <sstream>
+
+#include "resolver_context.h"
+
+caching_file_system_t::caching_file_system_t()
+    : m_native(pal::native_file_system())
+{
+}
+
+bool caching_file_system_t::realpath(pal::string_t* path)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto iter = m_realpaths.find(*path);
+        if (iter != m_realpaths.end())
+        {
+            if (iter->second.first)
+            {
+                path->assign(iter->second.second);
+            }
+            return iter->second.first;
+        }
+    }
+
+    pal::string_t real = *path;
+    bool ok = m_native->realpath(&real);
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_realpaths.emplace(*path, std::make_pair(ok, real));
+    }
+    if (ok)
+    {
+        path->assign(real);
+    }
+    return ok;
+}
+
+bool caching_file_system_t::file_exists(const pal::string_t& path)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto iter = m_exists.find(path);
+        if (iter != m_exists.end())
+        {
+            return iter->second;
+        }
+    }
+
+    bool exists = m_native->file_exists(path);
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_exists.emplace(path, exists);
+    return exists;
+}
+
+void caching_file_system_t::readdir(const pal::string_t& path, std::vector<pal::string_t>* list)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto iter = m_listings.find(path);
+        if (iter != m_listings.end())
+        {
+            list->insert(list->end(), iter->second.begin(), iter->second.end());
+            return;
+        }
+    }
+
+    std::vector<pal::string_t> files;
+    m_native->readdir(path, &files);
+    list->insert(list->end(), files.begin(), files.end());
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_listings.emplace(path, std::move(files));
+}
+
+std::unique_ptr<std::istream> caching_file_system_t::open_file(const pal::string_t& path)
+{
+    std::string contents;
+    bool opened = false;
+    bool cached = false;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto iter = m_contents.find(path);
+        if (iter != m_contents.end())
+        {
+            opened = iter->second.first;
+            contents = iter->second.second;
+            cached = true;
+        }
+    }
+
+    if (!cached)
+    {
+        auto file = m_native->open_file(path);
+        opened = file != nullptr;
+        if (opened)
+        {
+            contents.assign(std::istreambuf_iterator<char>(*file), std::istreambuf_iterator<char>());
+        }
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_contents.emplace(path, std::make_pair(opened, contents));
+    }
+
+    if (!opened)
+    {
+        return nullptr;
+    }
+    return std::unique_ptr<std::istream>(new std::istringstream(contents));
+}
@@ -0,0 +1,60 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef RESOLVER_CONTEXT_H
+#define RESOLVER_CONTEXT_H
+
+#include <mutex>
+
+#include "args.h"
+#include "resolver_api.h"
+
+// -----------------------------------------------------------------------------
+// A file system that answers every probe it has seen before from memory.
+// Lookups and inserts take a lock, the probes themselves do not, so threads
+// resolving at the same time only wait on each other for map operations.
+//
+class caching_file_system_t : public pal::file_system_t
+{
+public:
+    caching_file_system_t();
+
+    bool realpath(pal::string_t* path) override;
+    bool file_exists(const pal::string_t& path) override;
+    void readdir(const pal::string_t& path, std::vector<pal::string_t>* list) override;
+    std::unique_ptr<std::istream> open_file(const pal::string_t& path) override;
+
+private:
+    pal::file_system_t* m_native;
+    std::mutex m_lock;
+
+    // Path -> (success, realpath).
+    std::unordered_map<pal::string_t, std::pair<bool, pal::string_t>> m_realpaths;
+    std::unordered_map<pal::string_t, bool> m_exists;
+    std::unordered_map<pal::string_t, std::vector<pal::string_t>> m_listings;
+
+    // Path -> (opened, contents).
+    std::unordered_map<pal::string_t, std::pair<bool, std::string>> m_contents;
+};
+
+// The state behind a corehost_resolver_t handle.
+struct corehost_resolver_t
+{
+    // Probe roots, in the fields parse_arguments() would put them in.
+    arguments_t args;
+
+    // The package restore dir those resolve to.
+    pal::string_t packages_dir;
+
+    caching_file_system_t fs;
+};
+
+// Makes "fs" the calling thread's file system while in scope.
+class thread_file_system_scope_t
+{
+public:
+    thread_file_system_scope_t(pal::file_system_t* fs) { pal::set_thread_file_system(fs); }
+    ~thread_file_system_scope_t() { pal::set_thread_file_system(nullptr); }
+};
+
+#endif // RESOLVER_CONTEXT_H
@@ -0,0 +1,702 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+#include "trace.h"
+#include "utils.h"
+#include "runtime_config.h"
+
+namespace
+{
+enum class knob_type_t
+{
+    boolean,
+    integer
+};
+
+// Knobs the host type checks and lets the environment override. Integers are
+// decimal, or hexadecimal with a "0x" prefix when given as a string.
+struct knob_t
+{
+    const char* name;
+    knob_type_t type;
+    const pal::char_t* env;
+};
+
+const knob_t KNOBS[] = {
+    { "System.GC.Server", knob_type_t::boolean, _X("COREHOST_SERVER_GC") },
+    { "System.GC.Concurrent", knob_type_t::boolean, _X("COREHOST_GC_CONCURRENT") },
+    { "System.GC.RetainVM", knob_type_t::boolean, _X("COREHOST_GC_RETAIN_VM") },
+    { "System.GC.HeapCount", knob_type_t::integer, _X("COREHOST_GC_HEAP_COUNT") },
+    { "System.GC.HeapAffinitizeMask", knob_type_t::integer, _X("COREHOST_GC_HEAP_AFFINITIZE_MASK") },
+    { "System.GC.NoAffinitize", knob_type_t::boolean, _X("COREHOST_GC_NO_AFFINITIZE") },
+    { "System.GC.HeapHardLimit", knob_type_t::integer, _X("COREHOST_GC_HEAP_HARD_LIMIT") },
+    { "System.GC.HeapHardLimitPercent", knob_type_t::integer, _X("COREHOST_GC_HEAP_HARD_LIMIT_PERCENT") },
+    { "System.GC.LargePages", knob_type_t::boolean, _X("COREHOST_GC_LARGE_PAGES") },
+    { "System.Threading.ThreadPool.MinThreads", knob_type_t::integer, _X("COREHOST_THREADPOOL_MIN_THREADS") },
+    { "System.Threading.ThreadPool.MaxThreads", knob_type_t::integer, _X("COREHOST_THREADPOOL_MAX_THREADS") },
+    { "Microsoft.Host.FastExit", knob_type_t::boolean, _X("COREHOST_FAST_EXIT") },
+    { "Microsoft.Host.ShutdownTimeoutMs", knob_type_t::integer, _X("COREHOST_SHUTDOWN_TIMEOUT_MS") },
+    { "Microsoft.Host.TrimTpa", knob_type_t::boolean, _X("COREHOST_TRIM_TPA") },
+    { "Microsoft.Host.NativeView", knob_type_t::boolean, _X("COREHOST_NATIVE_VIEW") },
+};
+
+const knob_t* find_knob(const std::string& name)
+{
+    for (const auto& knob : KNOBS)
+    {
+        if (name == knob.name)
+        {
+            return &knob;
+        }
+    }
+    return nullptr;
+}
+
+bool is_integer(const std::string& value)
+{
+    size_t digits = (value.compare(0, 2, "0x") == 0 || value.compare(0, 2, "0X") == 0) ? 2 : 0;
+    bool hex = digits == 2;
+    if (value.length() == digits || value.length() > digits + 20)
+    {
+        return false;
+    }
+    for (size_t i = digits; i < value.length(); ++i)
+    {
+        char c = value[i];
+        if (!(c >= '0' && c <= '9') && !(hex && ((c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Config values stay UTF-8 on every platform, so pal::strcasecmp, which takes
+// pal::char_t strings, does not apply.
+bool equals_ignore_case(const std::string& value, const char* word)
+{
+    size_t i = 0;
+    for (; i < value.length() && word[i] != '\0'; ++i)
+    {
+        if (std::tolower((unsigned char) value[i]) != std::tolower((unsigned char) word[i]))
+        {
+            return false;
+        }
+    }
+    return i == value.length() && word[i] == '\0';
+}
+
+// "true" or "false" for the spellings of a boolean, else empty.
+std::string to_boolean(const std::string& value)
+{
+    if (equals_ignore_case(value, "true") || (is_integer(value) && std::strtoull(value.c_str(), nullptr, 0) != 0))
+    {
+        return "true";
+    }
+    if (equals_ignore_case(value, "false") || is_integer(value))
+    {
+        return "false";
+    }
+    return std::string();
+}
+
+// Canonical value of "knob", or empty if "value" is not of its type.
+std::string to_knob_value(const knob_t& knob, const std::string& value)
+{
+    if (knob.type == knob_type_t::boolean)
+    {
+        return to_boolean(value);
+    }
+    return is_integer(value) ? value : std::string();
+}
+
+// -----------------------------------------------------------------------------
+// Single pass JSON reader over a buffer. Only strings that are asked for are
+// copied out; everything else is skipped in place.
+//
+class json_reader_t
+{
+public:
+    enum class kind_t
+    {
+        string,
+        number,
+        boolean,
+        null,
+        other
+    };
+
+    json_reader_t(const char* begin, const char* end)
+        : m_pos(begin)
+        , m_end(end)
+    {
+    }
+
+    bool at_end()
+    {
+        skip_whitespace();
+        return m_pos == m_end;
+    }
+
+    kind_t peek_kind()
+    {
+        skip_whitespace();
+        char c = (m_pos < m_end) ? *m_pos : '\0';
+        switch (c)
+        {
+        case '"': return kind_t::string;
+        case 't': case 'f': return kind_t::boolean;
+        case 'n': return kind_t::null;
+        case '-': return kind_t::number;
+        default: return (c >= '0' && c <= '9') ? kind_t::number : kind_t::other;
+        }
+    }
+
+    bool is_object()
+    {
+        skip_whitespace();
+        return m_pos < m_end && *m_pos == '{';
+    }
+
+    // Call "on_member(key)" for every member of the object at the current
+    // position; it must consume the member's value.
+    template <typename F>
+    bool read_object(F on_member)
+    {
+        if (!consume('{'))
+        {
+            return false;
+        }
+        if (consume('}'))
+        {
+            return true;
+        }
+        do
+        {
+            std::string key;
+            if (!read_string(&key) || !consume(':') || !on_member(key))
+            {
+                return false;
+            }
+        } while (consume(','));
+        return consume('}');
+    }
+
+    // Read a string, number, boolean or null; "value" gets the string's
+    // contents or the literal's text.
+    bool read_scalar(std::string* value)
+    {
+        if (peek_kind() == kind_t::string)
+        {
+            return read_string(value);
+        }
+        const char* start = m_pos;
+        while (m_pos < m_end && (std::isalnum((unsigned char) *m_pos) || *m_pos == '-' || *m_pos == '+' || *m_pos == '.'))
+        {
+            ++m_pos;
+        }
+        value->assign(start, m_pos);
+        return *value == "true" || *value == "false" || *value == "null" || is_number(*value);
+    }
+
+    bool skip_value(int depth = 0)
+    {
+        if (depth > 64)
+        {
+            return false;
+        }
+        skip_whitespace();
+        if (m_pos == m_end)
+        {
+            return false;
+        }
+        if (*m_pos == '{')
+        {
+            return read_object([&] (const std::string&) { return skip_value(depth + 1); });
+        }
+        if (*m_pos == '[')
+        {
+            ++m_pos;
+            if (consume(']'))
+            {
+                return true;
+            }
+            do
+            {
+                if (!skip_value(depth + 1))
+                {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(']');
+        }
+        if (*m_pos == '"')
+        {
+            return read_string(nullptr);
+        }
+        std::string literal;
+        return read_scalar(&literal);
+    }
+
+private:
+    void skip_whitespace()
+    {
+        while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\t' || *m_pos == '\n' || *m_pos == '\r'))
+        {
+            ++m_pos;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skip_whitespace();
+        if (m_pos < m_end && *m_pos == c)
+        {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    static bool is_number(const std::string& text)
+    {
+        size_t i = (!text.empty() && text[0] == '-') ? 1 : 0;
+        size_t digits = 0;
+        for (; i < text.length() && std::isdigit((unsigned char) text[i]); ++i, ++digits)
+        {
+        }
+        if (digits == 0)
+        {
+            return false;
+        }
+        if (i < text.length() && text[i] == '.')
+        {
+            for (digits = 0, ++i; i < text.length() && std::isdigit((unsigned char) text[i]); ++i, ++digits)
+            {
+            }
+            if (digits == 0)
+            {
+                return false;
+            }
+        }
+        if (i < text.length() && (text[i] == 'e' || text[i] == 'E'))
+        {
+            ++i;
+            if (i < text.length() && (text[i] == '+' || text[i] == '-'))
+            {
+                ++i;
+            }
+            for (digits = 0; i < text.length() && std::isdigit((unsigned char) text[i]); ++i, ++digits)
+            {
+            }
+            if (digits == 0)
+            {
+                return false;
+            }
+        }
+        return i == text.length();
+    }
+
+    bool read_hex4(unsigned* code)
+    {
+        if (m_end - m_pos < 4)
+        {
+            return false;
+        }
+        *code = 0;
+        for (int i = 0; i < 4; ++i, ++m_pos)
+        {
+            char c = *m_pos;
+            unsigned digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 16;
+            if (digit == 16)
+            {
+                return false;
+            }
+            *code = (*code << 4) | digit;
+        }
+        return true;
+    }
+
+    static void append_utf8(unsigned code, std::string* out)
+    {
+        if (code < 0x80)
+        {
+            out->push_back((char) code);
+        }
+        else if (code < 0x800)
+        {
+            out->push_back((char) (0xC0 | (code >> 6)));
+            out->push_back((char) (0x80 | (code & 0x3F)));
+        }
+        else if (code < 0x10000)
+        {
+            out->push_back((char) (0xE0 | (code >> 12)));
+            out->push_back((char) (0x80 | ((code >> 6) & 0x3F)));
+            out->push_back((char) (0x80 | (code & 0x3F)));
+        }
+        else
+        {
+            out->push_back((char) (0xF0 | (code >> 18)));
+            out->push_back((char) (0x80 | ((code >> 12) & 0x3F)));
+            out->push_back((char) (0x80 | ((code >> 6) & 0x3F)));
+            out->push_back((char) (0x80 | (code & 0x3F)));
+        }
+    }
+
+    // "out" may be null to skip the string.
+    bool read_string(std::string* out)
+    {
+        if (!consume('"'))
+        {
+            return false;
+        }
+        if (out != nullptr)
+        {
+            out->clear();
+        }
+        while (m_pos < m_end)
+        {
+            // Copy runs without escapes in one go.
+            const char* start = m_pos;
+            while (m_pos < m_end && *m_pos != '"' && *m_pos != '\\' && (unsigned char) *m_pos >= 0x20)
+            {
+                ++m_pos;
+            }
+            if (out != nullptr)
+            {
+                out->append(start, m_pos);
+            }
+            if (m_pos == m_end || (unsigned char) *m_pos < 0x20)
+            {
+                return false;
+            }
+            if (*m_pos++ == '"')
+            {
+                return true;
+            }
+
+            if (m_pos == m_end)
+            {
+                return false;
+            }
+            char c = *m_pos++;
+            unsigned code = 0;
+            switch (c)
+            {
+            case '"': case '\\': case '/': code = c; break;
+            case 'b': code = '\b'; break;
+            case 'f': code = '\f'; break;
+            case 'n': code = '\n'; break;
+            case 'r': code = '\r'; break;
+            case 't': code = '\t'; break;
+            case 'u':
+                if (!read_hex4(&code))
+                {
+                    return false;
+                }
+                if (code >= 0xD800 && code < 0xDC00)
+                {
+                    unsigned low;
+                    if (m_end - m_pos < 2 || m_pos[0] != '\\' || m_pos[1] != 'u')
+                    {
+                        return false;
+                    }
+                    m_pos += 2;
+                    if (!read_hex4(&low) || low < 0xDC00 || low >= 0xE000)
+                    {
+                        return false;
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                break;
+            default:
+                return false;
+            }
+            if (out != nullptr)
+            {
+                append_utf8(code, out);
+            }
+        }
+        return false;
+    }
+
+    const char* m_pos;
+    const char* m_end;
+};
+
+std::string to_mb(uint64_t bytes)
+{
+    return std::to_string(bytes >> 20) + " MB";
+}
+
+} // end of anonymous namespace
+
+void runtime_config_t::set(const std::string& name, const std::string& value)
+{
+    auto iter = m_index.find(name);
+    if (iter != m_index.end())
+    {
+        m_properties[iter->second].second = value;
+        return;
+    }
+    m_index.emplace(name, m_properties.size());
+    m_properties.emplace_back(name, value);
+}
+
+void runtime_config_t::clear()
+{
+    m_properties.clear();
+    m_index.clear();
+}
+
+bool runtime_config_t::load(const pal::string_t& path)
+{
+    clear();
+
+    auto file = pal::open_file(path);
+    if (!file)
+    {
+        trace::verbose(_X("No runtime config at %s"), path.c_str());
+        return true;
+    }
+    std::string json((std::istreambuf_iterator<char>(*file)), std::istreambuf_iterator<char>());
+
+    // Tolerate a UTF-8 byte order mark.
+    size_t start = (json.compare(0, 3, "\xEF\xBB\xBF") == 0) ? 3 : 0;
+    json_reader_t reader(json.data() + start, json.data() + json.length());
+
+    auto on_property = [&] (const std::string& name) {
+        json_reader_t::kind_t kind = reader.peek_kind();
+        if (kind == json_reader_t::kind_t::other)
+        {
+            trace::warning(_X("Ignoring runtime config property %s that is not a string, number or boolean"), pal::to_palstring(name).c_str());
+            return reader.skip_value();
+        }
+
+        std::string value;
+        if (!reader.read_scalar(&value))
+        {
+            return false;
+        }
+        if (kind == json_reader_t::kind_t::null)
+        {
+            return true;
+        }
+
+        const knob_t* knob = find_knob(name);
+        if (knob != nullptr)
+        {
+            // Integer knobs only take decimal numbers, or strings for hex.
+            bool typed = (knob->type == knob_type_t::boolean) ? kind != json_reader_t::kind_t::number : kind != json_reader_t::kind_t::boolean;
+            std::string knob_value = typed ? to_knob_value(*knob, value) : std::string();
+            if (knob_value.empty())
+            {
+                trace::warning(_X("Ignoring runtime config property %s with invalid value %s"),
+                    pal::to_palstring(name).c_str(), pal::to_palstring(value).c_str());
+                return true;
+            }
+            value = knob_value;
+        }
+        set(name, value);
+        return true;
+    };
+    auto on_options = [&] (const std::string& key) {
+        return (key == "configProperties" && reader.is_object()) ? reader.read_object(on_property) : reader.skip_value();
+    };
+    auto on_root = [&] (const std::string& key) {
+        return (key == "runtimeOptions" && reader.is_object()) ? reader.read_object(on_options) : reader.skip_value();
+    };
+
+    if (!reader.read_object(on_root) || !reader.at_end())
+    {
+        trace::error(_X("Invalid runtime config %s"), path.c_str());
+        clear();
+        return false;
+    }
+    trace::verbose(_X("Read %d properties from runtime config %s"), (int) m_properties.size(), path.c_str());
+    return true;
+}
+
+void runtime_config_t::apply_overrides(const properties_t& overrides)
+{
+    for (const auto& property : overrides)
+    {
+        set(property.first, property.second);
+    }
+}
+
+void runtime_config_t::apply_resource_defaults(const pal::resource_limits_t& limits)
+{
+    std::string value;
+    std::vector<std::string> decisions;
+    auto is_set = [&] (const char* name) { return get(name, &value); };
+
+    // The runtime sizes itself by the CPUs it can be scheduled on, but does
+    // not know about a CPU quota: round that up to whole CPUs.
+    unsigned cpus = limits.affinity_cpus != 0 ? limits.affinity_cpus : limits.online_cpus;
+    unsigned usable = cpus;
+    if (limits.quota_cpus > 0)
+    {
+        usable = std::min(cpus, std::max(1u, (unsigned) std::ceil(limits.quota_cpus)));
+    }
+    bool quota_limited = usable < cpus;
+
+    // Server GC only pays off with more than one CPU to run heaps on.
+    bool server;
+    if (get("System.GC.Server", &value))
+    {
+        server = value == "true";
+        decisions.push_back(server ? "server GC (configured)" : "workstation GC (configured)");
+    }
+    else
+    {
+        server = usable > 1;
+        set("System.GC.Server", server ? "true" : "false");
+        decisions.push_back(server ? "server GC" : "workstation GC");
+    }
+
+    if (server)
+    {
+        // A heap per usable CPU, free to run on any CPU of the set since the
+        // quota does not say which.
+        if (quota_limited && !is_set("System.GC.HeapCount"))
+        {
+            set("System.GC.HeapCount", std::to_string(usable));
+            decisions.push_back(std::to_string(usable) + " heaps");
+        }
+        bool affinity_set = is_set("System.GC.HeapAffinitizeMask") || is_set("System.GC.NoAffinitize");
+        if (quota_limited && !affinity_set)
+        {
+            set("System.GC.NoAffinitize", "true");
+            decisions.push_back("heaps not affinitized");
+        }
+        else if (!quota_limited && !affinity_set && cpus < limits.online_cpus && limits.online_cpus <= 64 &&
+            limits.affinity_mask != 0)
+        {
+            char mask[32];
+            std::snprintf(mask, sizeof(mask), "0x%llx", (unsigned long long) limits.affinity_mask);
+            set("System.GC.HeapAffinitizeMask", mask);
+            decisions.push_back(std::string("heaps affinitized to ") + mask);
+        }
+    }
+
+    // Leave a quarter of the container's memory to everything but the GC heap.
+    if (limits.memory_limit != 0 && !is_set("System.GC.HeapHardLimit") && !is_set("System.GC.HeapHardLimitPercent"))
+    {
+        uint64_t limit = std::max<uint64_t>(limits.memory_limit / 4 * 3, 20 << 20);
+        set("System.GC.HeapHardLimit", std::to_string(limit));
+        decisions.push_back("heap hard limit " + to_mb(limit));
+    }
+
+    // The thread pool would otherwise keep a thread per CPU of the machine
+    // ready.
+    if (quota_limited && !is_set("System.Threading.ThreadPool.MinThreads"))
+    {
+        set("System.Threading.ThreadPool.MinThreads", std::to_string(usable));
+        decisions.push_back("thread pool min threads " + std::to_string(usable));
+    }
+
+    std::string quota = "none";
+    if (limits.quota_cpus > 0)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.2f CPUs", limits.quota_cpus);
+        quota = buffer;
+    }
+    std::string summary;
+    for (const auto& decision : decisions)
+    {
+        summary.append(summary.empty() ? "" : ", ").append(decision);
+    }
+    trace::info(_X("Resources: %u CPUs online, %u in affinity and cpuset, quota %s, memory limit %s of %s; using %s"),
+        limits.online_cpus, cpus, quota.c_str(),
+        limits.memory_limit != 0 ? to_mb(limits.memory_limit).c_str() : "none",
+        to_mb(limits.physical_memory).c_str(), summary.c_str());
+}
+
+bool runtime_config_t::is_host_property(const std::string& name)
+{
+    return name.compare(0, 15, "Microsoft.Host.") == 0;
+}
+
+uint64_t runtime_config_t::get_integer(const char* name, uint64_t default_value) const
+{
+    std::string value;
+    return (get(name, &value) && is_integer(value)) ? std::strtoull(value.c_str(), nullptr, 0) : default_value;
+}
+
+bool runtime_config_t::get(const char* name, std::string* value) const
+{
+    auto iter = m_index.find(name);
+    if (iter == m_index.end())
+    {
+        return false;
+    }
+    value->assign(m_properties[iter->second].second);
+    return true;
+}
+
+// Names and values, each followed by a NUL.
+std::string runtime_config_t::serialize() const
+{
+    std::string data;
+    for (const auto& property : m_properties)
+    {
+        data.append(property.first).push_back('\0');
+        data.append(property.second).push_back('\0');
+    }
+    return data;
+}
+
+bool runtime_config_t::deserialize(const std::string& data)
+{
+    clear();
+    size_t pos = 0;
+    while (pos < data.length())
+    {
+        size_t name_end = data.find('\0', pos);
+        size_t value_end = (name_end == std::string::npos) ? std::string::npos : data.find('\0', name_end + 1);
+        if (value_end == std::string::npos)
+        {
+            clear();
+            return false;
+        }
+        set(data.substr(pos, name_end - pos), data.substr(name_end + 1, value_end - name_end - 1));
+        pos = value_end + 1;
+    }
+    return true;
+}
+
+void read_runtime_config_overrides(const host_context_t* context, runtime_config_t::properties_t* overrides)
+{
+    for (const auto& knob : KNOBS)
+    {
+        pal::string_t env_value;
+        if (!host_context_getenv(context, knob.env, &env_value))
+        {
+            continue;
+        }
+        std::string value = to_knob_value(knob, pal::to_stdstring(env_value));
+        if (value.empty())
+        {
+            trace::warning(_X("Ignoring %s with invalid value %s"), knob.env, env_value.c_str());
+            continue;
+        }
+        overrides->emplace_back(knob.name, value);
+    }
+}
+
+pal::string_t get_default_runtime_config_path(const pal::string_t& app_base, const pal::string_t& managed_application)
+{
+    auto app_name = get_filename(managed_application);
+
+    pal::string_t config_path = app_base;
+    config_path.push_back(DIR_SEPARATOR);
+    config_path.append(app_name, 0, app_name.find_last_of(_X(".")));
+    config_path.append(_X(".runtimeconfig.json"));
+    return config_path;
+}
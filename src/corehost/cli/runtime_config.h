@@ -0,0 +1,74 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef RUNTIME_CONFIG_H
+#define RUNTIME_CONFIG_H
+
+#include <unordered_map>
+
+#include "pal.h"
+#include "libhost.h"
+
+// -----------------------------------------------------------------------------
+// Runtime knobs of an app, read from "<app>.runtimeconfig.json" next to it:
+//
+//    {
+//        "runtimeOptions": {
+//            "configProperties": {
+//                "System.GC.Server": true,
+//                "System.GC.HeapCount": 4
+//            }
+//        }
+//    }
+//
+// Every config property is passed to CoreCLR as a property of the same name,
+// except for the "Microsoft.Host." ones, which are for the host itself. The
+// GC, thread pool and host knobs the host knows about are type checked and can
+// be overridden from the environment (see runtime_config.cpp).
+//
+class runtime_config_t
+{
+public:
+    typedef std::vector<std::pair<std::string, std::string>> properties_t;
+
+    // Read "path". A missing file is an empty configuration; a malformed one
+    // is traced and returns false.
+    bool load(const pal::string_t& path);
+
+    // Set every (knob, value) of "overrides", as read_runtime_config_overrides
+    // produced them.
+    void apply_overrides(const properties_t& overrides);
+
+    // Fill in the GC and thread pool knobs that are not set from what the
+    // process may use: server or workstation GC, heap count and affinity,
+    // heap hard limit and the thread pool minimum. Traces why.
+    void apply_resource_defaults(const pal::resource_limits_t& limits);
+
+    // Value of property "name", if it was set.
+    bool get(const char* name, std::string* value) const;
+    uint64_t get_integer(const char* name, uint64_t default_value) const;
+
+    // Whether "name" configures the host rather than CoreCLR.
+    static bool is_host_property(const std::string& name);
+
+    const properties_t& properties() const { return m_properties; }
+
+    // Flat form of the properties, for the resolution cache.
+    std::string serialize() const;
+    bool deserialize(const std::string& data);
+
+private:
+    void set(const std::string& name, const std::string& value);
+    void clear();
+
+    // In the order they were first set, and by name.
+    properties_t m_properties;
+    std::unordered_map<std::string, size_t> m_index;
+};
+
+// The knob overrides set in the environment.
+void read_runtime_config_overrides(const host_context_t* context, runtime_config_t::properties_t* overrides);
+
+pal::string_t get_default_runtime_config_path(const pal::string_t& app_base, const pal::string_t& managed_application);
+
+#endif // RUNTIME_CONFIG_H
@@ -60,15 +60,15 @@ void servicing_index_t::ensure_redirections()
         return;
     }
 
-    pal::ifstream_t fstream(m_index_file);
-    if (!fstream.good())
+    auto fstream = pal::open_file(m_index_file);
+    if (!fstream)
     {
         return;
     }
 
     pal::stringstream_t sstream;
     std::string line;
-    while (std::getline(fstream, line))
+    while (std::getline(*fstream, line))
     {
         pal::string_t str;
         pal::to_palstring(line.c_str(), &str);
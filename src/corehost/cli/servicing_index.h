@@ -1,6 +1,9 @@
 // Copyright (c) .NET Foundation and contributors. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#ifndef SERVICING_INDEX_H
+#define SERVICING_INDEX_H
+
 #include "utils.h"
 #include "args.h"
 
@@ -22,3 +25,5 @@ private:
     pal::string_t m_index_file;
     bool m_parsed;
 };
+
+#endif // SERVICING_INDEX_H
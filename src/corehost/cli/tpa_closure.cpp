@@ -0,0 +1,293 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <functional>
+
+#include "trace.h"
+#include "assembly_refs.h"
+#include "tpa_closure.h"
+
+namespace
+{
+// Bump when the file format, or what goes into the closure, changes.
+const pal::char_t* CLOSURE_VERSION = _X("1");
+
+// Loaded by the runtime itself, whether referenced or not.
+const pal::char_t* CORE_LIBRARIES[] = { _X("mscorlib"), _X("System.Private.CoreLib") };
+
+// "<device>,<inode>,<size>,<mtime>" of "path", or empty if it cannot be read.
+pal::string_t format_identity(const pal::string_t& path)
+{
+    pal::file_identity_t identity;
+    if (!pal::get_file_identity(path, &identity))
+    {
+        return pal::string_t();
+    }
+    pal::stringstream_t stream;
+    stream << identity.device << _X(',') << identity.inode << _X(',') << identity.size << _X(',') << identity.mtime_ns;
+    return stream.str();
+}
+
+// -----------------------------------------------------------------------------
+// Add the TPA assemblies "entry_assembly" and the core libraries reach to
+// "closure", and every file whose references were read to "scanned".
+//
+// Returns:
+//    False if the references of one of them could not be read.
+//
+bool find_closure(
+    const pal::string_t& entry_assembly,
+    const std::vector<pal::string_t>& tpa,
+    std::vector<pal::string_t>* scanned,
+    std::unordered_set<pal::string_t>* closure)
+{
+    std::unordered_map<pal::string_t, const pal::string_t*> by_name;
+    for (const auto& path : tpa)
+    {
+        by_name.emplace(get_assembly_name(path), &path);
+    }
+
+    std::vector<pal::string_t> pending;
+    auto reach = [&] (const pal::string_t& name) {
+        auto iter = by_name.find(name);
+        if (iter != by_name.end() && closure->insert(*iter->second).second)
+        {
+            pending.push_back(*iter->second);
+        }
+    };
+
+    for (const pal::char_t* name : CORE_LIBRARIES)
+    {
+        reach(name);
+    }
+    // The entry assembly is usually app local, and so in the TPA too.
+    pal::string_t entry_name = get_assembly_name(entry_assembly);
+    if (by_name.count(entry_name))
+    {
+        reach(entry_name);
+    }
+    else
+    {
+        pending.push_back(entry_assembly);
+    }
+
+    std::vector<pal::string_t> refs;
+    while (!pending.empty())
+    {
+        pal::string_t path = std::move(pending.back());
+        pending.pop_back();
+        if (!read_assembly_refs(path, &refs))
+        {
+            trace::info(_X("Not trimming the TPA, the references of %s could not be read"), path.c_str());
+            return false;
+        }
+        scanned->push_back(path);
+        for (const auto& name : refs)
+        {
+            reach(name);
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// Add to "kept" the TPA assemblies left out of it that probing would not find
+// again: probing looks in "app_dir" and then in the dirs of the others left
+// out, in TPA order, and takes the first file of the simple name it looks
+// for, by the same order of extensions as app local assemblies.
+//
+void keep_shadowed(const pal::string_t& app_dir, const std::vector<pal::string_t>& tpa, std::unordered_set<pal::string_t>* kept)
+{
+    std::vector<pal::string_t> dirs;
+    std::unordered_set<pal::string_t> seen;
+    dirs.push_back(app_dir);
+    seen.insert(app_dir);
+    for (const auto& path : tpa)
+    {
+        pal::string_t dir = get_directory(path);
+        if (!kept->count(path) && seen.insert(dir).second)
+        {
+            dirs.push_back(dir);
+        }
+    }
+
+    const pal::string_t managed_ext[] = { _X(".ni.dll"), _X(".dll"), _X(".ni.exe"), _X(".exe") };
+    std::unordered_map<pal::string_t, pal::string_t> found;
+    std::vector<pal::string_t> files;
+    for (const auto& dir : dirs)
+    {
+        files.clear();
+        pal::readdir(dir, &files);
+        for (const auto& ext : managed_ext)
+        {
+            for (const auto& file : files)
+            {
+                if (file.length() > ext.length() &&
+                    pal::strcasecmp(file.c_str() + file.length() - ext.length(), ext.c_str()) == 0)
+                {
+                    found.emplace(file.substr(0, file.length() - ext.length()), dir + DIR_SEPARATOR + file);
+                }
+            }
+        }
+    }
+
+    for (const auto& path : tpa)
+    {
+        if (kept->count(path))
+        {
+            continue;
+        }
+        auto iter = found.find(get_assembly_name(path));
+        if (iter == found.end() || iter->second != path)
+        {
+            trace::verbose(_X("Keeping %s in the TPA, probing would not find it first"), path.c_str());
+            kept->insert(path);
+        }
+    }
+}
+} // end of anonymous namespace
+
+tpa_closure_t::tpa_closure_t(const pal::string_t& deps_path)
+{
+    m_cache_path = get_deps_sibling_path(deps_path, _X(".tpa_closure"));
+}
+
+void tpa_closure_t::trim(const pal::string_t& entry_assembly, const pal::string_t& app_dir, probe_paths_t* probe_paths)
+{
+    std::vector<pal::string_t> tpa;
+    split(probe_paths->tpa, PATH_SEPARATOR, &tpa);
+
+    // TPA entries are real paths, compare dirs with the real app dir.
+    pal::string_t real_app_dir = app_dir;
+    pal::realpath(&real_app_dir);
+
+    pal::stringstream_t key_stream;
+    key_stream << CLOSURE_VERSION << _X('-') << std::hex
+        << std::hash<pal::string_t>()(entry_assembly + PATH_SEPARATOR + real_app_dir + PATH_SEPARATOR + probe_paths->tpa);
+    pal::string_t key = key_stream.str();
+
+    std::unordered_set<pal::string_t> kept;
+    if (!load(key, &kept))
+    {
+        kept.clear();
+        std::vector<pal::string_t> scanned;
+        if (!find_closure(entry_assembly, tpa, &scanned, &kept))
+        {
+            return;
+        }
+        keep_shadowed(real_app_dir, tpa, &kept);
+
+        std::vector<pal::string_t> kept_list;
+        for (const auto& path : tpa)
+        {
+            if (kept.count(path))
+            {
+                kept_list.push_back(path);
+            }
+        }
+        save(key, scanned, kept_list);
+    }
+
+    pal::string_t trimmed;
+    std::unordered_set<pal::string_t> dirs;
+    dirs.insert(real_app_dir);
+    size_t left_out = 0;
+    for (const auto& path : tpa)
+    {
+        if (kept.count(path))
+        {
+            trimmed.append(path);
+            trimmed.push_back(PATH_SEPARATOR);
+            continue;
+        }
+        left_out++;
+        pal::string_t dir = get_directory(path);
+        if (dirs.insert(dir).second)
+        {
+            probe_paths->app.append(dir);
+            probe_paths->app.push_back(PATH_SEPARATOR);
+        }
+    }
+    probe_paths->tpa.swap(trimmed);
+    trace::info(_X("Trimmed the TPA to %d of %d assemblies, the rest are probed for in %d more dirs"),
+        (int) (tpa.size() - left_out), (int) tpa.size(), (int) dirs.size() - 1);
+}
+
+bool tpa_closure_t::load(const pal::string_t& key, std::unordered_set<pal::string_t>* kept)
+{
+    auto file = pal::open_file(m_cache_path);
+    if (!file)
+    {
+        trace::verbose(_X("No TPA closure at %s"), m_cache_path.c_str());
+        return false;
+    }
+
+    // "key=" comes first, then "scanned=<identity>|<path>" for the files the
+    // closure was read from and "kept=<path>" for the TPA entries to keep.
+    const pal::string_t key_prefix = _X("key=");
+    const pal::string_t scanned_prefix = _X("scanned=");
+    const pal::string_t kept_prefix = _X("kept=");
+    bool key_matches = false;
+    std::string line;
+    pal::string_t str;
+    while (std::getline(*file, line))
+    {
+        pal::to_palstring(line.c_str(), &str);
+        if (starts_with(str, key_prefix))
+        {
+            key_matches = str.compare(key_prefix.length(), pal::string_t::npos, key) == 0;
+        }
+        if (!key_matches)
+        {
+            trace::verbose(_X("TPA closure %s is for another TPA"), m_cache_path.c_str());
+            return false;
+        }
+
+        if (starts_with(str, scanned_prefix))
+        {
+            size_t separator = str.find(_X('|'), scanned_prefix.length());
+            if (separator == pal::string_t::npos)
+            {
+                return false;
+            }
+            pal::string_t path = str.substr(separator + 1);
+            if (str.compare(scanned_prefix.length(), separator - scanned_prefix.length(), format_identity(path)) != 0)
+            {
+                trace::verbose(_X("TPA closure %s is stale, %s changed"), m_cache_path.c_str(), path.c_str());
+                return false;
+            }
+        }
+        else if (starts_with(str, kept_prefix))
+        {
+            kept->insert(str.substr(kept_prefix.length()));
+        }
+    }
+
+    trace::verbose(_X("Using TPA closure %s of %d assemblies"), m_cache_path.c_str(), (int) kept->size());
+    return key_matches;
+}
+
+void tpa_closure_t::save(const pal::string_t& key, const std::vector<pal::string_t>& scanned, const std::vector<pal::string_t>& kept)
+{
+    std::string contents = "key=" + pal::to_stdstring(key) + "\n";
+    for (const auto& path : scanned)
+    {
+        pal::string_t identity = format_identity(path);
+        if (identity.empty())
+        {
+            return;
+        }
+        contents += "scanned=" + pal::to_stdstring(identity) + "|" + pal::to_stdstring(path) + "\n";
+    }
+    for (const auto& path : kept)
+    {
+        contents += "kept=" + pal::to_stdstring(path) + "\n";
+    }
+
+    if (!write_file_atomically(m_cache_path, contents))
+    {
+        trace::verbose(_X("Could not write TPA closure %s"), m_cache_path.c_str());
+        return;
+    }
+    trace::verbose(_X("Recorded the closure of %d assemblies in %s"), (int) scanned.size(), m_cache_path.c_str());
+}
@@ -0,0 +1,42 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef TPA_CLOSURE_H
+#define TPA_CLOSURE_H
+
+#include <unordered_set>
+
+#include "utils.h"
+#include "deps_resolver.h"
+
+// -----------------------------------------------------------------------------
+// The TPA assemblies an app can reach: its entry assembly, the core library
+// and, transitively, every TPA assembly their AssemblyRef tables name. The
+// rest can be left out of the TPA for the runtime to find through APP_PATHS,
+// which only costs it a probe if one of them is loaded after all, by
+// reflection for example.
+//
+// Computing the closure reads the metadata of every reachable assembly. It is
+// kept next to the deps file, as <app>.tpa_closure, along with the identities
+// of the files read, and reused while the TPA, the app dir and those files do
+// not change.
+//
+class tpa_closure_t
+{
+public:
+    tpa_closure_t(const pal::string_t& deps_path);
+
+    // Move the assemblies of "probe_paths->tpa" that "entry_assembly" does not
+    // reach out of it, adding their dirs to "probe_paths->app". Assemblies
+    // that probing "app_dir" and then those dirs would not find first stay in
+    // the TPA, and so does everything if the closure cannot be read.
+    void trim(const pal::string_t& entry_assembly, const pal::string_t& app_dir, probe_paths_t* probe_paths);
+
+private:
+    bool load(const pal::string_t& key, std::unordered_set<pal::string_t>* kept);
+    void save(const pal::string_t& key, const std::vector<pal::string_t>& scanned, const std::vector<pal::string_t>& kept);
+
+    pal::string_t m_cache_path;
+};
+
+#endif // TPA_CLOSURE_H
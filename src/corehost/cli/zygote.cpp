@@ -0,0 +1,590 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "trace.h"
+#include "utils.h"
+#include "zygote.h"
+
+#if !defined(_WIN32)
+
+#include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace
+{
+const uint32_t ZYGOTE_MAGIC = 0x475a4843; // "CHZG"
+const uint32_t ZYGOTE_PROTOCOL_VERSION = 1;
+
+// Bounds on what one request may carry, so that a confused peer cannot make
+// the server allocate without limit.
+const uint32_t ZYGOTE_MAX_STRING = 1024 * 1024;
+const uint32_t ZYGOTE_MAX_COUNT = 64 * 1024;
+
+// stdin, stdout and stderr.
+const size_t ZYGOTE_FD_COUNT = 3;
+
+// How long either side waits on a request or its first reply.
+const int ZYGOTE_TIMEOUT_MS = 2000;
+
+enum reply_status_t : uint32_t
+{
+    reply_started = 0,
+    reply_refused = 1,
+};
+
+// Variables that steer how the host resolves and starts the app: a request
+// must agree with the server on all of them. The launcher's own are exempt.
+// The locale picks the UI cultures under COREHOST_UI_CULTURES=1, and HOME
+// the default packages dir.
+const char* const HOST_ENV_PREFIXES[] = { "DOTNET_", "NUGET_", "COREHOST_" };
+const char* const HOST_ENV_NAMES[] = { "HOME", "LANG", "LC_ALL", "LC_MESSAGES" };
+const char* const LAUNCHER_ENV_PREFIX = "COREHOST_ZYGOTE";
+
+struct request_t
+{
+    pal::string_t app;
+    pal::string_t cwd;
+    std::vector<pal::string_t> argv;
+    std::vector<pal::string_t> env;
+    std::vector<intptr_t> fds;
+
+    ~request_t()
+    {
+        for (intptr_t fd : fds)
+        {
+            ::close((int) fd);
+        }
+    }
+};
+
+// Identity of a file: replacing or modifying it changes the stamp.
+struct stamp_t
+{
+    bool exists;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    struct timespec ctime;
+
+    static stamp_t of(const pal::string_t& path)
+    {
+        struct stat st;
+        stamp_t s;
+        std::memset(&s, 0, sizeof(s));
+        s.exists = ::stat(path.c_str(), &st) == 0;
+        if (s.exists)
+        {
+            s.dev = st.st_dev;
+            s.ino = st.st_ino;
+            s.size = st.st_size;
+#if defined(__APPLE__)
+            s.mtime = st.st_mtimespec;
+            s.ctime = st.st_ctimespec;
+#else
+            s.mtime = st.st_mtim;
+            s.ctime = st.st_ctim;
+#endif
+        }
+        return s;
+    }
+
+    bool operator==(const stamp_t& other) const
+    {
+        return exists == other.exists && dev == other.dev && ino == other.ino && size == other.size &&
+            mtime.tv_sec == other.mtime.tv_sec && mtime.tv_nsec == other.mtime.tv_nsec &&
+            ctime.tv_sec == other.ctime.tv_sec && ctime.tv_nsec == other.ctime.tv_nsec;
+    }
+};
+
+volatile sig_atomic_t g_stop = 0;
+int g_child_pipe = -1;
+
+void on_stop_signal(int)
+{
+    g_stop = 1;
+}
+
+void on_child_signal(int)
+{
+    int saved = errno;
+    char c = 0;
+    if (::write(g_child_pipe, &c, 1) < 0)
+    {
+        // Full: the server will reap every child anyway.
+    }
+    errno = saved;
+}
+
+bool send_u32(intptr_t socket, uint32_t value)
+{
+    return pal::local_socket_send(socket, &value, sizeof(value));
+}
+
+bool recv_u32(intptr_t socket, uint32_t* value)
+{
+    return pal::local_socket_recv(socket, value, sizeof(*value));
+}
+
+bool send_string(intptr_t socket, const pal::string_t& str)
+{
+    uint32_t bytes = (uint32_t) (str.length() * sizeof(pal::char_t));
+    return send_u32(socket, bytes) && (bytes == 0 || pal::local_socket_send(socket, str.data(), bytes));
+}
+
+bool recv_string(intptr_t socket, pal::string_t* str)
+{
+    uint32_t bytes;
+    if (!recv_u32(socket, &bytes) || bytes > ZYGOTE_MAX_STRING || bytes % sizeof(pal::char_t) != 0)
+    {
+        return false;
+    }
+    str->resize(bytes / sizeof(pal::char_t));
+    return bytes == 0 || pal::local_socket_recv(socket, &(*str)[0], bytes);
+}
+
+bool send_strings(intptr_t socket, const std::vector<pal::string_t>& strs)
+{
+    if (!send_u32(socket, (uint32_t) strs.size()))
+    {
+        return false;
+    }
+    for (const auto& str : strs)
+    {
+        if (!send_string(socket, str))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool recv_strings(intptr_t socket, std::vector<pal::string_t>* strs)
+{
+    uint32_t count;
+    if (!recv_u32(socket, &count) || count > ZYGOTE_MAX_COUNT)
+    {
+        return false;
+    }
+    strs->resize(count);
+    for (auto& str : *strs)
+    {
+        if (!recv_string(socket, &str))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool send_reply(intptr_t socket, reply_status_t status, uint32_t pid)
+{
+    return send_u32(socket, ZYGOTE_MAGIC) && send_u32(socket, ZYGOTE_PROTOCOL_VERSION) &&
+        send_u32(socket, status) && send_u32(socket, pid);
+}
+
+bool read_request(intptr_t socket, request_t* request)
+{
+    uint32_t header[2];
+    if (!pal::local_socket_recv_fds(socket, header, sizeof(header), &request->fds) ||
+        header[0] != ZYGOTE_MAGIC || header[1] != ZYGOTE_PROTOCOL_VERSION ||
+        request->fds.size() != ZYGOTE_FD_COUNT)
+    {
+        return false;
+    }
+    return recv_string(socket, &request->app) &&
+        recv_string(socket, &request->cwd) &&
+        recv_strings(socket, &request->argv) &&
+        recv_strings(socket, &request->env);
+}
+
+// The sorted "NAME=value" entries of "env" that steer the host.
+std::vector<pal::string_t> host_env(const std::vector<pal::string_t>& env)
+{
+    std::vector<pal::string_t> result;
+    for (const auto& var : env)
+    {
+        if (starts_with(var, LAUNCHER_ENV_PREFIX))
+        {
+            continue;
+        }
+        bool steers = false;
+        for (const char* prefix : HOST_ENV_PREFIXES)
+        {
+            steers = steers || starts_with(var, prefix);
+        }
+        for (const char* name : HOST_ENV_NAMES)
+        {
+            steers = steers || starts_with(var, pal::string_t(name) + _X('='));
+        }
+        if (steers)
+        {
+            result.push_back(var);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<pal::string_t> current_env()
+{
+    std::vector<pal::string_t> env;
+    for (char** var = environ; *var != nullptr; ++var)
+    {
+        env.push_back(*var);
+    }
+    return env;
+}
+
+uint32_t to_exit_code(int status)
+{
+    if (WIFEXITED(status))
+    {
+        return WEXITSTATUS(status);
+    }
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : 1;
+}
+
+class server_t
+{
+public:
+    server_t(const zygote_config_t& config)
+        : m_config(config)
+        , m_listener(-1)
+        , m_env(host_env(current_env()))
+    {
+        for (const auto& file : config.files)
+        {
+            m_stamps.push_back(stamp_t::of(file));
+        }
+    }
+
+    int run()
+    {
+        int pipe_fds[2];
+        if (::pipe(pipe_fds) != 0)
+        {
+            trace::error(_X("Failed to create the fork server's pipe: %s"), std::strerror(errno));
+            return 1;
+        }
+        for (int fd : pipe_fds)
+        {
+            ::fcntl(fd, F_SETFL, O_NONBLOCK);
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+        g_child_pipe = pipe_fds[1];
+
+        if (!pal::local_socket_listen(m_config.socket_path, &m_listener))
+        {
+            return 1;
+        }
+
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = on_stop_signal;
+        ::sigaction(SIGINT, &action, nullptr);
+        ::sigaction(SIGTERM, &action, nullptr);
+        action.sa_handler = on_child_signal;
+        action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+        ::sigaction(SIGCHLD, &action, nullptr);
+        ::signal(SIGPIPE, SIG_IGN);
+
+        trace::info(_X("Fork server for %s listening on %s"), m_config.managed_application.c_str(), m_config.socket_path.c_str());
+        trace::flush();
+
+        while (!g_stop)
+        {
+            struct pollfd fds[2] = { { (int) m_listener, POLLIN, 0 }, { pipe_fds[0], POLLIN, 0 } };
+            if (::poll(fds, 2, -1) < 0)
+            {
+                continue;
+            }
+            if (fds[1].revents & POLLIN)
+            {
+                char drain[64];
+                while (::read(pipe_fds[0], drain, sizeof(drain)) > 0)
+                {
+                }
+                reap(WNOHANG);
+            }
+            if (fds[0].revents & POLLIN)
+            {
+                intptr_t client;
+                if (pal::local_socket_accept(m_listener, ZYGOTE_TIMEOUT_MS, &client))
+                {
+                    serve(client);
+                }
+            }
+            trace::flush();
+        }
+
+        // Stop taking requests, then see the running ones through.
+        pal::local_socket_close(m_listener);
+        ::unlink(m_config.socket_path.c_str());
+        reap(0);
+
+        ::signal(SIGCHLD, SIG_DFL);
+        ::close(pipe_fds[0]);
+        ::close(pipe_fds[1]);
+        return 0;
+    }
+
+private:
+    bool is_current()
+    {
+        for (size_t i = 0; i < m_config.files.size(); ++i)
+        {
+            if (!(stamp_t::of(m_config.files[i]) == m_stamps[i]))
+            {
+                trace::info(_X("%s changed since the fork server started"), m_config.files[i].c_str());
+                return false;
+            }
+        }
+        if (m_config.validate && !m_config.validate())
+        {
+            trace::info(_X("The app's dependencies changed since the fork server started"));
+            return false;
+        }
+        return true;
+    }
+
+    void serve(intptr_t client)
+    {
+        request_t request;
+        if (!read_request(client, &request))
+        {
+            trace::warning(_X("Ignoring a malformed fork server request"));
+            pal::local_socket_close(client);
+            return;
+        }
+
+        bool refuse = false;
+        if (request.app != m_config.managed_application)
+        {
+            trace::info(_X("Refusing to run %s, this server runs %s"), request.app.c_str(), m_config.managed_application.c_str());
+            refuse = true;
+        }
+        else if (host_env(request.env) != m_env)
+        {
+            trace::info(_X("Refusing a launch with a different host environment"));
+            refuse = true;
+        }
+        else if (!is_current())
+        {
+            // Every later request would be refused too: make way for a new server.
+            refuse = true;
+            g_stop = 1;
+        }
+        if (refuse)
+        {
+            send_reply(client, reply_refused, 0);
+            pal::local_socket_close(client);
+            return;
+        }
+
+        pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            run_child(client, &request);
+        }
+        if (pid < 0)
+        {
+            trace::error(_X("Failed to fork: %s"), std::strerror(errno));
+            send_reply(client, reply_refused, 0);
+            pal::local_socket_close(client);
+            return;
+        }
+
+        if (!send_reply(client, reply_started, (uint32_t) pid))
+        {
+            // The launcher is gone; the app runs on with nobody to report to.
+            pal::local_socket_close(client);
+            return;
+        }
+        pal::local_socket_set_timeout(client, 0);
+        m_children[pid] = client;
+        trace::verbose(_X("Started %s as pid %d"), request.app.c_str(), (int) pid);
+    }
+
+    // In the forked child: become the launched process, run the app and exit.
+    void run_child(intptr_t client, request_t* request)
+    {
+        ::signal(SIGCHLD, SIG_DFL);
+        ::signal(SIGPIPE, SIG_DFL);
+        ::signal(SIGINT, SIG_DFL);
+        ::signal(SIGTERM, SIG_DFL);
+
+        pal::local_socket_close(client);
+        pal::local_socket_close(m_listener);
+        for (const auto& child : m_children)
+        {
+            pal::local_socket_close(child.second);
+        }
+
+        // Signals from the launcher's terminal are forwarded by the launcher.
+        ::setsid();
+
+        for (size_t i = 0; i < ZYGOTE_FD_COUNT; ++i)
+        {
+            ::dup2((int) request->fds[i], (int) i);
+        }
+        for (intptr_t fd : request->fds)
+        {
+            if (fd >= (intptr_t) ZYGOTE_FD_COUNT)
+            {
+                ::close((int) fd);
+            }
+        }
+        request->fds.clear();
+
+        if (::chdir(request->cwd.c_str()) != 0)
+        {
+            trace::error(_X("Failed to change to %s: %s"), request->cwd.c_str(), std::strerror(errno));
+            trace::flush();
+            ::_exit(1);
+        }
+
+        // The request outlives the app: putenv() keeps pointers into it.
+        ::clearenv();
+        for (auto& var : request->env)
+        {
+            ::putenv(&var[0]);
+        }
+
+        std::vector<const pal::char_t*> argv;
+        for (const auto& arg : request->argv)
+        {
+            argv.push_back(arg.c_str());
+        }
+        int code = m_config.run((int) argv.size(), argv.data());
+
+        std::fflush(nullptr);
+        trace::flush();
+        ::_exit(code);
+    }
+
+    // Report the exit of every finished child, waiting for all of them
+    // unless "options" is WNOHANG.
+    void reap(int options)
+    {
+        while (!m_children.empty())
+        {
+            int status = 0;
+            pid_t pid = ::waitpid(-1, &status, options);
+            if (pid < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (pid <= 0)
+            {
+                return;
+            }
+            auto iter = m_children.find(pid);
+            if (iter != m_children.end())
+            {
+                send_u32(iter->second, to_exit_code(status));
+                pal::local_socket_close(iter->second);
+                m_children.erase(iter);
+            }
+        }
+    }
+
+    const zygote_config_t& m_config;
+    intptr_t m_listener;
+    std::vector<pal::string_t> m_env;
+    std::vector<stamp_t> m_stamps;
+    std::unordered_map<pid_t, intptr_t> m_children;
+};
+} // end of anonymous namespace
+
+int run_zygote_server(const zygote_config_t& config)
+{
+    server_t server(config);
+    return server.run();
+}
+
+bool launch_in_zygote(
+    const pal::string_t& socket_path,
+    const pal::string_t& app,
+    int argc,
+    const pal::char_t** argv,
+    const std::function<void(int pid)>& started,
+    int* exit_code)
+{
+    intptr_t socket;
+    if (!pal::local_socket_connect(socket_path, ZYGOTE_TIMEOUT_MS, &socket))
+    {
+        trace::verbose(_X("No fork server at %s"), socket_path.c_str());
+        return false;
+    }
+
+    std::vector<char> cwd(PATH_MAX);
+    if (::getcwd(cwd.data(), cwd.size()) == nullptr)
+    {
+        pal::local_socket_close(socket);
+        return false;
+    }
+
+    uint32_t header[2] = { ZYGOTE_MAGIC, ZYGOTE_PROTOCOL_VERSION };
+    const intptr_t fds[ZYGOTE_FD_COUNT] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    uint32_t magic, version, status, pid;
+    bool ok = pal::local_socket_send_fds(socket, header, sizeof(header), fds, ZYGOTE_FD_COUNT) &&
+        send_string(socket, app) &&
+        send_string(socket, cwd.data()) &&
+        send_strings(socket, std::vector<pal::string_t>(argv, argv + argc)) &&
+        send_strings(socket, current_env()) &&
+        recv_u32(socket, &magic) && recv_u32(socket, &version) &&
+        recv_u32(socket, &status) && recv_u32(socket, &pid) &&
+        magic == ZYGOTE_MAGIC && version == ZYGOTE_PROTOCOL_VERSION;
+    if (!ok || status != reply_started)
+    {
+        trace::info(_X("Fork server at %s did not run the app"), socket_path.c_str());
+        pal::local_socket_close(socket);
+        return false;
+    }
+
+    if (started)
+    {
+        started((int) pid);
+    }
+
+    // The app runs as long as it likes.
+    pal::local_socket_set_timeout(socket, 0);
+    uint32_t code;
+    if (!recv_u32(socket, &code))
+    {
+        trace::error(_X("Lost the fork server at %s while the app was running"), socket_path.c_str());
+        code = 1;
+    }
+    pal::local_socket_close(socket);
+    *exit_code = (int) code;
+    return true;
+}
+
+#else // _WIN32
+
+int run_zygote_server(const zygote_config_t& config)
+{
+    trace::error(_X("The fork server is not supported on this platform"));
+    return 1;
+}
+
+bool launch_in_zygote(
+    const pal::string_t& socket_path,
+    const pal::string_t& app,
+    int argc,
+    const pal::char_t** argv,
+    const std::function<void(int pid)>& started,
+    int* exit_code)
+{
+    return false;
+}
+
+#endif // _WIN32
@@ -0,0 +1,53 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include <functional>
+
+#include "pal.h"
+
+// -----------------------------------------------------------------------------
+// Fork server ("zygote") for one app. The server resolves the app and loads
+// CoreCLR once. It then forks a child for every launch request, which runs
+// the app with the request's arguments, working directory, environment and
+// stdin/stdout/stderr. corehost_launch is the client.
+//
+// A request is refused, and the launcher runs the app the usual way, if the
+// environment differs in a variable that steers the host. If one of the
+// app's inputs changed since the server started, the request is refused and
+// the server exits.
+//
+struct zygote_config_t
+{
+    pal::string_t socket_path;
+    pal::string_t managed_application;
+
+    // Files and dirs that must be the same as when the server started.
+    std::vector<pal::string_t> files;
+
+    // Any further check that the server's resolution is still current.
+    std::function<bool()> validate;
+
+    // Runs the app in the forked child and returns its exit code.
+    std::function<int(int argc, const pal::char_t** argv)> run;
+};
+
+// Serve requests until interrupted or stale. Returns the host exit code.
+int run_zygote_server(const zygote_config_t& config);
+
+// Run "app" with "argc"/"argv" through the server at "socket_path", with this
+// process' working directory, environment and standard streams. "started"
+// is called with the child's pid once it runs. Returns false without running
+// anything if there is no server or it refused; else "exit_code" is the
+// app's, or 128 plus the signal that ended it.
+bool launch_in_zygote(
+    const pal::string_t& socket_path,
+    const pal::string_t& app,
+    int argc,
+    const pal::char_t** argv,
+    const std::function<void(int pid)>& started,
+    int* exit_code);
+
+#endif // ZYGOTE_H
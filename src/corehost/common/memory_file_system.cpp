@@ -0,0 +1,189 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cassert>
+#include <chrono>
+
+#include "memory_file_system.h"
+#include "utils.h"
+
+memory_file_system_t::memory_file_system_t()
+    : m_stat(0)
+    , m_readdir(0)
+    , m_realpath(0)
+    , m_open(0)
+{
+    m_latency = latency_t();
+}
+
+// -----------------------------------------------------------------------------
+// Normalize "path" to the key used in the tree: separators collapsed, "." and
+// ".." resolved and no trailing separator.
+//
+pal::string_t memory_file_system_t::canonicalize(const pal::string_t& path)
+{
+    std::vector<pal::string_t> parts;
+    size_t start = 0;
+    while (start <= path.length())
+    {
+        size_t end = path.find(DIR_SEPARATOR, start);
+        if (end == pal::string_t::npos)
+        {
+            end = path.length();
+        }
+        pal::string_t part = path.substr(start, end - start);
+        if (part == _X(".."))
+        {
+            if (!parts.empty())
+            {
+                parts.pop_back();
+            }
+        }
+        else if (!part.empty() && part != _X("."))
+        {
+            parts.push_back(part);
+        }
+        start = end + 1;
+    }
+
+    pal::string_t canon;
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        if (i > 0 || (!path.empty() && path[0] == DIR_SEPARATOR))
+        {
+            canon.push_back(DIR_SEPARATOR);
+        }
+        canon.append(parts[i]);
+    }
+    if (canon.empty() && !path.empty() && path[0] == DIR_SEPARATOR)
+    {
+        canon.push_back(DIR_SEPARATOR);
+    }
+    return canon;
+}
+
+const memory_file_system_t::node_t* memory_file_system_t::find(const pal::string_t& path) const
+{
+    auto iter = m_nodes.find(canonicalize(path));
+    return (iter == m_nodes.end()) ? nullptr : &iter->second;
+}
+
+void memory_file_system_t::delay(unsigned us) const
+{
+    if (us == 0)
+    {
+        return;
+    }
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+    while (std::chrono::steady_clock::now() < until)
+    {
+    }
+}
+
+void memory_file_system_t::add_dir(const pal::string_t& path)
+{
+    pal::string_t canon = canonicalize(path);
+    if (m_nodes.count(canon))
+    {
+        return;
+    }
+
+    auto parent = get_directory(canon);
+    if (!parent.empty() && parent != canon)
+    {
+        add_dir(parent);
+    }
+
+    node_t& node = m_nodes[canon];
+    node.is_dir = true;
+}
+
+void memory_file_system_t::add_file(const pal::string_t& path, const std::string& content)
+{
+    pal::string_t canon = canonicalize(path);
+
+    auto parent = get_directory(canon);
+    if (!parent.empty() && parent != canon)
+    {
+        add_dir(parent);
+    }
+
+    auto iter = m_nodes.find(canon);
+    if (iter == m_nodes.end())
+    {
+        if (!parent.empty() && parent != canon)
+        {
+            m_nodes[parent].files.push_back(get_filename(canon));
+        }
+        iter = m_nodes.emplace(canon, node_t()).first;
+    }
+    iter->second.is_dir = false;
+    iter->second.content = content;
+}
+
+memory_file_system_t::counts_t memory_file_system_t::counts() const
+{
+    counts_t c;
+    c.stat = m_stat.load();
+    c.readdir = m_readdir.load();
+    c.realpath = m_realpath.load();
+    c.open = m_open.load();
+    return c;
+}
+
+void memory_file_system_t::reset_counts()
+{
+    m_stat = 0;
+    m_readdir = 0;
+    m_realpath = 0;
+    m_open = 0;
+}
+
+bool memory_file_system_t::realpath(pal::string_t* path)
+{
+    m_realpath++;
+    delay(m_latency.realpath_us);
+
+    pal::string_t canon = canonicalize(*path);
+    if (!m_nodes.count(canon))
+    {
+        return false;
+    }
+    path->assign(canon);
+    return true;
+}
+
+bool memory_file_system_t::file_exists(const pal::string_t& path)
+{
+    m_stat++;
+    delay(m_latency.stat_us);
+
+    return !path.empty() && find(path) != nullptr;
+}
+
+void memory_file_system_t::readdir(const pal::string_t& path, std::vector<pal::string_t>* list)
+{
+    assert(list != nullptr);
+
+    m_readdir++;
+    delay(m_latency.readdir_us);
+
+    const node_t* node = find(path);
+    if (node != nullptr && node->is_dir)
+    {
+        list->insert(list->end(), node->files.begin(), node->files.end());
+    }
+}
+
+std::unique_ptr<std::istream> memory_file_system_t::open_file(const pal::string_t& path)
+{
+    m_open++;
+    delay(m_latency.open_us);
+
+    const node_t* node = find(path);
+    if (node == nullptr || node->is_dir)
+    {
+        return nullptr;
+    }
+    return std::unique_ptr<std::istream>(new std::istringstream(node->content));
+}
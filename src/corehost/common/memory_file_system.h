@@ -0,0 +1,78 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef MEMORY_FILE_SYSTEM_H
+#define MEMORY_FILE_SYSTEM_H
+
+#include <atomic>
+
+#include "pal.h"
+
+// -----------------------------------------------------------------------------
+// An in-memory file tree implementing pal::file_system_t, for benchmarking and
+// testing the resolver apart from the machine's file system.
+//
+// Each operation can be charged a fixed latency (busy-waited, so that it is
+// precise at microsecond scale) to emulate slow storage such as NFS, and is
+// counted so that algorithmic changes show up independent of timing.
+//
+// Paths are absolute; "." and ".." are resolved, there are no symlinks. The
+// tree must be populated before it is installed with pal::set_file_system and
+// must not be changed while in use. Lookups are safe to run concurrently.
+//
+class memory_file_system_t : public pal::file_system_t
+{
+public:
+    struct latency_t
+    {
+        unsigned stat_us;
+        unsigned readdir_us;
+        unsigned realpath_us;
+        unsigned open_us;
+    };
+
+    struct counts_t
+    {
+        unsigned long stat;
+        unsigned long readdir;
+        unsigned long realpath;
+        unsigned long open;
+    };
+
+    memory_file_system_t();
+
+    // Add a file, creating its parent directories.
+    void add_file(const pal::string_t& path, const std::string& content);
+    void add_dir(const pal::string_t& path);
+
+    void set_latency(const latency_t& latency) { m_latency = latency; }
+    counts_t counts() const;
+    void reset_counts();
+
+    bool realpath(pal::string_t* path) override;
+    bool file_exists(const pal::string_t& path) override;
+    void readdir(const pal::string_t& path, std::vector<pal::string_t>* list) override;
+    std::unique_ptr<std::istream> open_file(const pal::string_t& path) override;
+
+private:
+    struct node_t
+    {
+        bool is_dir;
+        std::string content;
+        std::vector<pal::string_t> files;
+    };
+
+    static pal::string_t canonicalize(const pal::string_t& path);
+    const node_t* find(const pal::string_t& path) const;
+    void delay(unsigned us) const;
+
+    std::unordered_map<pal::string_t, node_t> m_nodes;
+    latency_t m_latency;
+
+    std::atomic<unsigned long> m_stat;
+    std::atomic<unsigned long> m_readdir;
+    std::atomic<unsigned long> m_realpath;
+    std::atomic<unsigned long> m_open;
+};
+
+#endif // MEMORY_FILE_SYSTEM_H
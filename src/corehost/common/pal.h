@@ -15,6 +15,7 @@
 #include <unordered_map>
 #include <memory>
 #include <algorithm>
+#include <cstdint>
 
 #if defined(_WIN32)
 
@@ -50,10 +51,13 @@
 
 #if defined(_WIN32)
 #define MAKE_LIBNAME(NAME) (_X(NAME) _X(".dll"))
+#define LIBRARY_EXT _X(".dll")
 #elif defined(__APPLE__)
 #define MAKE_LIBNAME(NAME) (_X("lib") _X(NAME) _X(".dylib"))
+#define LIBRARY_EXT _X(".dylib")
 #else
 #define MAKE_LIBNAME(NAME) (_X("lib") _X(NAME) _X(".so"))
+#define LIBRARY_EXT _X(".so")
 #endif
 
 #define LIBCORECLR_NAME MAKE_LIBNAME("coreclr")
@@ -90,6 +94,10 @@ namespace pal
     inline int strcasecmp(const char_t* str1, const char_t* str2) { return ::_wcsicmp(str1, str2); }
     inline size_t strlen(const char_t* str) { return ::wcslen(str); }
     inline void err_vprintf(const char_t* format, va_list vl) { ::vfwprintf(stderr, format, vl); ::fputws(_X("\r\n"), stderr); }
+    inline int str_vprintf(char_t* buffer, size_t count, const char_t* format, va_list vl) { va_list copy; va_copy(copy, vl); int len = ::_vscwprintf(format, copy); va_end(copy); ::_vsnwprintf_s(buffer, count, _TRUNCATE, format, vl); return len; }
+    inline FILE* file_open(const string_t& path, const char_t* mode) { FILE* stream = nullptr; return (::_wfopen_s(&stream, path.c_str(), mode) == 0) ? stream : nullptr; }
+    inline bool rename_file(const string_t& from, const string_t& to) { return ::_wrename(from.c_str(), to.c_str()) == 0; }
+    inline bool remove_file(const string_t& path) { return ::_wremove(path.c_str()) == 0; }
 
     pal::string_t to_palstring(const std::string& str);
     std::string to_stdstring(const pal::string_t& str);
@@ -115,15 +123,184 @@ namespace pal
     inline int strcasecmp(const char_t* str1, const char_t* str2) { return ::strcasecmp(str1, str2); }
     inline size_t strlen(const char_t* str) { return ::strlen(str); }
     inline void err_vprintf(const char_t* format, va_list vl) { ::vfprintf(stderr, format, vl); ::fputc('\n', stderr); }
+    inline int str_vprintf(char_t* buffer, size_t count, const char_t* format, va_list vl) { return ::vsnprintf(buffer, count, format, vl); }
+    inline FILE* file_open(const string_t& path, const char_t* mode) { return ::fopen(path.c_str(), mode); }
+    inline bool rename_file(const string_t& from, const string_t& to) { return ::rename(from.c_str(), to.c_str()) == 0; }
+    inline bool remove_file(const string_t& path) { return ::remove(path.c_str()) == 0; }
     inline pal::string_t to_palstring(const std::string& str) { return str; }
     inline std::string to_stdstring(const pal::string_t& str) { return str; }
     inline void to_palstring(const char* str, pal::string_t* out) { out->assign(str); }
     inline void to_stdstring(const pal::char_t* str, std::string* out) { out->assign(str); }
 #endif
-    bool realpath(string_t* path);
-    bool file_exists(const string_t& path);
+    // File system operations the host uses to probe for files. The native
+    // implementation is the default; benchmarks and tests can substitute
+    // another one (for example an in-memory tree) with set_file_system().
+    class file_system_t
+    {
+    public:
+        virtual ~file_system_t() { }
+        virtual bool realpath(string_t* path) = 0;
+        virtual bool file_exists(const string_t& path) = 0;
+        virtual void readdir(const string_t& path, std::vector<pal::string_t>* list) = 0;
+
+        // Returns nullptr if the file could not be opened.
+        virtual std::unique_ptr<std::istream> open_file(const string_t& path) = 0;
+    };
+
+    file_system_t* native_file_system();
+
+    // Replace the file system used by the functions below. Passing nullptr
+    // restores the native one. Not thread safe, call before probing starts.
+    void set_file_system(file_system_t* fs);
+
+    // Replace it for the calling thread only, taking precedence over the one
+    // above. Passing nullptr goes back to the process-wide file system.
+    void set_thread_file_system(file_system_t* fs);
+    file_system_t* get_file_system();
+
+    inline bool realpath(string_t* path) { return get_file_system()->realpath(path); }
+    inline bool file_exists(const string_t& path) { return get_file_system()->file_exists(path); }
     inline bool directory_exists(const string_t& path) { return file_exists(path); }
-    void readdir(const string_t& path, std::vector<pal::string_t>* list);
+    inline void readdir(const string_t& path, std::vector<pal::string_t>* list) { get_file_system()->readdir(path, list); }
+    inline std::unique_ptr<std::istream> open_file(const string_t& path) { return get_file_system()->open_file(path); }
+
+    // Write "count" characters to "stream" bypassing stdio buffering. Safe to
+    // call from a crash handler on Unix.
+    void file_write(FILE* stream, const char_t* buffer, size_t count);
+
+    // Run "handler" once if the process is about to die from a fatal signal.
+    void set_crash_handler(void (*handler)());
+
+    // Ask the OS to start reading "path" into the page cache. Does not wait
+    // for the read. Returns false where this is not supported.
+    bool prefetch_file(const string_t& path);
+
+    // Paths of the files currently mapped into this process, each once.
+    // Returns false where this is not supported.
+    bool get_mapped_files(std::vector<string_t>* files);
+
+    // CPU and memory the process may use, as the machine, its affinity and
+    // its cgroup (v1 or v2) allow. Zero means unknown or not limited.
+    struct resource_limits_t
+    {
+        unsigned online_cpus;
+        // CPUs in the affinity set and the cgroup cpuset, and a mask of
+        // those among the first 64.
+        unsigned affinity_cpus;
+        uint64_t affinity_mask;
+        // CPU bandwidth quota, in CPUs.
+        double quota_cpus;
+        uint64_t memory_limit;
+        uint64_t physical_memory;
+    };
+
+    // "root" is prepended to every /proc and cgroup path read, so that a
+    // made-up hierarchy can be checked. Returns false where this is not
+    // supported.
+    bool get_resource_limits(resource_limits_t* limits, const string_t& root = string_t());
+
+    // What tells a file apart from the same path after it was replaced or
+    // rewritten.
+    struct file_identity_t
+    {
+        uint64_t device;
+        uint64_t inode;
+        uint64_t size;
+        uint64_t mtime_ns;
+    };
+
+    bool get_file_identity(const string_t& path, file_identity_t* identity);
+
+    // Directories and symlinks the host lays out itself. Symlinks are not
+    // supported on Windows. remove_directory removes the files and symlinks
+    // in "path" first, dangling ones included, but not its subdirectories.
+    bool create_directory(const string_t& path);
+    bool create_symlink(const string_t& target, const string_t& link);
+    bool remove_directory(const string_t& path);
+    void list_directories(const string_t& path, std::vector<string_t>* list);
+
+    // Advisory locks on the file at "path" between processes, neither of
+    // which waits. A shared lock is held until the process exits, and only
+    // taken if "path" still names the file locked; "create" makes the file if
+    // it is missing. An exclusive lock is held until unlock_path.
+    bool hold_shared_lock(const string_t& path, bool create);
+    bool try_lock_path(const string_t& path, intptr_t* handle);
+    void unlock_path(intptr_t handle);
+
+    // A file mapped read-only and private to this process.
+    struct mapped_file_t
+    {
+        const void* data;
+        size_t size;
+    };
+
+    // Empty files cannot be mapped. Returns false where this is not supported.
+    bool map_file(const string_t& path, mapped_file_t* file);
+    void unmap_file(mapped_file_t* file);
+
+    // A file mapped read-write and shared with other processes.
+    struct shared_file_t
+    {
+        void* data;
+        size_t size;
+        intptr_t handle;
+    };
+
+    // Map "path", creating it with "size" bytes of zeros if it does not exist.
+    // Files that are symlinks, not owned by the current user or writable by
+    // anyone else are refused, since other processes trust their content.
+    bool map_shared_file(const string_t& path, size_t size, shared_file_t* file);
+    void unmap_shared_file(shared_file_t* file);
+
+    // Advisory whole-file lock between processes. try_lock_file does not wait.
+    bool lock_file(const shared_file_t& file);
+    bool try_lock_file(const shared_file_t& file);
+    void unlock_file(const shared_file_t& file);
+
+    // Per-user location for the shared resolution cache.
+    bool get_default_resolve_cache_path(string_t* recv);
+
+    // Client end of a local (Unix domain) stream socket. Connecting, and every
+    // send or receive, gives up after "timeout_ms". Only a server running as
+    // the current user is accepted.
+    bool local_socket_connect(const string_t& path, int timeout_ms, intptr_t* socket);
+    bool local_socket_send(intptr_t socket, const void* data, size_t size);
+    bool local_socket_recv(intptr_t socket, void* data, size_t size);
+    void local_socket_close(intptr_t socket);
+
+    // Server end: the socket is only accessible to the current user, and so
+    // are the peers accept() lets through. Listening fails if another server
+    // already answers at "path". A timeout of zero means none.
+    bool local_socket_listen(const string_t& path, intptr_t* socket);
+    bool local_socket_accept(intptr_t listener, int timeout_ms, intptr_t* socket);
+    void local_socket_set_timeout(intptr_t socket, int timeout_ms);
+
+    // Pass open file descriptors along with "data". Received descriptors are
+    // appended to "fds" and owned by the caller, even if the receive fails.
+    bool local_socket_send_fds(intptr_t socket, const void* data, size_t size, const intptr_t* fds, size_t fd_count);
+    bool local_socket_recv_fds(intptr_t socket, void* data, size_t size, std::vector<intptr_t>* fds);
+
+    // Per-user directory for sockets: XDG_RUNTIME_DIR, else /tmp.
+    bool get_runtime_dir(string_t* recv);
+
+    // Per-user socket path of the resolution daemon.
+    bool get_default_resolve_daemon_path(string_t* recv);
+
+    // Per-user socket path of the fork server for the app at "app".
+    bool get_default_zygote_path(const string_t& app, string_t* recv);
+
+    // End the process with "exit_code" right away: no atexit handlers,
+    // static destructors or library unload code run, and buffered output not
+    // flushed by the caller is lost.
+    [[noreturn]] void exit_now(int exit_code);
+
+    // Runtime identifier of this host build, e.g. "linux-x64".
+    const char_t* get_host_rid();
+
+    // Tags of the instruction set extensions that both the CPU and the OS
+    // support, widest first: "avx512", "avx2", "avx" and "sse4.2" on x86,
+    // "sve2" and "sve" on arm64. Detected once per process.
+    const std::vector<string_t>& get_cpu_isa_variants();
 
     bool get_own_executable_path(string_t* recv);
     bool getenv(const char_t* name, string_t* recv);
@@ -132,7 +309,13 @@ namespace pal
 
     int xtoi(const char_t* input);
 
-    bool load_library(const char_t* path, dll_t* dll);
+    // "resolve_now" asks the loader to process all relocations up front
+    // (RTLD_NOW) instead of lazily on first call. Ignored on Windows.
+    bool load_library(const char_t* path, dll_t* dll, bool resolve_now = false);
+
+    // Load "path" for the life of the process, the way the runtime loads
+    // native libraries. Failures are described in "error", not traced.
+    bool preload_library(const string_t& path, string_t* error);
     proc_t get_symbol(dll_t library, const char* name);
     void unload_library(dll_t library);
 
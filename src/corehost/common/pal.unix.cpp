@@ -6,20 +6,72 @@
 #include "trace.h"
 
 #include <cassert>
+#include <cerrno>
+#include <functional>
 #include <dlfcn.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unordered_set>
 #include <sys/stat.h>
+#include <signal.h>
+#include <unistd.h>
 
 #if defined(__APPLE__)
 #include <mach-o/dyld.h>
 #endif
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
 #if defined(__LINUX__)
+#include <sched.h>
+#include <sys/auxv.h>
 #define symlinkEntrypointExecutable "/proc/self/exe"
 #elif !defined(__APPLE__)
 #define symlinkEntrypointExecutable "/proc/curproc/exe"
 #endif
 
+namespace
+{
+class native_file_system_t : public pal::file_system_t
+{
+public:
+    bool realpath(pal::string_t* path) override;
+    bool file_exists(const pal::string_t& path) override;
+    void readdir(const pal::string_t& path, std::vector<pal::string_t>* list) override;
+    std::unique_ptr<std::istream> open_file(const pal::string_t& path) override;
+};
+
+native_file_system_t g_native_file_system;
+pal::file_system_t* g_file_system = &g_native_file_system;
+thread_local pal::file_system_t* t_file_system = nullptr;
+}
+
+pal::file_system_t* pal::native_file_system()
+{
+    return &g_native_file_system;
+}
+
+void pal::set_file_system(pal::file_system_t* fs)
+{
+    g_file_system = (fs != nullptr) ? fs : &g_native_file_system;
+}
+
+void pal::set_thread_file_system(pal::file_system_t* fs)
+{
+    t_file_system = fs;
+}
+
+pal::file_system_t* pal::get_file_system()
+{
+    return (t_file_system != nullptr) ? t_file_system : g_file_system;
+}
+
 bool pal::find_coreclr(pal::string_t* recv)
 {
     pal::string_t candidate;
@@ -41,9 +93,9 @@ bool pal::find_coreclr(pal::string_t* recv)
     return false;
 }
 
-bool pal::load_library(const char_t* path, dll_t* dll)
+bool pal::load_library(const char_t* path, dll_t* dll, bool resolve_now)
 {
-    *dll = dlopen(path, RTLD_LAZY);
+    *dll = dlopen(path, resolve_now ? RTLD_NOW : RTLD_LAZY);
     if (*dll == nullptr)
     {
         trace::error(_X("Failed to load %s, error: %s"), path, dlerror());
@@ -52,6 +104,17 @@ bool pal::load_library(const char_t* path, dll_t* dll)
     return true;
 }
 
+bool pal::preload_library(const pal::string_t& path, pal::string_t* error)
+{
+    if (dlopen(path.c_str(), RTLD_LAZY) == nullptr)
+    {
+        const char* message = dlerror();
+        error->assign(message != nullptr ? message : "unknown error");
+        return false;
+    }
+    return true;
+}
+
 pal::proc_t pal::get_symbol(dll_t library, const char* name)
 {
     auto result = dlsym(library, name);
@@ -131,7 +194,7 @@ bool pal::getenv(const pal::char_t* name, pal::string_t* recv)
     return (recv->length() > 0);
 }
 
-bool pal::realpath(pal::string_t* path)
+bool native_file_system_t::realpath(pal::string_t* path)
 {
     pal::char_t buf[PATH_MAX];
     auto resolved = ::realpath(path->c_str(), buf);
@@ -148,7 +211,7 @@ bool pal::realpath(pal::string_t* path)
     return true;
 }
 
-bool pal::file_exists(const pal::string_t& path)
+bool native_file_system_t::file_exists(const pal::string_t& path)
 {
     if (path.empty())
     {
@@ -158,7 +221,7 @@ bool pal::file_exists(const pal::string_t& path)
     return (::stat(path.c_str(), &buffer) == 0);
 }
 
-void pal::readdir(const pal::string_t& path, std::vector<pal::string_t>* list)
+void native_file_system_t::readdir(const pal::string_t& path, std::vector<pal::string_t>* list)
 {
     assert(list != nullptr);
 
@@ -168,7 +231,7 @@ void pal::readdir(const pal::string_t& path, std::vector<pal::string_t>* list)
     if (dir != nullptr)
     {
         struct dirent* entry = nullptr;
-        while((entry = readdir(dir)) != nullptr)
+        while((entry = ::readdir(dir)) != nullptr)
         {
             // We are interested in files only
             switch (entry->d_type)
@@ -205,5 +268,1080 @@ void pal::readdir(const pal::string_t& path, std::vector<pal::string_t>* list)
 
             files.push_back(pal::string_t(entry->d_name));
         }
+        closedir(dir);
+    }
+}
+
+std::unique_ptr<std::istream> native_file_system_t::open_file(const pal::string_t& path)
+{
+    std::unique_ptr<std::istream> file(new pal::ifstream_t(path));
+    if (!file->good())
+    {
+        return nullptr;
+    }
+    return file;
+}
+
+void pal::file_write(FILE* stream, const pal::char_t* buffer, size_t count)
+{
+    // Plain write(2) so that this is usable from a signal handler.
+    int fd = fileno(stream);
+    while (count > 0)
+    {
+        ssize_t written = ::write(fd, buffer, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        buffer += written;
+        count -= written;
+    }
+}
+
+namespace
+{
+void (*g_crash_handler)() = nullptr;
+
+void on_fatal_signal(int sig)
+{
+    // The runtime installs its own handlers later and chains to ours, so
+    // restore the default disposition explicitly before re-raising.
+    auto handler = g_crash_handler;
+    g_crash_handler = nullptr;
+    if (handler != nullptr)
+    {
+        handler();
+    }
+    ::signal(sig, SIG_DFL);
+    ::raise(sig);
+}
+}
+
+void pal::set_crash_handler(void (*handler)())
+{
+    g_crash_handler = handler;
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = on_fatal_signal;
+    action.sa_flags = SA_RESETHAND | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+
+    const int signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+    for (int sig : signals)
+    {
+        ::sigaction(sig, &action, nullptr);
+    }
+}
+
+bool pal::prefetch_file(const pal::string_t& path)
+{
+#if defined(__LINUX__)
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool ok = ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED) == 0;
+    ::close(fd);
+    return ok;
+#else
+    return false;
+#endif
+}
+
+bool pal::get_mapped_files(std::vector<pal::string_t>* files)
+{
+#if defined(__LINUX__)
+    std::ifstream maps("/proc/self/maps");
+    if (!maps.good())
+    {
+        return false;
+    }
+
+    // Each line is "address perms offset dev inode [path]"; only the path
+    // can contain a '/'.
+    std::unordered_set<pal::string_t> seen;
+    std::string line;
+    while (std::getline(maps, line))
+    {
+        size_t start = line.find('/');
+        if (start == std::string::npos || ends_with(line, _X(" (deleted)")))
+        {
+            continue;
+        }
+        pal::string_t path = line.substr(start);
+        if (seen.insert(path).second)
+        {
+            files->push_back(path);
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if defined(__LINUX__)
+namespace
+{
+bool read_line(const pal::string_t& path, std::string* line)
+{
+    std::ifstream file(path);
+    return file.good() && std::getline(file, *line) && !line->empty();
+}
+
+bool read_number(const pal::string_t& path, int64_t* value)
+{
+    std::string line;
+    if (!read_line(path, &line))
+    {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    long long parsed = std::strtoll(line.c_str(), &end, 10);
+    if (errno != 0 || end == line.c_str())
+    {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+// Number of CPUs in a cpuset list such as "0-3,8,10-11", and a mask of the
+// first 64.
+bool parse_cpu_list(const std::string& list, unsigned* count, uint64_t* mask)
+{
+    *count = 0;
+    *mask = 0;
+    pal::stringstream_t ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ','))
+    {
+        unsigned first = 0, last = 0;
+        char dash = 0;
+        int fields = std::sscanf(range.c_str(), "%u%c%u", &first, &dash, &last);
+        if (fields == 1)
+        {
+            last = first;
+        }
+        else if (fields != 3 || dash != '-' || last < first)
+        {
+            return false;
+        }
+        for (unsigned cpu = first; cpu <= last; ++cpu)
+        {
+            (*count)++;
+            if (cpu < 64)
+            {
+                *mask |= uint64_t(1) << cpu;
+            }
+        }
+    }
+    return *count != 0;
+}
+
+// Where a cgroup hierarchy is mounted and which directory in it holds this
+// process.
+struct cgroup_dir_t
+{
+    pal::string_t mount_point;
+    pal::string_t dir;
+
+    bool valid() const { return !dir.empty(); }
+};
+
+// Find this process's cgroup directory for the v1 "controller", or for the
+// v2 unified hierarchy when "controller" is empty.
+cgroup_dir_t find_cgroup_dir(const pal::string_t& root, const std::string& controller)
+{
+    cgroup_dir_t result;
+
+    // "hierarchy-id:controller,...:path", with no id nor controllers for v2.
+    std::ifstream cgroups(root + "/proc/self/cgroup");
+    std::string line;
+    std::string path;
+    bool found = false;
+    while (!found && std::getline(cgroups, line))
+    {
+        size_t first = line.find(':');
+        size_t second = first == std::string::npos ? first : line.find(':', first + 1);
+        if (second == std::string::npos)
+        {
+            continue;
+        }
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        if (controller.empty())
+        {
+            found = line.compare(0, first, "0") == 0 && controllers.empty();
+        }
+        else
+        {
+            pal::stringstream_t names(controllers);
+            std::string name;
+            while (!found && std::getline(names, name, ','))
+            {
+                found = name == controller;
+            }
+        }
+        if (found)
+        {
+            path = line.substr(second + 1);
+        }
+    }
+    if (!found)
+    {
+        return result;
+    }
+
+    // "id parent dev root mount-point options [optional...] - type source
+    // super-options".
+    std::ifstream mounts(root + "/proc/self/mountinfo");
+    while (std::getline(mounts, line))
+    {
+        std::istringstream fields(line);
+        std::string id, parent, dev, mount_root, mount_point, field;
+        if (!(fields >> id >> parent >> dev >> mount_root >> mount_point))
+        {
+            continue;
+        }
+        while (fields >> field && field != "-")
+        {
+        }
+        std::string type, source, options;
+        if (!(fields >> type >> source >> options))
+        {
+            continue;
+        }
+        if (controller.empty() ? type != "cgroup2" : type != "cgroup")
+        {
+            continue;
+        }
+        if (!controller.empty())
+        {
+            bool has_controller = false;
+            pal::stringstream_t names(options);
+            std::string name;
+            while (!has_controller && std::getline(names, name, ','))
+            {
+                has_controller = name == controller;
+            }
+            if (!has_controller)
+            {
+                continue;
+            }
+        }
+
+        // The process's path is relative to the root of the hierarchy; the
+        // mount only shows the part under "mount_root". A path outside of it
+        // (another cgroup namespace) is taken to be the mount point itself.
+        std::string relative;
+        if (mount_root == "/")
+        {
+            relative = path;
+        }
+        else if (path.compare(0, mount_root.size(), mount_root) == 0 &&
+            (path.size() == mount_root.size() || path[mount_root.size()] == '/'))
+        {
+            relative = path.substr(mount_root.size());
+        }
+        if (relative == "/")
+        {
+            relative.clear();
+        }
+        result.mount_point = root + mount_point;
+        result.dir = result.mount_point + relative;
+        return result;
+    }
+    return result;
+}
+
+// Call "read" on "cgroup"'s directory and each of its parents up to the mount
+// point: a limit set higher up applies to everything under it.
+void for_each_cgroup_level(const cgroup_dir_t& cgroup, const std::function<void(const pal::string_t&)>& read)
+{
+    pal::string_t dir = cgroup.dir;
+    while (true)
+    {
+        read(dir);
+        if (dir.size() <= cgroup.mount_point.size())
+        {
+            break;
+        }
+        dir = dir.substr(0, dir.rfind('/'));
+    }
+}
+
+void min_limit(double value, double* limit)
+{
+    if (value > 0 && (*limit == 0 || value < *limit))
+    {
+        *limit = value;
+    }
+}
+
+void min_limit(uint64_t value, uint64_t* limit)
+{
+    if (value > 0 && (*limit == 0 || value < *limit))
+    {
+        *limit = value;
+    }
+}
+
+void read_cgroup_limits(const pal::string_t& root, pal::resource_limits_t* limits)
+{
+    cgroup_dir_t unified = find_cgroup_dir(root, std::string());
+
+    // CPU quota: v1 "cpu.cfs_quota_us" over "cpu.cfs_period_us" (-1 when
+    // none), v2 "cpu.max" as "quota period" (quota "max" when none).
+    cgroup_dir_t cpu = find_cgroup_dir(root, "cpu");
+    if (cpu.valid())
+    {
+        for_each_cgroup_level(cpu, [&] (const pal::string_t& dir) {
+            int64_t quota = 0, period = 0;
+            if (read_number(dir + "/cpu.cfs_quota_us", &quota) && read_number(dir + "/cpu.cfs_period_us", &period) &&
+                quota > 0 && period > 0)
+            {
+                min_limit(double(quota) / period, &limits->quota_cpus);
+            }
+        });
+    }
+    else if (unified.valid())
+    {
+        for_each_cgroup_level(unified, [&] (const pal::string_t& dir) {
+            std::string line;
+            long long quota = 0, period = 0;
+            if (read_line(dir + "/cpu.max", &line) &&
+                std::sscanf(line.c_str(), "%lld %lld", &quota, &period) == 2 && quota > 0 && period > 0)
+            {
+                min_limit(double(quota) / period, &limits->quota_cpus);
+            }
+        });
+    }
+
+    // Memory: v1 "memory.limit_in_bytes" (a huge number when none), v2
+    // "memory.max" ("max" when none).
+    cgroup_dir_t memory = find_cgroup_dir(root, "memory");
+    const cgroup_dir_t& memory_dir = memory.valid() ? memory : unified;
+    const char* memory_file = memory.valid() ? "/memory.limit_in_bytes" : "/memory.max";
+    if (memory_dir.valid())
+    {
+        for_each_cgroup_level(memory_dir, [&] (const pal::string_t& dir) {
+            int64_t limit = 0;
+            if (read_number(dir + memory_file, &limit) && limit > 0)
+            {
+                min_limit(uint64_t(limit), &limits->memory_limit);
+            }
+        });
+    }
+
+    // Cpuset: the effective set already accounts for the parents. It is
+    // normally reflected in the affinity too, but not in a made-up root.
+    cgroup_dir_t cpuset = find_cgroup_dir(root, "cpuset");
+    std::string list;
+    unsigned count = 0;
+    uint64_t mask = 0;
+    if (((cpuset.valid() && read_line(cpuset.dir + "/cpuset.effective_cpus", &list)) ||
+        (cpuset.valid() && read_line(cpuset.dir + "/cpuset.cpus", &list)) ||
+        (unified.valid() && read_line(unified.dir + "/cpuset.cpus.effective", &list))) &&
+        parse_cpu_list(list, &count, &mask) && count < limits->affinity_cpus)
+    {
+        limits->affinity_cpus = count;
+        limits->affinity_mask &= mask;
+    }
+}
+} // end of anonymous namespace
+#endif
+
+bool pal::get_resource_limits(pal::resource_limits_t* limits, const pal::string_t& root)
+{
+#if defined(__LINUX__)
+    *limits = pal::resource_limits_t();
+
+    long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+    long pages = ::sysconf(_SC_PHYS_PAGES);
+    long page_size = ::sysconf(_SC_PAGE_SIZE);
+    if (cpus <= 0)
+    {
+        return false;
+    }
+    limits->online_cpus = (unsigned) cpus;
+    if (pages > 0 && page_size > 0)
+    {
+        limits->physical_memory = uint64_t(pages) * uint64_t(page_size);
+    }
+
+    limits->affinity_cpus = limits->online_cpus;
+    limits->affinity_mask = limits->online_cpus >= 64 ? ~uint64_t(0) : (uint64_t(1) << limits->online_cpus) - 1;
+    cpu_set_t set;
+    if (root.empty() && ::sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0)
+    {
+        limits->affinity_cpus = CPU_COUNT(&set);
+        limits->affinity_mask = 0;
+        for (unsigned cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                limits->affinity_mask |= uint64_t(1) << cpu;
+            }
+        }
+    }
+
+    read_cgroup_limits(root, limits);
+
+    // v1 reports "no limit" as a page-rounded LLONG_MAX.
+    if (limits->physical_memory != 0 && limits->memory_limit >= limits->physical_memory)
+    {
+        limits->memory_limit = 0;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+const pal::char_t* pal::get_host_rid()
+{
+#if defined(__APPLE__)
+#define RID_OS "osx"
+#elif defined(__FreeBSD__)
+#define RID_OS "freebsd"
+#else
+#define RID_OS "linux"
+#endif
+#if defined(__x86_64__)
+    return _X(RID_OS "-x64");
+#elif defined(__aarch64__)
+    return _X(RID_OS "-arm64");
+#elif defined(__arm__)
+    return _X(RID_OS "-arm");
+#elif defined(__i386__)
+    return _X(RID_OS "-x86");
+#else
+    return _X(RID_OS);
+#endif
+#undef RID_OS
+}
+
+namespace
+{
+std::vector<pal::string_t> detect_cpu_isa_variants()
+{
+    std::vector<pal::string_t> variants;
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        return variants;
+    }
+    bool sse42 = (ecx & bit_SSE4_2) && (ecx & bit_POPCNT);
+    bool avx = false;
+    bool avx512_state = false;
+
+    // The OS must save the YMM (and ZMM) registers for AVX (AVX-512) code.
+    if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX))
+    {
+        unsigned xcr0_lo, xcr0_hi;
+        __asm__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+        avx = (xcr0_lo & 0x6) == 0x6;
+        avx512_state = (xcr0_lo & 0xe6) == 0xe6;
     }
+    bool fma = (ecx & bit_FMA) != 0;
+
+    bool avx2 = false;
+    bool avx512 = false;
+    if (avx && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    {
+        avx2 = fma && (ebx & bit_AVX2) && (ebx & bit_BMI) && (ebx & bit_BMI2);
+        // The AVX-512 subsets compilers target with -mavx512 (x86-64-v4).
+        const unsigned avx512_bits = bit_AVX512F | bit_AVX512CD | bit_AVX512BW | bit_AVX512DQ | bit_AVX512VL;
+        avx512 = avx2 && avx512_state && (ebx & avx512_bits) == avx512_bits;
+    }
+
+    if (avx512) variants.push_back(_X("avx512"));
+    if (avx2) variants.push_back(_X("avx2"));
+    if (avx) variants.push_back(_X("avx"));
+    if (sse42) variants.push_back(_X("sse4.2"));
+#elif defined(__aarch64__) && defined(__LINUX__)
+#if !defined(HWCAP_SVE)
+#define HWCAP_SVE (1 << 22)
+#endif
+#if !defined(HWCAP2_SVE2)
+#define HWCAP2_SVE2 (1 << 1)
+#endif
+    unsigned long hwcap = ::getauxval(AT_HWCAP);
+    unsigned long hwcap2 = ::getauxval(AT_HWCAP2);
+    bool sve = (hwcap & HWCAP_SVE) != 0;
+    if (sve && (hwcap2 & HWCAP2_SVE2)) variants.push_back(_X("sve2"));
+    if (sve) variants.push_back(_X("sve"));
+#endif
+    return variants;
+}
+} // end of anonymous namespace
+
+const std::vector<pal::string_t>& pal::get_cpu_isa_variants()
+{
+    static const std::vector<pal::string_t> variants = detect_cpu_isa_variants();
+    return variants;
+}
+
+void pal::exit_now(int exit_code)
+{
+    ::_exit(exit_code);
+}
+
+bool pal::get_file_identity(const pal::string_t& path, pal::file_identity_t* identity)
+{
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0)
+    {
+        return false;
+    }
+    identity->device = st.st_dev;
+    identity->inode = st.st_ino;
+    identity->size = st.st_size;
+#if defined(__APPLE__)
+    identity->mtime_ns = (uint64_t) st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    identity->mtime_ns = (uint64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+bool pal::create_directory(const pal::string_t& path)
+{
+    return ::mkdir(path.c_str(), 0755) == 0;
+}
+
+bool pal::create_symlink(const pal::string_t& target, const pal::string_t& link)
+{
+    return ::symlink(target.c_str(), link.c_str()) == 0;
+}
+
+bool pal::remove_directory(const pal::string_t& path)
+{
+    // Not pal::readdir: it leaves out links whose target is gone.
+    auto dir = opendir(path.c_str());
+    if (dir != nullptr)
+    {
+        struct dirent* entry = nullptr;
+        while ((entry = ::readdir(dir)) != nullptr)
+        {
+            if (entry->d_type != DT_DIR)
+            {
+                ::unlink((path + DIR_SEPARATOR + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+    return ::rmdir(path.c_str()) == 0;
+}
+
+void pal::list_directories(const pal::string_t& path, std::vector<pal::string_t>* list)
+{
+    auto dir = opendir(path.c_str());
+    if (dir == nullptr)
+    {
+        return;
+    }
+    struct dirent* entry = nullptr;
+    while ((entry = ::readdir(dir)) != nullptr)
+    {
+        if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+        struct stat sb;
+        if (entry->d_type == DT_DIR ||
+            (entry->d_type == DT_UNKNOWN && ::lstat((path + DIR_SEPARATOR + entry->d_name).c_str(), &sb) == 0 && S_ISDIR(sb.st_mode)))
+        {
+            list->push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+}
+
+bool pal::hold_shared_lock(const pal::string_t& path, bool create)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    // Whoever held the file exclusively may have removed it meanwhile.
+    struct stat locked, current;
+    if (::flock(fd, LOCK_SH | LOCK_NB) != 0 || ::fstat(fd, &locked) != 0 || ::stat(path.c_str(), &current) != 0 ||
+        locked.st_dev != current.st_dev || locked.st_ino != current.st_ino)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // Never closed, the lock goes with the process.
+    return true;
+}
+
+bool pal::try_lock_path(const pal::string_t& path, intptr_t* handle)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (::flock(fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    *handle = fd;
+    return true;
+}
+
+void pal::unlock_path(intptr_t handle)
+{
+    ::close((int) handle);
+}
+
+bool pal::map_file(const pal::string_t& path, pal::mapped_file_t* file)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    void* data = (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        ? ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)
+        : MAP_FAILED;
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    file->data = data;
+    file->size = st.st_size;
+    return true;
+}
+
+void pal::unmap_file(pal::mapped_file_t* file)
+{
+    if (file->data != nullptr)
+    {
+        ::munmap(const_cast<void*>(file->data), file->size);
+        file->data = nullptr;
+    }
+}
+
+bool pal::map_shared_file(const pal::string_t& path, size_t size, pal::shared_file_t* file)
+{
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != ::geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0)
+    {
+        trace::verbose(_X("Not using shared file %s, it is not private to this user"), path.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    // Size a new file under the lock so that no one maps it half done.
+    if (st.st_size == 0)
+    {
+        ::flock(fd, LOCK_EX);
+        if (::fstat(fd, &st) == 0 && st.st_size == 0 && ::ftruncate(fd, size) == 0)
+        {
+            st.st_size = size;
+        }
+        ::flock(fd, LOCK_UN);
+    }
+
+    void* data = (st.st_size > 0) ? ::mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (data == MAP_FAILED)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    file->data = data;
+    file->size = st.st_size;
+    file->handle = fd;
+    return true;
+}
+
+void pal::unmap_shared_file(pal::shared_file_t* file)
+{
+    if (file->data != nullptr)
+    {
+        ::munmap(file->data, file->size);
+        ::close((int) file->handle);
+        file->data = nullptr;
+    }
+}
+
+bool pal::lock_file(const pal::shared_file_t& file)
+{
+    return ::flock((int) file.handle, LOCK_EX) == 0;
+}
+
+bool pal::try_lock_file(const pal::shared_file_t& file)
+{
+    return ::flock((int) file.handle, LOCK_EX | LOCK_NB) == 0;
+}
+
+void pal::unlock_file(const pal::shared_file_t& file)
+{
+    ::flock((int) file.handle, LOCK_UN);
+}
+
+bool pal::get_default_resolve_cache_path(pal::string_t* recv)
+{
+    // Prefer tmpfs: the cache is rebuilt cheaply and should not cost disk I/O.
+    pal::string_t name = _X("corehost_resolve_cache.") + std::to_string(::geteuid());
+    if (::access("/dev/shm", W_OK) == 0)
+    {
+        recv->assign(_X("/dev/shm"));
+        append_path(recv, name.c_str());
+        return true;
+    }
+
+    pal::string_t dotnet_dir;
+    if (pal::getenv(_X("HOME"), &dotnet_dir))
+    {
+        append_path(&dotnet_dir, _X(".dotnet"));
+        if (pal::directory_exists(dotnet_dir))
+        {
+            recv->assign(dotnet_dir);
+            append_path(recv, name.c_str());
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace
+{
+bool to_socket_address(const pal::string_t& path, struct sockaddr_un* addr)
+{
+    std::memset(addr, 0, sizeof(*addr));
+    if (path.length() >= sizeof(addr->sun_path))
+    {
+        return false;
+    }
+    addr->sun_family = AF_UNIX;
+    std::memcpy(addr->sun_path, path.c_str(), path.length());
+    return true;
+}
+
+bool is_peer_same_user(int fd)
+{
+#if defined(__LINUX__)
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == 0 && cred.uid == ::geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return ::getpeereid(fd, &uid, &gid) == 0 && uid == ::geteuid();
+#endif
+}
+} // end of anonymous namespace
+
+bool pal::local_socket_connect(const pal::string_t& path, int timeout_ms, intptr_t* socket)
+{
+    struct sockaddr_un addr;
+    if (!to_socket_address(path, &addr))
+    {
+        return false;
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    // The send timeout also bounds connect() on a Unix socket.
+    pal::local_socket_set_timeout(fd, timeout_ms);
+
+    if (::connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    if (!is_peer_same_user(fd))
+    {
+        trace::warning(_X("Ignoring %s, it is served by another user"), path.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    *socket = fd;
+    return true;
+}
+
+bool pal::local_socket_listen(const pal::string_t& path, intptr_t* socket)
+{
+    struct sockaddr_un addr;
+    if (!to_socket_address(path, &addr))
+    {
+        trace::error(_X("Socket path is too long: %s"), path.c_str());
+        return false;
+    }
+
+    // Take the path over from a server that is gone, but not from a live one.
+    intptr_t existing;
+    if (pal::local_socket_connect(path, 100, &existing))
+    {
+        pal::local_socket_close(existing);
+        trace::error(_X("A server is already listening on %s"), path.c_str());
+        return false;
+    }
+    ::unlink(path.c_str());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    mode_t mask = ::umask(0077);
+    bool bound = fd >= 0 && ::bind(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0;
+    ::umask(mask);
+    if (!bound || ::listen(fd, 64) != 0)
+    {
+        trace::error(_X("Failed to listen on %s: %s"), path.c_str(), std::strerror(errno));
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return false;
+    }
+
+    *socket = fd;
+    return true;
+}
+
+bool pal::local_socket_accept(intptr_t listener, int timeout_ms, intptr_t* socket)
+{
+    int fd;
+    do
+    {
+        fd = ::accept((int) listener, nullptr, nullptr);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0)
+    {
+        return false;
+    }
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    if (!is_peer_same_user(fd))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    pal::local_socket_set_timeout(fd, timeout_ms);
+    *socket = fd;
+    return true;
+}
+
+void pal::local_socket_set_timeout(intptr_t socket, int timeout_ms)
+{
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    ::setsockopt((int) socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt((int) socket, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+bool pal::local_socket_send(intptr_t socket, const void* data, size_t size)
+{
+    return pal::local_socket_send_fds(socket, data, size, nullptr, 0);
+}
+
+bool pal::local_socket_send_fds(intptr_t socket, const void* data, size_t size, const intptr_t* fds, size_t fd_count)
+{
+    const size_t MAX_FDS = 16;
+    if (fd_count > MAX_FDS)
+    {
+        return false;
+    }
+
+    const char* buffer = (const char*) data;
+    while (size > 0)
+    {
+        struct iovec iov;
+        iov.iov_base = (void*) buffer;
+        iov.iov_len = size;
+
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+
+        // The descriptors ride along with the first chunk only.
+        union
+        {
+            struct cmsghdr align;
+            char data[CMSG_SPACE(MAX_FDS * sizeof(int))];
+        } control;
+        if (fd_count > 0)
+        {
+            std::memset(&control, 0, sizeof(control));
+            msg.msg_control = control.data;
+            msg.msg_controllen = CMSG_SPACE(fd_count * sizeof(int));
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(fd_count * sizeof(int));
+            int* out = (int*) CMSG_DATA(cmsg);
+            for (size_t i = 0; i < fd_count; ++i)
+            {
+                out[i] = (int) fds[i];
+            }
+        }
+
+#if defined(MSG_NOSIGNAL)
+        ssize_t sent = ::sendmsg((int) socket, &msg, MSG_NOSIGNAL);
+#else
+        ssize_t sent = ::sendmsg((int) socket, &msg, 0);
+#endif
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent <= 0)
+        {
+            return false;
+        }
+        fd_count = 0;
+        buffer += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool pal::local_socket_recv(intptr_t socket, void* data, size_t size)
+{
+    char* buffer = (char*) data;
+    while (size > 0)
+    {
+        ssize_t received = ::recv((int) socket, buffer, size, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return false;
+        }
+        buffer += received;
+        size -= received;
+    }
+    return true;
+}
+
+bool pal::local_socket_recv_fds(intptr_t socket, void* data, size_t size, std::vector<intptr_t>* fds)
+{
+    const size_t MAX_FDS = 16;
+    char* buffer = (char*) data;
+    while (size > 0)
+    {
+        struct iovec iov;
+        iov.iov_base = buffer;
+        iov.iov_len = size;
+
+        union
+        {
+            struct cmsghdr align;
+            char data[CMSG_SPACE(MAX_FDS * sizeof(int))];
+        } control;
+
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.data;
+        msg.msg_controllen = sizeof(control.data);
+
+#if defined(MSG_CMSG_CLOEXEC)
+        ssize_t received = ::recvmsg((int) socket, &msg, MSG_CMSG_CLOEXEC);
+#else
+        ssize_t received = ::recvmsg((int) socket, &msg, 0);
+#endif
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        // Keep every descriptor we were given, even on failure, so that the
+        // caller can close them.
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            {
+                const int* in = (const int*) CMSG_DATA(cmsg);
+                size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    fds->push_back(in[i]);
+                }
+            }
+        }
+
+        if (received <= 0 || (msg.msg_flags & MSG_CTRUNC))
+        {
+            return false;
+        }
+        buffer += received;
+        size -= received;
+    }
+    return true;
+}
+
+void pal::local_socket_close(intptr_t socket)
+{
+    ::close((int) socket);
+}
+
+bool pal::get_runtime_dir(pal::string_t* recv)
+{
+    if (!pal::getenv(_X("XDG_RUNTIME_DIR"), recv))
+    {
+        recv->assign(_X("/tmp"));
+    }
+    return true;
+}
+
+bool pal::get_default_resolve_daemon_path(pal::string_t* recv)
+{
+    pal::string_t name = _X("corehost_resolved.") + std::to_string(::geteuid()) + _X(".sock");
+    pal::get_runtime_dir(recv);
+    append_path(recv, name.c_str());
+    return true;
+}
+
+bool pal::get_default_zygote_path(const pal::string_t& app, pal::string_t* recv)
+{
+    // One server per app: name it after a hash of the app's path.
+    uint64_t hash = 14695981039346656037ULL;
+    for (pal::char_t c : app)
+    {
+        hash = (hash ^ (unsigned char) c) * 1099511628211ULL;
+    }
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) hash);
+
+    pal::string_t name = _X("corehost_zygote.") + std::to_string(::geteuid()) + _X(".") + hex + _X(".sock");
+    pal::get_runtime_dir(recv);
+    append_path(recv, name.c_str());
+    return true;
 }
@@ -11,6 +11,42 @@
 
 static std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> g_converter;
 
+namespace
+{
+class native_file_system_t : public pal::file_system_t
+{
+public:
+    bool realpath(pal::string_t* path) override;
+    bool file_exists(const pal::string_t& path) override;
+    void readdir(const pal::string_t& path, std::vector<pal::string_t>* list) override;
+    std::unique_ptr<std::istream> open_file(const pal::string_t& path) override;
+};
+
+native_file_system_t g_native_file_system;
+pal::file_system_t* g_file_system = &g_native_file_system;
+thread_local pal::file_system_t* t_file_system = nullptr;
+}
+
+pal::file_system_t* pal::native_file_system()
+{
+    return &g_native_file_system;
+}
+
+void pal::set_file_system(pal::file_system_t* fs)
+{
+    g_file_system = (fs != nullptr) ? fs : &g_native_file_system;
+}
+
+void pal::set_thread_file_system(pal::file_system_t* fs)
+{
+    t_file_system = fs;
+}
+
+pal::file_system_t* pal::get_file_system()
+{
+    return (t_file_system != nullptr) ? t_file_system : g_file_system;
+}
+
 bool pal::find_coreclr(pal::string_t* recv)
 {
     pal::string_t candidate;
@@ -31,7 +67,7 @@ bool pal::find_coreclr(pal::string_t* recv)
     return false;
 }
 
-bool pal::load_library(const char_t* path, dll_t* dll)
+bool pal::load_library(const char_t* path, dll_t* dll, bool resolve_now)
 {
     *dll = ::LoadLibraryW(path);
     if (*dll == nullptr)
@@ -58,6 +94,18 @@ bool pal::load_library(const char_t* path, dll_t* dll)
     return true;
 }
 
+bool pal::preload_library(const pal::string_t& path, pal::string_t* error)
+{
+    if (::LoadLibraryExW(path.c_str(), nullptr, LOAD_WITH_ALTERED_SEARCH_PATH) == nullptr)
+    {
+        pal::stringstream_t stream;
+        stream << _X("HRESULT: 0x") << std::hex << HRESULT_FROM_WIN32(GetLastError());
+        error->assign(stream.str());
+        return false;
+    }
+    return true;
+}
+
 pal::proc_t pal::get_symbol(dll_t library, const char* name)
 {
     return ::GetProcAddress(library, name);
@@ -149,9 +197,9 @@ void pal::to_stdstring(const pal::char_t* str, std::string* out)
     out->assign(g_converter.to_bytes(str));
 }
 
-bool pal::realpath(string_t* path)
+bool native_file_system_t::realpath(pal::string_t* path)
 {
-    char_t buf[MAX_PATH];
+    pal::char_t buf[MAX_PATH];
     auto res = ::GetFullPathNameW(path->c_str(), MAX_PATH, buf, nullptr);
     if (res == 0 || res > MAX_PATH)
     {
@@ -162,7 +210,7 @@ bool pal::realpath(string_t* path)
     return true;
 }
 
-bool pal::file_exists(const string_t& path)
+bool native_file_system_t::file_exists(const pal::string_t& path)
 {
     if (path.empty())
     {
@@ -176,13 +224,13 @@ bool pal::file_exists(const string_t& path)
     return found;
 }
 
-void pal::readdir(const string_t& path, std::vector<pal::string_t>* list)
+void native_file_system_t::readdir(const pal::string_t& path, std::vector<pal::string_t>* list)
 {
     assert(list != nullptr);
 
-    std::vector<string_t>& files = *list;
+    std::vector<pal::string_t>& files = *list;
 
-    string_t search_string(path);
+    pal::string_t search_string(path);
     search_string.push_back(DIR_SEPARATOR);
     search_string.push_back(L'*');
 
@@ -190,8 +238,249 @@ void pal::readdir(const string_t& path, std::vector<pal::string_t>* list)
     auto handle = ::FindFirstFileW(search_string.c_str(), &data);
     do
     {
-        string_t filepath(data.cFileName);
+        pal::string_t filepath(data.cFileName);
         files.push_back(filepath);
     } while (::FindNextFileW(handle, &data));
     ::FindClose(handle);
 }
+
+std::unique_ptr<std::istream> native_file_system_t::open_file(const pal::string_t& path)
+{
+    std::unique_ptr<std::istream> file(new pal::ifstream_t(path));
+    if (!file->good())
+    {
+        return nullptr;
+    }
+    return file;
+}
+
+void pal::file_write(FILE* stream, const pal::char_t* buffer, size_t count)
+{
+    std::string utf8 = g_converter.to_bytes(buffer, buffer + count);
+    ::fwrite(utf8.data(), 1, utf8.length(), stream);
+    ::fflush(stream);
+}
+
+void pal::set_crash_handler(void (*handler)())
+{
+    // No-op. Trace output is flushed at phase boundaries and on exit.
+}
+
+bool pal::prefetch_file(const pal::string_t& path)
+{
+    // Not implemented: the Windows prefetcher already covers process startup.
+    return false;
+}
+
+bool pal::get_mapped_files(std::vector<pal::string_t>* files)
+{
+    return false;
+}
+
+const pal::char_t* pal::get_host_rid()
+{
+#if defined(_M_AMD64)
+    return _X("win-x64");
+#elif defined(_M_ARM64)
+    return _X("win-arm64");
+#elif defined(_M_ARM)
+    return _X("win-arm");
+#else
+    return _X("win-x86");
+#endif
+}
+
+const std::vector<pal::string_t>& pal::get_cpu_isa_variants()
+{
+    // Not implemented: only baseline native assets are picked on Windows.
+    static const std::vector<pal::string_t> variants;
+    return variants;
+}
+
+void pal::exit_now(int exit_code)
+{
+    ::TerminateProcess(::GetCurrentProcess(), (UINT) exit_code);
+    // Not reached: TerminateProcess does not return for the current process.
+    std::abort();
+}
+
+bool pal::get_resource_limits(pal::resource_limits_t* limits, const pal::string_t& root)
+{
+    // Not implemented: job object limits are left to the runtime.
+    return false;
+}
+
+bool pal::get_file_identity(const pal::string_t& path, pal::file_identity_t* identity)
+{
+    // Not implemented: the TPA closure is not cached on Windows.
+    return false;
+}
+
+bool pal::create_directory(const pal::string_t& path)
+{
+    return ::CreateDirectoryW(path.c_str(), nullptr) != FALSE;
+}
+
+bool pal::create_symlink(const pal::string_t& target, const pal::string_t& link)
+{
+    // Not implemented: symlinks need a privilege or developer mode on Windows.
+    return false;
+}
+
+bool pal::remove_directory(const pal::string_t& path)
+{
+    pal::string_t search_string(path);
+    search_string.push_back(DIR_SEPARATOR);
+    search_string.push_back(L'*');
+
+    WIN32_FIND_DATAW data;
+    auto handle = ::FindFirstFileW(search_string.c_str(), &data);
+    if (handle != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+            {
+                ::DeleteFileW((path + DIR_SEPARATOR + data.cFileName).c_str());
+            }
+        } while (::FindNextFileW(handle, &data));
+        ::FindClose(handle);
+    }
+    return ::RemoveDirectoryW(path.c_str()) != FALSE;
+}
+
+void pal::list_directories(const pal::string_t& path, std::vector<pal::string_t>* list)
+{
+    pal::string_t search_string(path);
+    search_string.push_back(DIR_SEPARATOR);
+    search_string.push_back(L'*');
+
+    WIN32_FIND_DATAW data;
+    auto handle = ::FindFirstFileW(search_string.c_str(), &data);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+    do
+    {
+        if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 &&
+            std::wcscmp(data.cFileName, L".") != 0 && std::wcscmp(data.cFileName, L"..") != 0)
+        {
+            list->push_back(data.cFileName);
+        }
+    } while (::FindNextFileW(handle, &data));
+    ::FindClose(handle);
+}
+
+bool pal::hold_shared_lock(const pal::string_t& path, bool create)
+{
+    // Not implemented: native views are not built on Windows.
+    return false;
+}
+
+bool pal::try_lock_path(const pal::string_t& path, intptr_t* handle)
+{
+    return false;
+}
+
+void pal::unlock_path(intptr_t handle)
+{
+}
+
+bool pal::map_file(const pal::string_t& path, pal::mapped_file_t* file)
+{
+    // Not implemented: assembly metadata is not read on Windows.
+    return false;
+}
+
+void pal::unmap_file(pal::mapped_file_t* file)
+{
+}
+
+bool pal::map_shared_file(const pal::string_t& path, size_t size, pal::shared_file_t* file)
+{
+    // Not implemented: the resolution cache is not used on Windows.
+    return false;
+}
+
+void pal::unmap_shared_file(pal::shared_file_t* file)
+{
+}
+
+bool pal::lock_file(const pal::shared_file_t& file)
+{
+    return false;
+}
+
+bool pal::try_lock_file(const pal::shared_file_t& file)
+{
+    return false;
+}
+
+void pal::unlock_file(const pal::shared_file_t& file)
+{
+}
+
+bool pal::get_default_resolve_cache_path(pal::string_t* recv)
+{
+    return false;
+}
+
+bool pal::local_socket_connect(const pal::string_t& path, int timeout_ms, intptr_t* socket)
+{
+    // Not implemented: there is no resolution daemon on Windows.
+    return false;
+}
+
+bool pal::local_socket_send(intptr_t socket, const void* data, size_t size)
+{
+    return false;
+}
+
+bool pal::local_socket_recv(intptr_t socket, void* data, size_t size)
+{
+    return false;
+}
+
+void pal::local_socket_close(intptr_t socket)
+{
+}
+
+bool pal::local_socket_listen(const pal::string_t& path, intptr_t* socket)
+{
+    return false;
+}
+
+bool pal::local_socket_accept(intptr_t listener, int timeout_ms, intptr_t* socket)
+{
+    return false;
+}
+
+void pal::local_socket_set_timeout(intptr_t socket, int timeout_ms)
+{
+}
+
+bool pal::local_socket_send_fds(intptr_t socket, const void* data, size_t size, const intptr_t* fds, size_t fd_count)
+{
+    return false;
+}
+
+bool pal::local_socket_recv_fds(intptr_t socket, void* data, size_t size, std::vector<intptr_t>* fds)
+{
+    return false;
+}
+
+bool pal::get_runtime_dir(pal::string_t* recv)
+{
+    return false;
+}
+
+bool pal::get_default_resolve_daemon_path(pal::string_t* recv)
+{
+    return false;
+}
+
+bool pal::get_default_zygote_path(const pal::string_t& app, pal::string_t* recv)
+{
+    return false;
+}
@@ -1,13 +1,213 @@
 // Copyright (c) .NET Foundation and contributors. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstdio>
+
 #include "trace.h"
 
 static bool g_enabled = false;
 
+namespace
+{
+// Capacity of the trace buffer in characters.
+const size_t TRACE_BUFFER_SIZE = 64 * 1024;
+
+// Messages up to this length are formatted on the stack.
+const size_t TRACE_LINE_MAX = 1024;
+
+// -----------------------------------------------------------------------------
+// Buffered trace sink.
+//
+// Description:
+//    Writers format a message on their own stack, reserve a slice of the
+//    shared buffer with a CAS on "m_reserved", copy the message in and publish
+//    it by moving "m_committed" to its end. No lock is taken on this path.
+//    When the buffer is full, or at a phase boundary (see trace::flush), the
+//    flusher closes the buffer, waits for in-flight copies to commit and hands
+//    the whole buffer to the stream in a single write.
+//
+//    Slices are published in the order they were reserved: a writer that
+//    finishes its copy first waits for the slices before its own. The first
+//    "m_committed" characters are then always complete lines, so the crash
+//    handler can write them out without coordinating with other threads.
+//
+class trace_sink_t
+{
+public:
+    trace_sink_t()
+        : m_stream(nullptr)
+        , m_reserved(0)
+        , m_committed(0)
+    {
+    }
+
+    bool is_buffered() const { return m_stream != nullptr; }
+
+    bool is_stderr() const { return m_stream == stderr; }
+
+    void open(FILE* stream)
+    {
+        m_stream = stream;
+    }
+
+    void append(const pal::char_t* str, size_t len)
+    {
+        if (len > TRACE_BUFFER_SIZE)
+        {
+            // Too large to ever fit, bypass the buffer but keep the ordering.
+            std::lock_guard<std::mutex> lock(m_flush_lock);
+            flush_locked();
+            pal::file_write(m_stream, str, len);
+            return;
+        }
+
+        while (true)
+        {
+            size_t pos = m_reserved.load(std::memory_order_relaxed);
+            if (pos + len > TRACE_BUFFER_SIZE)
+            {
+                flush();
+                continue;
+            }
+            if (m_reserved.compare_exchange_weak(pos, pos + len, std::memory_order_acquire))
+            {
+                std::memcpy(m_buffer + pos, str, len * sizeof(pal::char_t));
+                while (m_committed.load(std::memory_order_acquire) != pos)
+                {
+                    std::this_thread::yield();
+                }
+                m_committed.store(pos + len, std::memory_order_release);
+                return;
+            }
+        }
+    }
+
+    void flush()
+    {
+        if (m_stream == nullptr)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_flush_lock);
+        flush_locked();
+    }
+
+    // Called from a crash handler: only async-signal-safe calls are allowed.
+    void flush_on_crash()
+    {
+        if (m_stream == nullptr)
+        {
+            return;
+        }
+        size_t committed = m_committed.load(std::memory_order_acquire);
+        pal::file_write(m_stream, m_buffer, committed);
+        m_committed.store(0);
+    }
+
+private:
+    void flush_locked()
+    {
+        // Close the buffer to new reservations. Writers that lose the race
+        // spin into flush() and wait on the lock.
+        size_t end = m_reserved.exchange(TRACE_BUFFER_SIZE, std::memory_order_acquire);
+        while (m_committed.load(std::memory_order_acquire) != end)
+        {
+            std::this_thread::yield();
+        }
+        if (end > 0)
+        {
+            pal::file_write(m_stream, m_buffer, end);
+        }
+        m_committed.store(0, std::memory_order_relaxed);
+        m_reserved.store(0, std::memory_order_release);
+    }
+
+    FILE* m_stream;
+    std::mutex m_flush_lock;
+    std::atomic<size_t> m_reserved;
+    std::atomic<size_t> m_committed;
+    pal::char_t m_buffer[TRACE_BUFFER_SIZE];
+};
+
+trace_sink_t g_sink;
+
+void flush_sink_on_crash()
+{
+    g_sink.flush_on_crash();
+}
+
+void flush_sink_on_exit()
+{
+    g_sink.flush();
+}
+
+void write_line(const pal::char_t* format, va_list vl)
+{
+    if (!g_sink.is_buffered())
+    {
+        pal::err_vprintf(format, vl);
+        return;
+    }
+
+    va_list copy;
+    va_copy(copy, vl);
+
+    pal::char_t line[TRACE_LINE_MAX];
+    int len = pal::str_vprintf(line, TRACE_LINE_MAX, format, vl);
+    if (len < 0)
+    {
+        va_end(copy);
+        return;
+    }
+
+    size_t length = (size_t) len;
+    if (length + 1 < TRACE_LINE_MAX)
+    {
+        line[length] = _X('\n');
+        g_sink.append(line, length + 1);
+    }
+    else
+    {
+        std::vector<pal::char_t> long_line(length + 2);
+        pal::str_vprintf(long_line.data(), long_line.size(), format, copy);
+        long_line[length] = _X('\n');
+        g_sink.append(long_line.data(), length + 1);
+    }
+    va_end(copy);
+}
+
+// Turn tracing on, to "trace_file" (appending) or to stderr if it is null.
+void enable_sink(const pal::char_t* trace_file)
+{
+    g_enabled = true;
+
+    if (g_sink.is_buffered())
+    {
+        return;
+    }
+
+    FILE* stream = (trace_file == nullptr) ? stderr : pal::file_open(trace_file, _X("a"));
+
+    g_sink.open(stream == nullptr ? stderr : stream);
+    std::atexit(flush_sink_on_exit);
+    pal::set_crash_handler(flush_sink_on_crash);
+
+    if (stream == nullptr)
+    {
+        trace::warning(_X("Failed to open trace file %s, tracing to stderr"), trace_file);
+    }
+}
+} // end of anonymous namespace
+
 //
 // Turn on tracing for the corehost based on "COREHOST_TRACE" env.
 //
+// When tracing is on, trace output is buffered and written in large chunks to
+// stderr or, if "COREHOST_TRACEFILE" is set, appended to that file.
+//
 void trace::setup()
 {
     // Read trace environment variable
@@ -17,17 +217,29 @@ void trace::setup()
         return;
     }
 
-    auto trace_val = pal::xtoi(trace_str.c_str());
-    if (trace_val > 0)
+    pal::string_t trace_file;
+    bool has_trace_file = pal::getenv(_X("COREHOST_TRACEFILE"), &trace_file);
+    trace::setup(pal::xtoi(trace_str.c_str()), has_trace_file ? trace_file.c_str() : nullptr);
+}
+
+void trace::setup(int level, const pal::char_t* trace_file)
+{
+    // When hostpolicy is linked into the executable, the executable has
+    // already set up this same trace state.
+    if (g_enabled || level <= 0)
     {
-        trace::enable();
-        trace::info(_X("Tracing enabled"));
+        return;
     }
+
+    enable_sink(trace_file);
+    trace::info(_X("Tracing enabled"));
 }
 
 void trace::enable()
 {
-    g_enabled = true;
+    pal::string_t trace_file;
+    bool has_trace_file = pal::getenv(_X("COREHOST_TRACEFILE"), &trace_file);
+    enable_sink(has_trace_file ? trace_file.c_str() : nullptr);
 }
 
 bool trace::is_enabled()
@@ -35,13 +247,18 @@ bool trace::is_enabled()
     return g_enabled;
 }
 
+void trace::flush()
+{
+    g_sink.flush();
+}
+
 void trace::verbose(const pal::char_t* format, ...)
 {
     if (g_enabled)
     {
         va_list args;
         va_start(args, format);
-        pal::err_vprintf(format, args);
+        write_line(format, args);
         va_end(args);
     }
 }
@@ -52,7 +269,7 @@ void trace::info(const pal::char_t* format, ...)
     {
         va_list args;
         va_start(args, format);
-        pal::err_vprintf(format, args);
+        write_line(format, args);
         va_end(args);
     }
 }
@@ -62,8 +279,19 @@ void trace::error(const pal::char_t* format, ...)
     // Always print errors
     va_list args;
     va_start(args, format);
-    pal::err_vprintf(format, args);
+    if (g_sink.is_buffered() && !g_sink.is_stderr())
+    {
+        // Errors are recorded in the trace file but still need to reach the user.
+        va_list copy;
+        va_copy(copy, args);
+        pal::err_vprintf(format, copy);
+        va_end(copy);
+    }
+    write_line(format, args);
     va_end(args);
+
+    // Errors usually precede an exit, don't hold them back.
+    g_sink.flush();
 }
 
 void trace::warning(const pal::char_t* format, ...)
@@ -72,7 +300,7 @@ void trace::warning(const pal::char_t* format, ...)
     {
         va_list args;
         va_start(args, format);
-        pal::err_vprintf(format, args);
+        write_line(format, args);
         va_end(args);
     }
 }
@@ -9,8 +9,12 @@
 namespace trace
 {
     void setup();
+    // Same as setup(), with COREHOST_TRACE and COREHOST_TRACEFILE already read
+    // by the caller. "trace_file" is null to trace to stderr.
+    void setup(int level, const pal::char_t* trace_file);
     void enable();
     bool is_enabled();
+    void flush();
     void verbose(const pal::char_t* format, ...);
     void info(const pal::char_t* format, ...);
     void warning(const pal::char_t* format, ...);
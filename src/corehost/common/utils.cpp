@@ -1,6 +1,8 @@
 // Copyright (c) .NET Foundation and contributors. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include <random>
+
 #include "utils.h"
 #include "trace.h"
 
@@ -84,3 +86,64 @@ void replace_char(pal::string_t* path, pal::char_t match, pal::char_t repl)
         (*path)[pos] = repl;
     }
 }
+
+// Split "items" at every "separator", skipping empty items.
+void split(const pal::string_t& items, pal::char_t separator, std::vector<pal::string_t>* out)
+{
+    size_t start = 0;
+    while (start < items.length())
+    {
+        size_t end = items.find(separator, start);
+        if (end == pal::string_t::npos)
+        {
+            end = items.length();
+        }
+        if (end > start)
+        {
+            out->push_back(items.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+}
+
+// The path of the file next to the deps file at "deps_path" named after it,
+// with "ext" in place of its ".deps" extension.
+pal::string_t get_deps_sibling_path(const pal::string_t& deps_path, const pal::char_t* ext)
+{
+    pal::string_t path = deps_path;
+    if (ends_with(path, _X(".deps")))
+    {
+        path.resize(path.length() - 5);
+    }
+    path.append(ext);
+    return path;
+}
+
+// A path next to "path" that no other process picks, to build a file or dir
+// in before moving it to "path".
+pal::string_t get_temp_path(const pal::string_t& path)
+{
+    pal::stringstream_t stream;
+    stream << path << _X(".tmp") << std::hex << std::random_device()();
+    return stream.str();
+}
+
+// Write "contents" to a temp file and move it to "path", so that readers see
+// either the old file or the new one, and concurrent writers the last one.
+bool write_file_atomically(const pal::string_t& path, const std::string& contents)
+{
+    pal::string_t temp_path = get_temp_path(path);
+    FILE* file = pal::file_open(temp_path, _X("w"));
+    if (file == nullptr)
+    {
+        return false;
+    }
+    bool ok = std::fwrite(contents.data(), 1, contents.length(), file) == contents.length();
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok || !pal::rename_file(temp_path, path))
+    {
+        pal::remove_file(temp_path);
+        return false;
+    }
+    return true;
+}
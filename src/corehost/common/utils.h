@@ -14,4 +14,8 @@ pal::string_t get_filename(const pal::string_t& path);
 void append_path(pal::string_t* path1, const pal::char_t* path2);
 bool coreclr_exists_in_dir(const pal::string_t& candidate);
 void replace_char(pal::string_t* path, pal::char_t match, pal::char_t repl);
+void split(const pal::string_t& items, pal::char_t separator, std::vector<pal::string_t>* out);
+pal::string_t get_deps_sibling_path(const pal::string_t& deps_path, const pal::char_t* ext);
+pal::string_t get_temp_path(const pal::string_t& path);
+bool write_file_atomically(const pal::string_t& path, const std::string& contents);
 #endif
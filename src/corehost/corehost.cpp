@@ -6,7 +6,11 @@
 #include "utils.h"
 #include "libhost.h"
 
+#ifdef COREHOST_STATIC_HOSTPOLICY
+// hostpolicy is linked into this executable.
 extern int corehost_main(const int argc, const pal::char_t* argv[]);
+extern int corehost_main_with_context(const host_context_t* context, const int argc, const pal::char_t* argv[]);
+#endif
 
 namespace
 {
@@ -19,7 +23,38 @@ enum StatusCode
     CoreHostCurExeFindFailure = 0x44,
 };
 
-typedef int (*corehost_main_fn) (const int argc, const pal::char_t* argv[]);
+// -----------------------------------------------------------------------------
+// The environment variables read by the executable, kept to be passed on to
+// hostpolicy in the host context.
+//
+class env_snapshot_t
+{
+public:
+    bool getenv(const pal::char_t* name, pal::string_t* recv)
+    {
+        bool found = pal::getenv(name, recv);
+        m_names.push_back(name);
+        m_values.push_back(found ? *recv : pal::string_t());
+        return found;
+    }
+
+    void fill(host_context_t* context)
+    {
+        m_value_ptrs.clear();
+        for (const auto& value : m_values)
+        {
+            m_value_ptrs.push_back(value.empty() ? nullptr : value.c_str());
+        }
+        context->env_count = m_names.size();
+        context->env_names = m_names.data();
+        context->env_values = m_value_ptrs.data();
+    }
+
+private:
+    std::vector<const pal::char_t*> m_names;
+    std::vector<pal::string_t> m_values;
+    std::vector<const pal::char_t*> m_value_ptrs;
+};
 
 // -----------------------------------------------------------------------------
 // Load the corehost library from the path specified
@@ -28,12 +63,14 @@ typedef int (*corehost_main_fn) (const int argc, const pal::char_t* argv[]);
 //    lib_dir      - dir path to the corehost library
 //    h_host       - handle to the library which will be kept live
 //    main_fn      - Contains the entrypoint "corehost_main" when returns success.
+//    context_main_fn - Contains the entrypoint "corehost_main_with_context"
+//                   when returns success, or nullptr if the library predates it.
 //
 // Returns:
 //    Non-zero exit code on failure. "main_fn" contains "corehost_main"
 //    entrypoint on success.
 //
-StatusCode load_host_lib(const pal::string_t& lib_dir, pal::dll_t* h_host, corehost_main_fn* main_fn)
+StatusCode load_host_lib(const pal::string_t& lib_dir, pal::dll_t* h_host, corehost_main_fn* main_fn, corehost_main_with_context_fn* context_main_fn)
 {
     pal::string_t host_path = lib_dir;
     append_path(&host_path, LIBHOST_NAME);
@@ -51,8 +88,9 @@ StatusCode load_host_lib(const pal::string_t& lib_dir, pal::dll_t* h_host, coreh
         return StatusCode::CoreHostLibLoadFailure;
     }
 
-    // Obtain entrypoint symbol
+    // Obtain entrypoint symbols
     *main_fn = (corehost_main_fn) pal::get_symbol(*h_host, "corehost_main");
+    *context_main_fn = (corehost_main_with_context_fn) pal::get_symbol(*h_host, "corehost_main_with_context");
 
     return (*main_fn != nullptr)
                 ? StatusCode::Success
@@ -67,14 +105,45 @@ int __cdecl wmain(const int argc, const pal::char_t* argv[])
 int main(const int argc, const pal::char_t* argv[])
 #endif
 {
-    trace::setup();
+    // Everything read here is handed to hostpolicy so it need not be read again.
+    env_snapshot_t env;
+    pal::string_t trace_level;
+    pal::string_t trace_file;
+    env.getenv(_X("COREHOST_TRACE"), &trace_level);
+    bool has_trace_file = env.getenv(_X("COREHOST_TRACEFILE"), &trace_file);
+    trace::setup(pal::xtoi(trace_level.c_str()), has_trace_file ? trace_file.c_str() : nullptr);
+
+    // Get current path to look for the library app locally.
+    pal::string_t own_path;
+    bool has_own_path = pal::get_own_executable_path(&own_path) && pal::realpath(&own_path);
+    pal::string_t own_dir = has_own_path ? get_directory(own_path) : pal::string_t();
+
+    // Call whichever entrypoint the host library has, preferring the one that
+    // takes the context.
+    auto call_host = [&] (corehost_main_fn host_main, corehost_main_with_context_fn context_main) -> int {
+        trace::flush();
+        if (context_main == nullptr)
+        {
+            return host_main(argc, argv);
+        }
+
+        host_context_t context;
+        context.size = sizeof(context);
+        context.version = HOST_CONTEXT_VERSION;
+        context.own_path = has_own_path ? own_path.c_str() : nullptr;
+        context.own_dir = has_own_path ? own_dir.c_str() : nullptr;
+        context.trace_level = pal::xtoi(trace_level.c_str());
+        context.trace_file = has_trace_file ? trace_file.c_str() : nullptr;
+        env.fill(&context);
+        return context_main(&context, argc, argv);
+    };
 
     pal::dll_t corehost;
 
 #ifdef COREHOST_PACKAGE_SERVICING
     // No custom host asked, so load the corehost if serviced first.
     pal::string_t svc_dir;
-    if (pal::getenv(_X("DOTNET_SERVICING"), &svc_dir))
+    if (env.getenv(_X("DOTNET_SERVICING"), &svc_dir))
     {
         pal::string_t path = svc_dir;
         append_path(&path, COREHOST_PACKAGE_NAME);
@@ -82,7 +151,8 @@ int main(const int argc, const pal::char_t* argv[])
         append_path(&path, COREHOST_PACKAGE_COREHOST_RELATIVE_DIR);
 
         corehost_main_fn host_main;
-        StatusCode code = load_host_lib(path, &corehost, &host_main);
+        corehost_main_with_context_fn context_main;
+        StatusCode code = load_host_lib(path, &corehost, &host_main, &context_main);
         if (code != StatusCode::Success)
         {
             trace::info(_X("Failed to load host library from servicing dir: %s; Status=%08X"), path.c_str(), code);
@@ -91,30 +161,36 @@ int main(const int argc, const pal::char_t* argv[])
         else
         {
             trace::info(_X("Calling host entrypoint from library at servicing dir %s"), path.c_str());
-            return host_main(argc, argv);
+            return call_host(host_main, context_main);
         }
     }
 #endif
 
-    // Get current path to look for the library app locally.
-    pal::string_t own_path;
-    if (!pal::get_own_executable_path(&own_path) || !pal::realpath(&own_path))
+    if (!has_own_path)
     {
         trace::error(_X("Failed to locate current executable"));
         return StatusCode::CoreHostCurExeFindFailure;
     }
 
     // Local load of the corehost library.
-    auto own_dir = get_directory(own_path);
-
     corehost_main_fn host_main;
-    StatusCode code = load_host_lib(own_dir, &corehost, &host_main);
+    corehost_main_with_context_fn context_main;
+    StatusCode code = load_host_lib(own_dir, &corehost, &host_main, &context_main);
     switch (code)
     {
     // Success, call the entrypoint.
     case StatusCode::Success:
         trace::info(_X("Calling host entrypoint from library at own dir %s"), own_dir.c_str());
-        return host_main(argc, argv);
+        return call_host(host_main, context_main);
+
+#ifdef COREHOST_STATIC_HOSTPOLICY
+    // No hostpolicy next to us, use the one we were built with. A library in
+    // the servicing dir or in our own dir still wins, so that a patched
+    // hostpolicy can be deployed without replacing this executable.
+    case StatusCode::CoreHostLibMissingFailure:
+        trace::info(_X("Calling linked in host entrypoint"));
+        return call_host(corehost_main, corehost_main_with_context);
+#endif
 
     // Some other fatal error including StatusCode::CoreHostLibMissingFailure.
     default: